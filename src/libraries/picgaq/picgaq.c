@@ -0,0 +1,308 @@
+/*
+ * Queued command interface to the PICGA graphics coprocessor.
+ */
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "picgaq.h"
+
+/*
+ * Map a command code to the index of its cached state, or -1.
+ */
+static int
+state_index (unsigned cmd)
+{
+    switch (cmd) {
+    case SPI_COLOR:     return PICGAQ_COLOR;
+    case SPI_FGCOLOR:   return PICGAQ_FGCOLOR;
+    case SPI_BGCOLOR:   return PICGAQ_BGCOLOR;
+    case SPI_LOCATE:    return PICGAQ_LOCATE;
+    case SPI_FONT:      return PICGAQ_FONT;
+    }
+    return -1;
+}
+
+/*
+ * Remove a queued command from the buffer.
+ */
+static void
+remove_command (struct picgaq *q, int off)
+{
+    unsigned n = 2 + q->buf[off + 1];
+    int i;
+
+    memmove (q->buf + off, q->buf + off + n, q->len - off - n);
+    q->len -= n;
+    for (i=0; i<PICGAQ_NSTATE; i++) {
+        if (q->pending[i] == off)
+            q->pending[i] = -1;
+        else if (q->pending[i] > off)
+            q->pending[i] -= n;
+    }
+}
+
+static void
+forget_pending (struct picgaq *q)
+{
+    int i;
+
+    for (i=0; i<PICGAQ_NSTATE; i++)
+        q->pending[i] = -1;
+}
+
+int
+picgaq_open (struct picgaq *q, const char *path)
+{
+    q->fd = open (path ? path : PICGAQ_DEVICE, O_WRONLY);
+    if (q->fd < 0)
+        return -1;
+    q->len = 0;
+    q->nqueued = 0;
+    q->nsent = 0;
+    q->nwrites = 0;
+    picgaq_invalidate (q);
+    return 0;
+}
+
+void
+picgaq_close (struct picgaq *q)
+{
+    if (q->fd < 0)
+        return;
+    picgaq_flush (q);
+    close (q->fd);
+    q->fd = -1;
+}
+
+void
+picgaq_invalidate (struct picgaq *q)
+{
+    q->valid = 0;
+    forget_pending (q);
+}
+
+int
+picgaq_flush (struct picgaq *q)
+{
+    unsigned len = q->len;
+
+    /* Queued offsets are gone after the burst. */
+    q->len = 0;
+    forget_pending (q);
+    if (len == 0)
+        return 0;
+
+    q->nsent += len;
+    q->nwrites++;
+    if (write (q->fd, q->buf, len) != len) {
+        /* Device state is unknown now. */
+        q->valid = 0;
+        return -1;
+    }
+    return 0;
+}
+
+int
+picgaq_command (struct picgaq *q, unsigned cmd, unsigned len, const void *data)
+{
+    int s = state_index (cmd);
+    unsigned char *p;
+
+    if (len > 255) {
+        /* Does not fit the length byte. */
+        errno = EINVAL;
+        return -1;
+    }
+    q->nqueued += 2 + len;
+
+    if (s >= 0 && len <= sizeof q->state[0]) {
+        if ((q->valid & (1 << s)) &&
+            memcmp (q->state[s], data, len) == 0) {
+            /* Already in effect. */
+            return 0;
+        }
+        if (q->pending[s] >= 0 && q->buf[q->pending[s] + 1] == len) {
+            memcpy (q->state[s], data, len);
+            if ((q->prev_valid & (1 << s)) &&
+                memcmp (q->prev[s], data, len) == 0) {
+                /* Changed back before use: drop both. */
+                remove_command (q, q->pending[s]);
+            } else {
+                /* Nobody used the previous value: overwrite it. */
+                memcpy (q->buf + q->pending[s] + 2, data, len);
+            }
+            return 0;
+        }
+
+        /* Remember the value in effect, in case this one is undone. */
+        memcpy (q->prev[s], q->state[s], sizeof q->prev[s]);
+        q->prev_valid = (q->prev_valid & ~(1 << s)) | (q->valid & (1 << s));
+        memcpy (q->state[s], data, len);
+        q->valid |= 1 << s;
+    } else if (s >= 0) {
+        /* Too long to cache: the value in effect is unknown now. */
+        q->valid &= ~(1 << s);
+    }
+
+    if (q->len + 2 + len > PICGAQ_BUFSZ && picgaq_flush (q) < 0)
+        return -1;
+
+    p = q->buf + q->len;
+    p[0] = cmd;
+    p[1] = len;
+    if (len > 0)
+        memcpy (p + 2, data, len);
+
+    if (s >= 0) {
+        q->pending[s] = q->len;
+    } else {
+        /* Any other command may depend on the current state. */
+        forget_pending (q);
+
+        switch (cmd) {
+        case SPI_CLS:
+        case SPI_SCROLL:
+        case SPI_PRINT:
+        case SPI_PRINTAT:
+        case SPI_PUTCH:
+        case SPI_PUTCHAR:
+            /* Text cursor moves. */
+            q->valid &= ~(1 << PICGAQ_LOCATE);
+            break;
+        }
+    }
+    q->len += 2 + len;
+    return 0;
+}
+
+int
+picgaq_cls (struct picgaq *q)
+{
+    return picgaq_command (q, SPI_CLS, 0, 0);
+}
+
+int
+picgaq_plot (struct picgaq *q, unsigned x, unsigned y)
+{
+    struct coord2 c;
+
+    c.x = x;
+    c.y = y;
+    return picgaq_command (q, SPI_PLOT, sizeof c, &c);
+}
+
+int
+picgaq_draw (struct picgaq *q, unsigned x1, unsigned y1,
+             unsigned x2, unsigned y2)
+{
+    struct coord4 c;
+
+    c.x1 = x1;
+    c.y1 = y1;
+    c.x2 = x2;
+    c.y2 = y2;
+    return picgaq_command (q, SPI_DRAW, sizeof c, &c);
+}
+
+int
+picgaq_rectangle (struct picgaq *q, unsigned x1, unsigned y1,
+                  unsigned x2, unsigned y2, int fill, unsigned dither)
+{
+    struct rectangle r;
+
+    memset (&r, 0, sizeof r);
+    r.x1 = x1;
+    r.y1 = y1;
+    r.x2 = x2;
+    r.y2 = y2;
+    r.fill = (fill != 0);
+    r.dither = dither;
+    return picgaq_command (q, SPI_RECTANGLE, sizeof r, &r);
+}
+
+int
+picgaq_circle (struct picgaq *q, unsigned x, unsigned y,
+               unsigned radius, int fill)
+{
+    struct circle c;
+
+    memset (&c, 0, sizeof c);
+    c.x = x;
+    c.y = y;
+    c.radius = radius;
+    c.fill = (fill != 0);
+    return picgaq_command (q, SPI_CIRCLE, sizeof c, &c);
+}
+
+static int
+set_color (struct picgaq *q, unsigned cmd, unsigned color)
+{
+    struct intval v;
+
+    v.value = color;
+    return picgaq_command (q, cmd, sizeof v, &v);
+}
+
+int
+picgaq_color (struct picgaq *q, unsigned color)
+{
+    return set_color (q, SPI_COLOR, color);
+}
+
+int
+picgaq_fgcolor (struct picgaq *q, unsigned color)
+{
+    return set_color (q, SPI_FGCOLOR, color);
+}
+
+int
+picgaq_bgcolor (struct picgaq *q, unsigned color)
+{
+    return set_color (q, SPI_BGCOLOR, color);
+}
+
+int
+picgaq_locate (struct picgaq *q, unsigned x, unsigned y)
+{
+    struct coord2 c;
+
+    c.x = x;
+    c.y = y;
+    return picgaq_command (q, SPI_LOCATE, sizeof c, &c);
+}
+
+int
+picgaq_font (struct picgaq *q, unsigned font)
+{
+    struct charval v;
+
+    v.value = font;
+    return picgaq_command (q, SPI_FONT, sizeof v, &v);
+}
+
+int
+picgaq_putch (struct picgaq *q, int c)
+{
+    struct charval v;
+
+    v.value = c;
+    return picgaq_command (q, SPI_PUTCH, sizeof v, &v);
+}
+
+int
+picgaq_print (struct picgaq *q, const char *str)
+{
+    unsigned len = strlen (str);
+    unsigned n;
+
+    /* Payload length is one byte: split long strings. */
+    while (len > 0) {
+        n = (len > 255) ? 255 : len;
+        if (picgaq_command (q, SPI_PRINT, n, str) < 0)
+            return -1;
+        str += n;
+        len -= n;
+    }
+    return 0;
+}
@@ -0,0 +1,97 @@
+/*
+ * Queued command interface to the PICGA graphics coprocessor.
+ *
+ * Drawing commands are collected in a user buffer and sent to the
+ * picga device with a single write() per buffer.  The write stream
+ * has the same layout as the arguments of picga_command(): one byte
+ * of command code, one byte of payload length, then the payload.
+ *
+ * Redundant state changes (SPI_COLOR, SPI_FGCOLOR, SPI_BGCOLOR,
+ * SPI_LOCATE and SPI_FONT) are merged before they reach the wire:
+ * a change to the value already in effect is dropped, and a change
+ * which is overridden before any command used it is rewritten in place.
+ */
+#ifndef _PICGAQ_H
+#define _PICGAQ_H
+
+#include <sys/picga.h>
+
+#define PICGAQ_DEVICE   "/dev/picga"
+#define PICGAQ_BUFSZ    512     /* bytes per write() burst */
+
+/*
+ * Index of cached state commands.
+ */
+#define PICGAQ_COLOR    0
+#define PICGAQ_FGCOLOR  1
+#define PICGAQ_BGCOLOR  2
+#define PICGAQ_LOCATE   3
+#define PICGAQ_FONT     4
+#define PICGAQ_NSTATE   5
+
+struct picgaq {
+    int             fd;                     /* picga device */
+    unsigned        len;                    /* bytes queued in buf */
+    unsigned        valid;                  /* mask of known state values */
+    unsigned        prev_valid;             /* valid before pending */
+    int             pending [PICGAQ_NSTATE]; /* unused command, or -1 */
+    unsigned char   state [PICGAQ_NSTATE] [sizeof (struct coord2)];
+    unsigned char   prev [PICGAQ_NSTATE] [sizeof (struct coord2)];
+
+    /* Statistics. */
+    unsigned long   nqueued;                /* bytes submitted by caller */
+    unsigned long   nsent;                  /* bytes written to device */
+    unsigned        nwrites;                /* write() bursts issued */
+
+    unsigned char   buf [PICGAQ_BUFSZ];
+};
+
+/*
+ * Open the device and reset the queue.
+ * Returns 0 on success, -1 on failure.
+ */
+int picgaq_open (struct picgaq *q, const char *path);
+
+/*
+ * Flush pending commands and close the device.
+ */
+void picgaq_close (struct picgaq *q);
+
+/*
+ * Send all queued commands in one burst.
+ * Returns 0 on success, -1 on write error.
+ */
+int picgaq_flush (struct picgaq *q);
+
+/*
+ * Forget cached state, e.g. after somebody else used the display.
+ */
+void picgaq_invalidate (struct picgaq *q);
+
+/*
+ * Queue a raw command.  Returns 0 on success, -1 on write error,
+ * or with errno EINVAL when the payload is over 255 bytes.
+ */
+int picgaq_command (struct picgaq *q, unsigned cmd, unsigned len,
+                    const void *data);
+
+/*
+ * Helpers for the common commands.
+ */
+int picgaq_cls (struct picgaq *q);
+int picgaq_plot (struct picgaq *q, unsigned x, unsigned y);
+int picgaq_draw (struct picgaq *q, unsigned x1, unsigned y1,
+                 unsigned x2, unsigned y2);
+int picgaq_rectangle (struct picgaq *q, unsigned x1, unsigned y1,
+                      unsigned x2, unsigned y2, int fill, unsigned dither);
+int picgaq_circle (struct picgaq *q, unsigned x, unsigned y,
+                   unsigned radius, int fill);
+int picgaq_color (struct picgaq *q, unsigned color);
+int picgaq_fgcolor (struct picgaq *q, unsigned color);
+int picgaq_bgcolor (struct picgaq *q, unsigned color);
+int picgaq_locate (struct picgaq *q, unsigned x, unsigned y);
+int picgaq_font (struct picgaq *q, unsigned font);
+int picgaq_putch (struct picgaq *q, int c);
+int picgaq_print (struct picgaq *q, const char *str);
+
+#endif
@@ -0,0 +1,293 @@
+/*
+ * Buffered TCP client stream.
+ */
+#include <string.h>
+#include "w5100burst.h"
+#include "bclient.h"
+
+static void
+reset (bclient_t *b)
+{
+    b->rpos = 0;
+    b->rlen = 0;
+    b->tlen = 0;
+    b->sending = 0;
+    b->mss = BCLIENT_TXSIZE;
+}
+
+/*
+ * Use the segment size negotiated by the chip as a flush threshold,
+ * but no more than the TX memory of the socket: after wz_part_apply()
+ * an idle socket may have only 1 kbyte.
+ */
+static void
+get_mss (bclient_t *b)
+{
+    unsigned mss;
+
+    if (b->c.sock >= MAX_SOCK_NUM)
+        return;
+    mss = w5100b_readSnMSSR (b->c.sock);
+    b->mss = (mss == 0 || mss > BCLIENT_TXSIZE) ? BCLIENT_TXSIZE : mss;
+    if (w5100_ssize[b->c.sock] > 0 && b->mss > w5100_ssize[b->c.sock])
+        b->mss = w5100_ssize[b->c.sock];
+}
+
+static int
+is_open (unsigned sock)
+{
+    unsigned status = w5100b_readSnSR (sock);
+
+    return status == SnSR_ESTABLISHED || status == SnSR_CLOSE_WAIT;
+}
+
+/*
+ * Move everything the chip has received, as far as it fits,
+ * into the ring buffer.  Returns the number of bytes added.
+ */
+static unsigned
+fill (bclient_t *b)
+{
+    unsigned sock = b->c.sock;
+    unsigned avail, tail, n, ptr;
+
+    if (sock >= MAX_SOCK_NUM || b->rlen == BCLIENT_RXSIZE)
+        return 0;
+    if (b->rlen == 0)
+        b->rpos = 0;
+
+    avail = w5100_burst_rx_size (sock);
+    if (avail == 0)
+        return 0;
+    if (avail > BCLIENT_RXSIZE - b->rlen)
+        avail = BCLIENT_RXSIZE - b->rlen;
+
+    tail = (b->rpos + b->rlen) % BCLIENT_RXSIZE;
+    n = BCLIENT_RXSIZE - tail;
+    if (n > avail)
+        n = avail;
+
+    ptr = w5100b_readSnRX_RD (sock);
+    w5100_burst_read_data (sock, ptr, b->rx + tail, n);
+    if (avail > n)
+        w5100_burst_read_data (sock, ptr + n, b->rx, avail - n);
+    w5100b_writeSnRX_RD (sock, ptr + avail);
+    w5100_burst_cmd (sock, Sock_RECV);
+
+    w5100_burst_stats.rx_bytes += avail;
+    w5100_burst_stats.sock_rx[sock] += avail;
+    b->rlen += avail;
+    return avail;
+}
+
+/*
+ * Wait until the previous SEND is complete.
+ * Returns 0 when the connection was lost.
+ */
+static int
+wait_sent (bclient_t *b)
+{
+    unsigned sock = b->c.sock;
+
+    if (! b->sending)
+        return 1;
+    if (! w5100_burst_wait_send (sock, SnIR_SEND_OK))
+        return 0;
+    b->sending = 0;
+    return 1;
+}
+
+/*
+ * Pass the transmit buffer to the chip, in SENDs of at most the
+ * TX memory of the socket.
+ */
+static int
+send_tx (bclient_t *b)
+{
+    unsigned sock = b->c.sock;
+    unsigned len = b->tlen;
+    unsigned done, n;
+
+    if (len == 0)
+        return 0;
+    b->tlen = 0;
+    if (sock >= MAX_SOCK_NUM || w5100_ssize[sock] == 0)
+        return -1;
+
+    for (done=0; done<len; done+=n) {
+        n = len - done;
+        if (n > w5100_ssize[sock])
+            n = w5100_ssize[sock];
+
+        /* Wait for room in TX memory. */
+        while (w5100_burst_tx_free (sock) < n) {
+            if (! is_open (sock))
+                return -1;
+        }
+        if (! wait_sent (b))
+            return -1;
+
+        w5100_burst_send_chunk (sock, b->tx + done, n);
+        w5100_burst_cmd (sock, Sock_SEND);
+        b->sending = 1;
+    }
+    return 0;
+}
+
+void
+bclient_init (bclient_t *b, uint8_t *ip, unsigned port)
+{
+    client_init (&b->c, ip, port);
+    reset (b);
+}
+
+void
+bclient_init_sock (bclient_t *b, unsigned sock)
+{
+    client_init_sock (&b->c, sock);
+    reset (b);
+    get_mss (b);
+}
+
+unsigned
+bclient_status (bclient_t *b)
+{
+    return client_status (&b->c);
+}
+
+int
+bclient_connect (bclient_t *b)
+{
+    int ret;
+
+    reset (b);
+    ret = client_connect (&b->c);
+
+    /* Stock socket code has written the socket registers. */
+    if (b->c.sock < MAX_SOCK_NUM)
+        w5100_cache_invalidate (b->c.sock);
+    if (ret)
+        get_mss (b);
+    return ret;
+}
+
+void
+bclient_write (bclient_t *b, const uint8_t *buf, unsigned size)
+{
+    unsigned n;
+
+    while (size > 0) {
+        n = b->mss - b->tlen;
+        if (n > size)
+            n = size;
+        memcpy (b->tx + b->tlen, buf, n);
+        b->tlen += n;
+        buf += n;
+        size -= n;
+        if (b->tlen >= b->mss && send_tx (b) < 0)
+            return;
+    }
+}
+
+void
+bclient_putc (bclient_t *b, uint8_t byte)
+{
+    b->tx [b->tlen++] = byte;
+    if (b->tlen >= b->mss)
+        send_tx (b);
+}
+
+void
+bclient_puts (bclient_t *b, const char *str)
+{
+    bclient_write (b, (const uint8_t*) str, strlen (str));
+}
+
+int
+bclient_flush (bclient_t *b)
+{
+    return send_tx (b);
+}
+
+int
+bclient_available (bclient_t *b)
+{
+    if (b->rlen == 0)
+        fill (b);
+    return b->rlen;
+}
+
+int
+bclient_peek (bclient_t *b)
+{
+    if (b->rlen == 0 && fill (b) == 0)
+        return -1;
+    return b->rx [b->rpos];
+}
+
+int
+bclient_getc (bclient_t *b)
+{
+    int c;
+
+    if (b->rlen == 0 && fill (b) == 0)
+        return -1;
+    c = b->rx [b->rpos];
+    b->rpos = (b->rpos + 1) % BCLIENT_RXSIZE;
+    b->rlen--;
+    return c;
+}
+
+int
+bclient_read (bclient_t *b, uint8_t *buf, unsigned size)
+{
+    unsigned sock = b->c.sock;
+    unsigned n, done = 0;
+
+    if (b->rlen == 0 && size >= BCLIENT_RXSIZE && sock < MAX_SOCK_NUM) {
+        /* Large read with empty ring: copy straight from the chip. */
+        n = w5100_burst_rx_size (sock);
+        if (n == 0)
+            return -1;
+        if (n > size)
+            n = size;
+        w5100_burst_recv_chunk (sock, buf, n);
+        w5100_burst_cmd (sock, Sock_RECV);
+        return n;
+    }
+
+    if (b->rlen == 0 && fill (b) == 0)
+        return -1;
+    while (done < size && b->rlen > 0) {
+        n = BCLIENT_RXSIZE - b->rpos;
+        if (n > b->rlen)
+            n = b->rlen;
+        if (n > size - done)
+            n = size - done;
+        memcpy (buf + done, b->rx + b->rpos, n);
+        b->rpos = (b->rpos + n) % BCLIENT_RXSIZE;
+        b->rlen -= n;
+        done += n;
+    }
+    return done;
+}
+
+void
+bclient_stop (bclient_t *b)
+{
+    unsigned sock = b->c.sock;
+
+    send_tx (b);
+    if (sock < MAX_SOCK_NUM)
+        wait_sent (b);
+    client_stop (&b->c);
+    if (sock < MAX_SOCK_NUM)
+        w5100_cache_invalidate (sock);
+    reset (b);
+}
+
+int
+bclient_connected (bclient_t *b)
+{
+    return b->rlen > 0 || client_connected (&b->c);
+}
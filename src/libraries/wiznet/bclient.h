@@ -0,0 +1,54 @@
+/*
+ * Buffered TCP client stream.
+ *
+ * Same operations as client_*() in <wiznet/client.h>, but received
+ * data is pulled from the chip into a ring buffer in one pass
+ * per SnRX_RSR amount, and transmitted data is collected in a
+ * buffer which is sent when it reaches the segment size, or on
+ * bclient_flush().  Byte-at-a-time protocols then cost a memory
+ * access per byte instead of several SPI transactions.
+ *
+ * Note that bclient_flush() sends pending output, while the stock
+ * client_flush() discards pending input.
+ */
+#ifndef BCLIENT_H_INCLUDED
+#define BCLIENT_H_INCLUDED
+
+#include <wiznet/ethernet.h>
+
+#ifndef BCLIENT_RXSIZE
+#define BCLIENT_RXSIZE  1024    /* receive ring size */
+#endif
+#ifndef BCLIENT_TXSIZE
+#define BCLIENT_TXSIZE  1460    /* transmit buffer size, default W5100 MSS */
+#endif
+
+struct _bclient_t {
+    client_t    c;
+    unsigned    rpos;           /* read index in rx */
+    unsigned    rlen;           /* bytes buffered in rx */
+    unsigned    tlen;           /* bytes buffered in tx */
+    unsigned    mss;            /* send when tlen reaches this */
+    unsigned    sending;        /* SEND issued, SEND_OK not yet seen */
+    uint8_t     rx [BCLIENT_RXSIZE];
+    uint8_t     tx [BCLIENT_TXSIZE];
+};
+typedef struct _bclient_t bclient_t;
+
+void bclient_init (bclient_t *b, uint8_t *ip, unsigned port);
+void bclient_init_sock (bclient_t *b, unsigned sock);
+
+unsigned bclient_status (bclient_t *b);
+int bclient_connect (bclient_t *b);
+void bclient_putc (bclient_t *b, uint8_t byte);
+void bclient_puts (bclient_t *b, const char *str);
+void bclient_write (bclient_t *b, const uint8_t *buf, unsigned size);
+int bclient_available (bclient_t *b);
+int bclient_getc (bclient_t *b);
+int bclient_read (bclient_t *b, uint8_t *buf, unsigned size);
+int bclient_peek (bclient_t *b);
+int bclient_flush (bclient_t *b);
+void bclient_stop (bclient_t *b);
+int bclient_connected (bclient_t *b);
+
+#endif
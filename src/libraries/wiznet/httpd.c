@@ -0,0 +1,495 @@
+/*
+ * HTTP/1.1 server engine for the wiznet library.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "httpd.h"
+
+/*
+ * Parser states.
+ */
+#define S_METHOD    0           /* request method */
+#define S_PATH      1           /* request target */
+#define S_VERSION   2           /* protocol version */
+#define S_NAME      3           /* header name */
+#define S_VALUE     4           /* header value */
+#define S_BODY      5           /* skipping the body of the last request */
+
+static const struct {
+    const char  *ext;
+    const char  *type;
+} mime_types[] = {
+    { ".html",  "text/html" },
+    { ".htm",   "text/html" },
+    { ".txt",   "text/plain" },
+    { ".css",   "text/css" },
+    { ".js",    "application/javascript" },
+    { ".json",  "application/json" },
+    { ".png",   "image/png" },
+    { ".jpg",   "image/jpeg" },
+    { ".gif",   "image/gif" },
+    { ".ico",   "image/x-icon" },
+    { 0,        "application/octet-stream" },
+};
+
+static const char *
+reason (unsigned status)
+{
+    switch (status) {
+    case 200: return "OK";
+    case 400: return "Bad Request";
+    case 403: return "Forbidden";
+    case 404: return "Not Found";
+    case 414: return "URI Too Long";
+    case 501: return "Not Implemented";
+    case 505: return "HTTP Version Not Supported";
+    }
+    return "Error";
+}
+
+static const char *
+mime_type (const char *name)
+{
+    const char *ext = strrchr (name, '.');
+    unsigned i;
+
+    for (i=0; mime_types[i].ext; i++)
+        if (ext && strcasecmp (ext, mime_types[i].ext) == 0)
+            break;
+    return mime_types[i].type;
+}
+
+static void
+reset_request (struct httpd_conn *c)
+{
+    c->state = S_METHOD;
+    c->status = 0;
+    c->method = 0;
+    c->version = 10;
+    c->keepalive = 0;
+    c->length = 0;
+    c->body = 0;
+    c->tlen = 0;
+    c->plen = 0;
+}
+
+static void
+close_file (struct httpd_conn *c)
+{
+    if (c->file >= 0)
+        close (c->file);
+    c->file = -1;
+    c->fileleft = 0;
+}
+
+static void
+reset (struct httpd_conn *c, unsigned sock)
+{
+    client_init_sock (&c->c, sock);
+    close_file (c);
+    c->rpos = 0;
+    c->rlen = 0;
+    reset_request (c);
+}
+
+/*
+ * Send FIN and forget the connection.
+ */
+static void
+disconnect (struct httpd *h, struct httpd_conn *c)
+{
+    close_file (c);
+    c->rpos = 0;
+    c->rlen = 0;
+    reset_request (c);
+    wzserver_close (&h->srv, &c->c);
+}
+
+static int
+connected (struct httpd *h, struct httpd_conn *c)
+{
+    return (h->srv.connected >> c->c.sock) & 1;
+}
+
+static void
+add_char (char *buf, unsigned size, unsigned *len, int ch)
+{
+    if (*len < size - 1)
+        buf [(*len)++] = ch;
+}
+
+static void
+header (struct httpd_conn *c)
+{
+    while (c->tlen > 0 && (c->val[c->tlen-1] == ' ' ||
+        c->val[c->tlen-1] == '\t'))
+        c->tlen--;
+    c->val[c->tlen] = 0;
+
+    if (strcmp (c->tok, "content-length") == 0) {
+        c->length = strtoul (c->val, 0, 10);
+    } else if (strcmp (c->tok, "connection") == 0) {
+        if (strcasecmp (c->val, "close") == 0)
+            c->keepalive = 0;
+        else if (strcasecmp (c->val, "keep-alive") == 0)
+            c->keepalive = 1;
+    } else if (strcmp (c->tok, "transfer-encoding") == 0) {
+        /* Chunked request bodies are not supported. */
+        c->status = 501;
+    }
+}
+
+/*
+ * Feed one byte to the parser.
+ * Returns 1 when the request headers are complete.
+ */
+static int
+parse (struct httpd_conn *c, int ch)
+{
+    if (ch == '\r')
+        return 0;
+
+    switch (c->state) {
+    case S_METHOD:
+        if (ch == '\n' && c->tlen == 0)
+            break;                      /* empty line before request */
+        if (ch != ' ' && ch != '\n') {
+            add_char (c->tok, HTTPD_TOKSIZE, &c->tlen, ch);
+            break;
+        }
+        c->tok[c->tlen] = 0;
+        c->method = (strcmp (c->tok, "GET") == 0) ? HTTPD_GET :
+                    (strcmp (c->tok, "HEAD") == 0) ? HTTPD_HEAD :
+                    (strcmp (c->tok, "POST") == 0) ? HTTPD_POST :
+                    (strcmp (c->tok, "PUT") == 0) ? HTTPD_PUT :
+                    (strcmp (c->tok, "DELETE") == 0) ? HTTPD_DELETE :
+                    HTTPD_OTHER;
+        c->tlen = 0;
+        if (ch == '\n') {
+            c->status = 400;
+            return 1;
+        }
+        c->state = S_PATH;
+        break;
+
+    case S_PATH:
+        if (ch == ' ' || ch == '\n') {
+            c->path[c->plen] = 0;
+            if (ch == '\n')
+                return 1;               /* HTTP/0.9 request */
+            c->state = S_VERSION;
+        } else if (c->plen < HTTPD_PATHSIZE - 1) {
+            c->path [c->plen++] = ch;
+        } else {
+            c->status = 414;
+        }
+        break;
+
+    case S_VERSION:
+        if (ch != '\n') {
+            add_char (c->tok, HTTPD_TOKSIZE, &c->tlen, ch);
+            break;
+        }
+        c->tok[c->tlen] = 0;
+        if (strcmp (c->tok, "HTTP/1.1") == 0) {
+            c->version = 11;
+            c->keepalive = 1;
+        } else if (strcmp (c->tok, "HTTP/1.0") != 0) {
+            c->status = 505;
+        }
+        c->tlen = 0;
+        c->state = S_NAME;
+        break;
+
+    case S_NAME:
+        if (ch == '\n') {
+            if (c->tlen == 0)
+                return 1;               /* end of headers */
+            c->tlen = 0;                /* no colon: ignore the line */
+        } else if (ch == ':') {
+            c->tok[c->tlen] = 0;
+            c->tlen = 0;
+            c->state = S_VALUE;
+        } else {
+            if (ch >= 'A' && ch <= 'Z')
+                ch += 'a' - 'A';
+            add_char (c->tok, HTTPD_TOKSIZE, &c->tlen, ch);
+        }
+        break;
+
+    case S_VALUE:
+        if (ch == '\n') {
+            header (c);
+            c->tlen = 0;
+            c->state = S_NAME;
+        } else if (c->tlen > 0 || (ch != ' ' && ch != '\t')) {
+            add_char (c->val, HTTPD_VALSIZE, &c->tlen, ch);
+        }
+        break;
+    }
+    return 0;
+}
+
+void
+httpd_response (struct httpd_conn *c, unsigned status, const char *type,
+    long length)
+{
+    char hdr [192];
+    int n;
+
+    if (length < 0)
+        c->keepalive = 0;
+    n = sprintf (hdr, "HTTP/1.%u %u %s\r\n", (c->version == 11), status,
+        reason (status));
+    if (type)
+        n += sprintf (hdr + n, "Content-Type: %.64s\r\n", type);
+    if (length >= 0)
+        n += sprintf (hdr + n, "Content-Length: %ld\r\n", length);
+    n += sprintf (hdr + n, "Connection: %s\r\n\r\n",
+        c->keepalive ? "keep-alive" : "close");
+    client_write (&c->c, (const uint8_t*) hdr, n);
+}
+
+static void
+error (struct httpd_conn *c, unsigned status)
+{
+    char body [48];
+    int n;
+
+    c->keepalive = 0;
+    n = sprintf (body, "%u %s\n", status, reason (status));
+    httpd_response (c, status, "text/plain", n);
+    if (c->method != HTTPD_HEAD)
+        client_write (&c->c, (const uint8_t*) body, n);
+}
+
+int
+httpd_read (struct httpd_conn *c, uint8_t *buf, unsigned len)
+{
+    int n;
+
+    if (len > c->body)
+        len = c->body;
+    if (len == 0)
+        return 0;
+
+    if (c->rpos < c->rlen) {
+        n = c->rlen - c->rpos;
+        if (n > len)
+            n = len;
+        memcpy (buf, c->in + c->rpos, n);
+        c->rpos += n;
+    } else {
+        n = client_available (&c->c);
+        if (n > len)
+            n = len;
+        if (n <= 0)
+            return 0;
+        n = client_read (&c->c, buf, n);
+        if (n <= 0)
+            return 0;
+    }
+    c->body -= n;
+    return n;
+}
+
+/*
+ * Start serving a file from the document root.
+ */
+static void
+open_file (struct httpd *h, struct httpd_conn *c)
+{
+    char name [HTTPD_PATHSIZE + 64];
+    struct stat st;
+    char *query;
+    int fd;
+
+    query = strchr (c->path, '?');
+    if (query)
+        *query = 0;
+    if (! h->docroot || c->path[0] != '/') {
+        error (c, 404);
+        return;
+    }
+    if (strstr (c->path, "..")) {
+        error (c, 403);
+        return;
+    }
+    if (strlen (h->docroot) + strlen (c->path) + sizeof "index.html" >
+        sizeof name) {
+        error (c, 414);
+        return;
+    }
+    strcpy (name, h->docroot);
+    strcat (name, c->path);
+    if (name [strlen (name) - 1] == '/')
+        strcat (name, "index.html");
+
+    fd = open (name, O_RDONLY);
+    if (fd < 0) {
+        error (c, 404);
+        return;
+    }
+    if (fstat (fd, &st) < 0 || ! S_ISREG (st.st_mode)) {
+        close (fd);
+        error (c, 404);
+        return;
+    }
+    httpd_response (c, 200, mime_type (name), st.st_size);
+    if (c->method == HTTPD_HEAD || st.st_size == 0) {
+        close (fd);
+        return;
+    }
+    c->file = fd;
+    c->fileleft = st.st_size;
+}
+
+/*
+ * The reply is complete: close the connection, or get ready
+ * for the next request, skipping what is left of the body.
+ */
+static void
+end_request (struct httpd *h, struct httpd_conn *c)
+{
+    unsigned long body = c->body;
+
+    if (! c->keepalive) {
+        disconnect (h, c);
+        return;
+    }
+    reset_request (c);
+    if (body > 0) {
+        c->body = body;
+        c->state = S_BODY;
+    }
+}
+
+static void
+answer (struct httpd *h, struct httpd_conn *c)
+{
+    c->body = c->length;
+    if (c->status)
+        error (c, c->status);
+    else if (h->handler && h->handler (c))
+        ;
+    else if (c->method == HTTPD_GET || c->method == HTTPD_HEAD)
+        open_file (h, c);
+    else
+        error (c, 501);
+
+    if (c->file < 0)
+        end_request (h, c);
+}
+
+static void
+send_file (struct httpd *h, struct httpd_conn *c)
+{
+    int n;
+
+    n = (c->fileleft < HTTPD_CHUNK) ? c->fileleft : HTTPD_CHUNK;
+    n = read (c->file, h->chunk, n);
+    if (n <= 0) {
+        /* File got shorter: the length sent is wrong. */
+        c->keepalive = 0;
+        close_file (c);
+        end_request (h, c);
+        return;
+    }
+    client_write (&c->c, h->chunk, n);
+    c->fileleft -= n;
+    if (c->fileleft == 0) {
+        close_file (c);
+        end_request (h, c);
+    }
+}
+
+/*
+ * Do one piece of work for the connection: send a chunk of the
+ * file, read a buffer of input or answer one request.
+ * Returns 1 when there may be more to do.
+ */
+static int
+step (struct httpd *h, struct httpd_conn *c)
+{
+    unsigned n;
+
+    if (c->file >= 0) {
+        send_file (h, c);
+        return connected (h, c);
+    }
+    if (c->rpos == c->rlen) {
+        n = client_available (&c->c);
+        if (n == 0) {
+            if (client_status (&c->c) == SnSR_CLOSE_WAIT)
+                disconnect (h, c);
+            return 0;
+        }
+        if (n > HTTPD_INSIZE)
+            n = HTTPD_INSIZE;
+        c->rlen = client_read (&c->c, c->in, n);
+        c->rpos = 0;
+    }
+    while (c->rpos < c->rlen) {
+        if (c->state == S_BODY) {
+            n = c->rlen - c->rpos;
+            if (n > c->body)
+                n = c->body;
+            c->rpos += n;
+            c->body -= n;
+            if (c->body == 0)
+                reset_request (c);
+            continue;
+        }
+        if (parse (c, c->in [c->rpos++])) {
+            answer (h, c);
+            return connected (h, c);
+        }
+    }
+    return 1;
+}
+
+static void
+event (struct wzserver *s, unsigned ev, client_t *client)
+{
+    struct httpd *h = s->arg;
+    struct httpd_conn *c = &h->conn [client->sock];
+
+    switch (ev) {
+    case WZS_CONNECT:
+        reset (c, client->sock);
+        break;
+    case WZS_SLICE:
+        while (step (h, c) && ! wzserver_expired (s))
+            continue;
+        break;
+    case WZS_CLOSE:
+        close_file (c);
+        break;
+    }
+}
+
+void
+httpd_init (struct httpd *h, unsigned port, const char *docroot,
+            httpd_handler_t *handler)
+{
+    unsigned sock;
+
+    h->docroot = docroot;
+    h->handler = handler;
+    for (sock=0; sock<MAX_SOCK_NUM; sock++) {
+        h->conn[sock].file = -1;
+        reset (&h->conn[sock], sock);
+    }
+    wzserver_init (&h->srv, port, event, h);
+}
+
+void
+httpd_poll (struct httpd *h)
+{
+    wzserver_poll (&h->srv);
+}
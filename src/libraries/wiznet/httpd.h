@@ -0,0 +1,108 @@
+/*
+ * HTTP/1.1 server engine for the wiznet library.
+ *
+ * One struct httpd serves a port through a struct wzserver, on
+ * all free hardware sockets or on srv.maxconn of them.  In its time
+ * slice, a connection parses input, answers requests and sends
+ * file chunks until its slice (srv.slice) is used up, so a large
+ * download does not hold up the other clients.
+ *
+ * Requests are parsed incrementally into fixed buffers in the
+ * connection, nothing is allocated.  Connections are kept alive
+ * as HTTP/1.1 asks, and pipelined requests are answered in order.
+ *
+ * A request is first offered to the handler; when there is none,
+ * or it returns 0, GET and HEAD are served from the files under
+ * the document root.
+ */
+#ifndef HTTPD_H_INCLUDED
+#define HTTPD_H_INCLUDED
+
+#include "wzserver.h"
+
+#ifndef HTTPD_INSIZE
+#define HTTPD_INSIZE    512     /* input buffer per connection */
+#endif
+#ifndef HTTPD_PATHSIZE
+#define HTTPD_PATHSIZE  128     /* longest request path */
+#endif
+#ifndef HTTPD_CHUNK
+#define HTTPD_CHUNK     1024    /* file data sent per step */
+#endif
+
+#define HTTPD_TOKSIZE   24      /* method, version, header name */
+#define HTTPD_VALSIZE   32      /* header value, as far as needed */
+
+/*
+ * Request methods.
+ */
+#define HTTPD_GET       1
+#define HTTPD_HEAD      2
+#define HTTPD_POST      3
+#define HTTPD_PUT       4
+#define HTTPD_DELETE    5
+#define HTTPD_OTHER     6
+
+struct httpd_conn {
+    client_t        c;
+    unsigned        state;          /* parser state */
+    unsigned        status;         /* error found by the parser, or 0 */
+    unsigned        method;         /* HTTPD_* */
+    unsigned        version;        /* 10 or 11 */
+    unsigned        keepalive;      /* keep the connection after the reply */
+    unsigned long   length;         /* Content-Length */
+    unsigned long   body;           /* body bytes not yet read */
+    int             file;           /* file being sent, or -1 */
+    unsigned long   fileleft;       /* bytes of it still to send */
+    unsigned        rpos;           /* read index in in[] */
+    unsigned        rlen;           /* bytes in in[] */
+    unsigned        tlen;           /* bytes in tok[] or val[] */
+    unsigned        plen;           /* bytes in path[] */
+    char            path [HTTPD_PATHSIZE];
+    char            tok [HTTPD_TOKSIZE];
+    char            val [HTTPD_VALSIZE];
+    uint8_t         in [HTTPD_INSIZE];
+};
+
+/*
+ * Called for every request with the headers parsed.
+ * Returns 1 when the request was answered, 0 to pass it on
+ * to the file server.
+ */
+typedef int httpd_handler_t (struct httpd_conn *c);
+
+struct httpd {
+    struct wzserver srv;
+    const char      *docroot;
+    httpd_handler_t *handler;
+    uint8_t         chunk [HTTPD_CHUNK];
+    struct httpd_conn conn [MAX_SOCK_NUM];
+};
+
+/*
+ * Set up the server; it starts listening at the first httpd_poll(),
+ * so srv.maxconn and srv.slice can be set in between.
+ * docroot may be 0 to serve no files.
+ */
+void httpd_init (struct httpd *h, unsigned port, const char *docroot,
+                 httpd_handler_t *handler);
+
+/*
+ * Accept new clients and give every connection one time slice.
+ */
+void httpd_poll (struct httpd *h);
+
+/*
+ * Send the status line and headers of a reply.  With a negative
+ * length the body runs until the connection is closed.
+ */
+void httpd_response (struct httpd_conn *c, unsigned status,
+                     const char *type, long length);
+
+/*
+ * Read the request body.  Returns the number of bytes read,
+ * 0 at the end of the body or when no data has arrived yet.
+ */
+int httpd_read (struct httpd_conn *c, uint8_t *buf, unsigned len);
+
+#endif
@@ -0,0 +1,391 @@
+/*
+ * Burst register access for the W5100 chip.
+ */
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/spi.h>
+#include "w5100burst.h"
+
+#define CMD_WRITE       0xF0
+#define CMD_READ        0x0F
+
+/*
+ * Cached registers: GAR..SIPR and IMR..TMSR in the common
+ * block, SnMR, SnPORT and SnPROTO..SnTTL in each socket block.
+ * Peer address and MSS registers are set by the chip on
+ * connection, so they are not cached.
+ */
+#define COMMON_CACHED(a)    (((a) >= 0x01 && (a) <= 0x14) || \
+                             ((a) >= 0x16 && (a) <= 0x1B))
+#define SOCK_CACHED(a)      ((a) == 0x00 || (a) == 0x04 || (a) == 0x05 || \
+                             ((a) >= 0x14 && (a) <= 0x16))
+#define SOCK_NREGS          0x17
+
+static int spi = -1;
+static uint8_t frame [W5100_BURST_MAX * 4];
+static uint8_t ir_latched [MAX_SOCK_NUM];
+
+static uint8_t common_cache [0x1C];
+static uint8_t common_valid [0x1C];
+static uint8_t sock_cache [MAX_SOCK_NUM] [SOCK_NREGS];
+static uint8_t sock_valid [MAX_SOCK_NUM] [SOCK_NREGS];
+
+unsigned w5100_sbase [MAX_SOCK_NUM];
+unsigned w5100_ssize [MAX_SOCK_NUM];
+unsigned w5100_rbase [MAX_SOCK_NUM];
+unsigned w5100_rsize [MAX_SOCK_NUM];
+
+struct w5100_burst_stats w5100_burst_stats;
+
+int
+w5100_burst_init ()
+{
+    if (spi < 0) {
+        spi = open (W5100_SPI_DEVICE, O_RDWR);
+        if (spi < 0)
+            return -1;
+        ioctl (spi, SPICTL_SETRATE, W5100_SPI_KHZ);
+        ioctl (spi, SPICTL_SETSELPIN, W5100_SPI_SELPIN);
+    }
+
+    w5100_cache_invalidate (MAX_SOCK_NUM);
+    w5100_burst_layout ();
+    return 0;
+}
+
+/*
+ * Split 8 kbytes of socket memory as given by a RMSR or TMSR value:
+ * two bits per socket, for 1, 2, 4 or 8 kbytes.
+ */
+static void
+set_layout (unsigned msr, unsigned base, unsigned *sbase, unsigned *ssize)
+{
+    unsigned i, size, used;
+
+    used = 0;
+    for (i=0; i<MAX_SOCK_NUM; i++) {
+        size = 1024 << ((msr >> (i*2)) & 3);
+        if (used + size > 8192)
+            size = 0;
+        sbase[i] = base + used;
+        ssize[i] = size;
+        used += size;
+    }
+}
+
+void
+w5100_burst_layout ()
+{
+    uint8_t msr[2];
+
+    w5100_burst_read (0x001A, msr, 2);
+    set_layout (msr[0], W5100_RXBASE, w5100_rbase, w5100_rsize);
+    set_layout (msr[1], W5100_TXBASE, w5100_sbase, w5100_ssize);
+}
+
+void
+w5100_cache_invalidate (unsigned sock)
+{
+    unsigned i;
+
+    if (sock < MAX_SOCK_NUM) {
+        for (i=0; i<SOCK_NREGS; i++)
+            sock_valid[sock][i] = 0;
+        return;
+    }
+    for (i=0; i<sizeof common_valid; i++)
+        common_valid[i] = 0;
+    for (sock=0; sock<MAX_SOCK_NUM; sock++)
+        w5100_cache_invalidate (sock);
+}
+
+/*
+ * Return a pointer to the cache entry for the given address,
+ * or 0 when the register is not cacheable.
+ */
+static uint8_t *
+cache_entry (unsigned addr, uint8_t **valid)
+{
+    unsigned sock, reg;
+
+    if (addr < CH_BASE) {
+        if (! COMMON_CACHED (addr))
+            return 0;
+        *valid = &common_valid[addr];
+        return &common_cache[addr];
+    }
+    sock = (addr - CH_BASE) / CH_SIZE;
+    reg = (addr - CH_BASE) % CH_SIZE;
+    if (sock >= MAX_SOCK_NUM || ! SOCK_CACHED (reg))
+        return 0;
+    *valid = &sock_valid[sock][reg];
+    return &sock_cache[sock][reg];
+}
+
+static int
+cache_lookup (unsigned addr, uint8_t *buf, unsigned len)
+{
+    uint8_t *entry, *valid;
+    unsigned i;
+
+    for (i=0; i<len; i++) {
+        entry = cache_entry (addr + i, &valid);
+        if (! entry || ! *valid)
+            return 0;
+    }
+    for (i=0; i<len; i++)
+        buf[i] = *cache_entry (addr + i, &valid);
+    w5100_burst_stats.cache_hits += len;
+    return 1;
+}
+
+static void
+cache_store (unsigned addr, const uint8_t *buf, unsigned len)
+{
+    uint8_t *entry, *valid;
+    unsigned i;
+
+    for (i=0; i<len; i++) {
+        entry = cache_entry (addr + i, &valid);
+        if (entry) {
+            *entry = buf[i];
+            *valid = 1;
+        }
+    }
+}
+
+/*
+ * Run nframes prepared frames, one chip select cycle each.
+ */
+static void
+transfer (unsigned nframes)
+{
+    unsigned i;
+
+    for (i=0; i<nframes; i++)
+        ioctl (spi, SPICTL_IO8(4), frame + i*4);
+    w5100_burst_stats.transfers += nframes;
+    w5100_burst_stats.frames += nframes;
+}
+
+static void
+put_frame (unsigned n, unsigned cmd, unsigned addr, unsigned data)
+{
+    uint8_t *p = frame + n*4;
+
+    p[0] = cmd;
+    p[1] = addr >> 8;
+    p[2] = addr;
+    p[3] = data;
+}
+
+unsigned
+w5100_burst_read (unsigned addr, uint8_t *buf, unsigned len)
+{
+    unsigned n, i, done;
+
+    if (cache_lookup (addr, buf, len))
+        return len;
+
+    for (done=0; done<len; done+=n) {
+        n = len - done;
+        if (n > W5100_BURST_MAX)
+            n = W5100_BURST_MAX;
+        for (i=0; i<n; i++)
+            put_frame (i, CMD_READ, addr + done + i, 0xFF);
+        transfer (n);
+        for (i=0; i<n; i++)
+            buf[done + i] = frame[i*4 + 3];
+    }
+    cache_store (addr, buf, len);
+    return len;
+}
+
+unsigned
+w5100_burst_write (unsigned addr, const uint8_t *buf, unsigned len)
+{
+    unsigned n, i, done;
+
+    for (done=0; done<len; done+=n) {
+        n = len - done;
+        if (n > W5100_BURST_MAX)
+            n = W5100_BURST_MAX;
+        for (i=0; i<n; i++)
+            put_frame (i, CMD_WRITE, addr + done + i, buf[done + i]);
+        transfer (n);
+    }
+    cache_store (addr, buf, len);
+
+    /* New memory sizes take effect at once. */
+    if (addr <= 0x001B && addr + len > 0x001A)
+        w5100_burst_layout ();
+    return len;
+}
+
+void
+w5100_burst_gather (const unsigned *addr, uint8_t *buf, unsigned n)
+{
+    unsigned i;
+
+    for (i=0; i<n; i++)
+        put_frame (i, CMD_READ, addr[i], 0xFF);
+    transfer (n);
+    for (i=0; i<n; i++)
+        buf[i] = frame[i*4 + 3];
+}
+
+void
+w5100_burst_scatter (const unsigned *addr, const uint8_t *buf, unsigned n)
+{
+    unsigned i;
+
+    for (i=0; i<n; i++)
+        put_frame (i, CMD_WRITE, addr[i], buf[i]);
+    transfer (n);
+}
+
+unsigned
+w5100_burst_read16 (unsigned addr)
+{
+    uint8_t buf[2];
+    unsigned first, second;
+
+    if (cache_lookup (addr, buf, 2))
+        return buf[0] << 8 | buf[1];
+
+    /* Read the register twice until both values agree. */
+    do {
+        put_frame (0, CMD_READ, addr, 0xFF);
+        put_frame (1, CMD_READ, addr + 1, 0xFF);
+        put_frame (2, CMD_READ, addr, 0xFF);
+        put_frame (3, CMD_READ, addr + 1, 0xFF);
+        transfer (4);
+        first = frame[3] << 8 | frame[7];
+        second = frame[11] << 8 | frame[15];
+    } while (first != second);
+
+    buf[0] = first >> 8;
+    buf[1] = first;
+    cache_store (addr, buf, 2);
+    return first;
+}
+
+void
+w5100_burst_write16 (unsigned addr, unsigned data)
+{
+    uint8_t buf[2];
+
+    buf[0] = data >> 8;
+    buf[1] = data;
+    w5100_burst_write (addr, buf, 2);
+}
+
+unsigned
+w5100_burst_tx_free (unsigned sock)
+{
+    return w5100b_readSnTX_FSR (sock);
+}
+
+unsigned
+w5100_burst_rx_size (unsigned sock)
+{
+    return w5100b_readSnRX_RSR (sock);
+}
+
+void
+w5100_burst_cmd (unsigned sock, unsigned cmd)
+{
+    w5100b_writeSnCR (sock, cmd);
+    while (w5100b_readSnCR (sock))
+        continue;
+    if (cmd == Sock_OPEN)
+        ir_latched[sock] = 0;
+}
+
+void
+w5100_burst_ir_latch (unsigned sock, unsigned bits)
+{
+    ir_latched[sock] |= bits;
+}
+
+unsigned
+w5100_burst_wait_send (unsigned sock, unsigned mask)
+{
+    unsigned ir;
+
+    for (;;) {
+        ir = (ir_latched[sock] | w5100b_readSnIR (sock)) & mask;
+        if (ir)
+            break;
+        if (w5100b_readSnSR (sock) == SnSR_CLOSED)
+            return 0;
+    }
+    ir_latched[sock] &= ~ir;
+    w5100b_writeSnIR (sock, ir);
+    return ir;
+}
+
+/*
+ * Copy data from the RX memory of the socket, starting at
+ * pointer value src, wrapping at the end of the socket buffer.
+ */
+void
+w5100_burst_read_data (unsigned sock, unsigned src, uint8_t *dst, unsigned len)
+{
+    unsigned size = w5100_rsize[sock];
+    unsigned offset = src & (size - 1);
+    unsigned addr = w5100_rbase[sock] + offset;
+    unsigned n;
+
+    if (offset + len > size) {
+        n = size - offset;
+        w5100_burst_read (addr, dst, n);
+        w5100_burst_read (w5100_rbase[sock], dst + n, len - n);
+    } else {
+        w5100_burst_read (addr, dst, len);
+    }
+}
+
+void
+w5100_burst_recv_chunk (unsigned sock, uint8_t *data, unsigned len)
+{
+    unsigned ptr = w5100b_readSnRX_RD (sock);
+
+    w5100_burst_read_data (sock, ptr, data, len);
+    w5100b_writeSnRX_RD (sock, ptr + len);
+    w5100_burst_stats.rx_bytes += len;
+    w5100_burst_stats.sock_rx[sock] += len;
+}
+
+/*
+ * Copy data to the TX memory of the socket, starting at
+ * pointer value dst, wrapping at the end of the socket buffer.
+ */
+void
+w5100_burst_write_data (unsigned sock, unsigned dst, const uint8_t *src,
+    unsigned len)
+{
+    unsigned size = w5100_ssize[sock];
+    unsigned offset = dst & (size - 1);
+    unsigned addr = w5100_sbase[sock] + offset;
+    unsigned n;
+
+    if (offset + len > size) {
+        n = size - offset;
+        w5100_burst_write (addr, src, n);
+        w5100_burst_write (w5100_sbase[sock], src + n, len - n);
+    } else {
+        w5100_burst_write (addr, src, len);
+    }
+}
+
+void
+w5100_burst_send_chunk (unsigned sock, const uint8_t *data, unsigned len)
+{
+    unsigned ptr = w5100b_readSnTX_WR (sock);
+
+    w5100_burst_write_data (sock, ptr, data, len);
+    w5100b_writeSnTX_WR (sock, ptr + len);
+    w5100_burst_stats.tx_bytes += len;
+    w5100_burst_stats.sock_tx[sock] += len;
+}
@@ -0,0 +1,163 @@
+/*
+ * Burst register access for the W5100 chip.
+ *
+ * The W5100 has no burst mode: every byte is a 4-byte frame, and
+ * the chip takes one frame per chip select cycle.  The SPI driver
+ * holds select for the whole of an SPICTL_IO8 call, so each frame
+ * is an ioctl of its own, here as in the stock accessors of
+ * <wiznet/w5100.h>.  This layer saves frames instead: it prepares
+ * ranges and lists of registers up to W5100_BURST_MAX frames at a
+ * time, and keeps a cache.
+ *
+ * Configuration registers which only change when written by the
+ * host are cached.  Status, interrupt, command and pointer
+ * registers are always read from the chip.  After calling the
+ * stock socket_*() routines, which bypass the cache, use
+ * w5100_cache_invalidate().
+ */
+#ifndef W5100BURST_H_INCLUDED
+#define W5100BURST_H_INCLUDED
+
+#include <wiznet/w5100.h>
+
+/*
+ * SPI port settings, same as used by w5100_init().
+ */
+#define W5100_SPI_DEVICE    "/dev/spi2"
+#define W5100_SPI_KHZ       5000
+#define W5100_SPI_SELPIN    0x404
+
+#define W5100_BURST_MAX     63      /* frames prepared at a time */
+
+#define W5100_TXBASE        0x4000  /* start of TX memory */
+#define W5100_RXBASE        0x6000  /* start of RX memory */
+
+/*
+ * Socket memory layout, as set by RMSR/TMSR.  Memory is given
+ * to the sockets in order; a socket which does not fit in the
+ * 8 kbytes left has size 0.
+ */
+extern unsigned w5100_sbase [MAX_SOCK_NUM];
+extern unsigned w5100_ssize [MAX_SOCK_NUM];
+extern unsigned w5100_rbase [MAX_SOCK_NUM];
+extern unsigned w5100_rsize [MAX_SOCK_NUM];
+
+/*
+ * Transfer statistics.
+ */
+struct w5100_burst_stats {
+    unsigned long   transfers;      /* SPI ioctls, one per frame */
+    unsigned long   frames;         /* 4-byte frames sent */
+    unsigned long   cache_hits;     /* register bytes served from cache */
+    unsigned long   rx_bytes;       /* payload bytes read from RX memory */
+    unsigned long   tx_bytes;       /* payload bytes written to TX memory */
+    unsigned long   sock_rx [MAX_SOCK_NUM]; /* rx_bytes per socket */
+    unsigned long   sock_tx [MAX_SOCK_NUM]; /* tx_bytes per socket */
+};
+
+extern struct w5100_burst_stats w5100_burst_stats;
+
+/*
+ * Open the SPI port.  Call after w5100_init().
+ * Returns 0 on success, -1 on failure.
+ */
+int w5100_burst_init (void);
+
+/*
+ * Recompute the socket memory layout from RMSR and TMSR.
+ * Done by w5100_burst_init() and by every write of RMSR or TMSR
+ * through w5100_burst_write().
+ */
+void w5100_burst_layout (void);
+
+/*
+ * Read or write a range of consecutive addresses.
+ */
+unsigned w5100_burst_read (unsigned addr, uint8_t *buf, unsigned len);
+unsigned w5100_burst_write (unsigned addr, const uint8_t *buf, unsigned len);
+
+/*
+ * Read or write n registers at arbitrary addresses,
+ * n up to W5100_BURST_MAX.  The cache is bypassed:
+ * use them for status, interrupt and pointer registers only.
+ */
+void w5100_burst_gather (const unsigned *addr, uint8_t *buf, unsigned n);
+void w5100_burst_scatter (const unsigned *addr, const uint8_t *buf,
+                          unsigned n);
+
+/*
+ * 16-bit registers.  The register is read twice, and again until
+ * two consecutive values match, as required for SnTX_FSR and SnRX_RSR.
+ */
+unsigned w5100_burst_read16 (unsigned addr);
+void w5100_burst_write16 (unsigned addr, unsigned data);
+
+/*
+ * Drop cached values of socket registers, or of all
+ * registers when sock is MAX_SOCK_NUM.
+ */
+void w5100_cache_invalidate (unsigned sock);
+
+/*
+ * Socket data path.  The chunk routines update the RX read or
+ * TX write pointer; the caller then issues Sock_RECV or Sock_SEND.
+ */
+void w5100_burst_read_data (unsigned sock, unsigned src, uint8_t *dst,
+                            unsigned len);
+void w5100_burst_write_data (unsigned sock, unsigned dst, const uint8_t *src,
+                             unsigned len);
+void w5100_burst_recv_chunk (unsigned sock, uint8_t *data, unsigned len);
+void w5100_burst_send_chunk (unsigned sock, const uint8_t *data, unsigned len);
+unsigned w5100_burst_tx_free (unsigned sock);
+unsigned w5100_burst_rx_size (unsigned sock);
+
+/*
+ * Issue a socket command and wait until the chip accepts it.
+ */
+void w5100_burst_cmd (unsigned sock, unsigned cmd);
+
+/*
+ * Wait for the end of a SEND: until SnIR has one of the bits in
+ * mask (SnIR_SEND_OK, and SnIR_TIMEOUT for UDP), then clear them.
+ * Returns the bits seen, or 0 when the socket is closed.
+ *
+ * wz_poll() clears SnIR to release /INT; the bits a sender
+ * waits for are kept for it with w5100_burst_ir_latch().
+ */
+unsigned w5100_burst_wait_send (unsigned sock, unsigned mask);
+void w5100_burst_ir_latch (unsigned sock, unsigned bits);
+
+#define __BURST_SOCKET_REGISTER8(name, address)                             \
+    static inline void w5100b_write##name (unsigned sock, unsigned data) {  \
+        uint8_t byte = data;                                                \
+        w5100_burst_write (CH_BASE + sock*CH_SIZE + address, &byte, 1);     \
+    }                                                                       \
+    static inline unsigned w5100b_read##name (unsigned sock) {              \
+        uint8_t byte;                                                       \
+        w5100_burst_read (CH_BASE + sock*CH_SIZE + address, &byte, 1);      \
+        return byte;                                                        \
+    }
+#define __BURST_SOCKET_REGISTER16(name, address)                            \
+    static inline void w5100b_write##name (unsigned sock, unsigned data) {  \
+        w5100_burst_write16 (CH_BASE + sock*CH_SIZE + address, data);       \
+    }                                                                       \
+    static inline unsigned w5100b_read##name (unsigned sock) {              \
+        return w5100_burst_read16 (CH_BASE + sock*CH_SIZE + address);       \
+    }
+
+__BURST_SOCKET_REGISTER8(SnMR,      0x0000)     // Mode
+__BURST_SOCKET_REGISTER8(SnCR,      0x0001)     // Command
+__BURST_SOCKET_REGISTER8(SnIR,      0x0002)     // Interrupt
+__BURST_SOCKET_REGISTER8(SnSR,      0x0003)     // Status
+__BURST_SOCKET_REGISTER16(SnPORT,   0x0004)     // Source Port
+__BURST_SOCKET_REGISTER16(SnDPORT,  0x0010)     // Destination Port
+__BURST_SOCKET_REGISTER16(SnMSSR,   0x0012)     // Max Segment Size
+__BURST_SOCKET_REGISTER16(SnTX_FSR, 0x0020)     // TX Free Size
+__BURST_SOCKET_REGISTER16(SnTX_WR,  0x0024)     // TX Write Pointer
+__BURST_SOCKET_REGISTER16(SnRX_RSR, 0x0026)     // RX Received Size
+__BURST_SOCKET_REGISTER16(SnRX_RD,  0x0028)     // RX Read Pointer
+
+#undef __BURST_SOCKET_REGISTER8
+#undef __BURST_SOCKET_REGISTER16
+
+#endif
@@ -0,0 +1,257 @@
+/*
+ * Readiness events for the W5100 sockets.
+ */
+#include <unistd.h>
+#include <sys/select.h>
+#include "w5100burst.h"
+#include "wzevent.h"
+
+#define IR          0x0015      /* interrupt register, a bit per socket */
+#define NREGS       6           /* registers read per socket, at most */
+
+/*
+ * All of SnIR is acknowledged, or a pending SEND_OK would hold /INT
+ * low.  SEND_OK and TIMEOUT are latched for the sender waiting in
+ * w5100_burst_wait_send().
+ */
+#define IR_EVENTS   (SnIR_SEND_OK | SnIR_TIMEOUT | SnIR_RECV | \
+                     SnIR_DISCON | SnIR_CON)
+#define IR_SENDER   (SnIR_SEND_OK | SnIR_TIMEOUT)
+
+#define IS_CLOSED(status)   ((status) == SnSR_CLOSED || \
+                             (status) == SnSR_CLOSE_WAIT)
+
+static unsigned interest [MAX_SOCK_NUM];
+
+/*
+ * Socket state as of the last read of each register.
+ */
+static struct {
+    unsigned    status;         /* SnSR */
+    unsigned    rx;             /* SnRX_RSR */
+    unsigned    tx;             /* SnTX_FSR */
+} state [MAX_SOCK_NUM];
+
+void
+wz_watch (unsigned sock, unsigned events)
+{
+    unsigned base = CH_BASE + sock*CH_SIZE;
+    unsigned addr [5];
+    uint8_t imr, val [5];
+
+    interest[sock] = events;
+    if (events) {
+        addr[0] = base + 0x03;          /* SnSR */
+        addr[1] = base + 0x26;          /* SnRX_RSR */
+        addr[2] = base + 0x27;
+        addr[3] = base + 0x20;          /* SnTX_FSR */
+        addr[4] = base + 0x21;
+        w5100_burst_gather (addr, val, 5);
+        state[sock].status = val[0];
+        state[sock].rx = val[1] << 8 | val[2];
+        state[sock].tx = val[3] << 8 | val[4];
+    }
+
+    /* Let the socket drive the /INT line. */
+    w5100_burst_read (0x0016, &imr, 1);
+    if (events)
+        imr |= 1 << sock;
+    else
+        imr &= ~(1 << sock);
+    w5100_burst_write (0x0016, &imr, 1);
+}
+
+/*
+ * Add the address of a register to the gather list.
+ */
+static void
+want (unsigned *addr, unsigned *n, unsigned reg, unsigned len)
+{
+    while (len-- > 0)
+        addr[(*n)++] = reg++;
+}
+
+int
+wz_poll (struct wz_event *ev)
+{
+    unsigned addr [MAX_SOCK_NUM * NREGS];
+    uint8_t val [MAX_SOCK_NUM * NREGS];
+    unsigned clr_addr [MAX_SOCK_NUM];
+    uint8_t clr_val [MAX_SOCK_NUM];
+    unsigned sock, base, n, nclr, ir, events, pending, bit;
+    uint8_t flags, *v;
+
+    pending = 0;
+    for (sock=0; sock<MAX_SOCK_NUM; sock++)
+        if (interest[sock])
+            pending |= 1 << sock;
+    if (pending == 0)
+        return 0;
+
+    /* IR tells which sockets have something new. */
+    addr[0] = IR;
+    w5100_burst_gather (addr, &flags, 1);
+    pending &= flags;
+
+    /*
+     * A flagged socket has SnIR, SnSR and SnRX_RSR read.  Otherwise
+     * only what confirms a level event is read: SnRX_RSR while data
+     * was left, SnSR while the socket was closed.  SnTX_FSR grows
+     * with SEND_OK but shrinks with no interrupt, so it is read on
+     * every poll for a socket watched for WZ_WRITABLE.
+     */
+    n = 0;
+    for (sock=0; sock<MAX_SOCK_NUM; sock++) {
+        if (! interest[sock])
+            continue;
+        base = CH_BASE + sock*CH_SIZE;
+        if (pending & 1 << sock) {
+            want (addr, &n, base + 0x02, 2);    /* SnIR, SnSR */
+            want (addr, &n, base + 0x26, 2);    /* SnRX_RSR */
+        } else {
+            if (IS_CLOSED (state[sock].status))
+                want (addr, &n, base + 0x03, 1);
+            if (state[sock].rx > 0)
+                want (addr, &n, base + 0x26, 2);
+        }
+        if (interest[sock] & WZ_WRITABLE)
+            want (addr, &n, base + 0x20, 2);    /* SnTX_FSR */
+    }
+    if (n > 0)
+        w5100_burst_gather (addr, val, n);
+
+    /* The values come back in the same order. */
+    n = 0;
+    nclr = 0;
+    v = val;
+    for (sock=0; sock<MAX_SOCK_NUM; sock++) {
+        if (! interest[sock])
+            continue;
+        bit = 1 << sock;
+        ir = 0;
+        if (pending & bit) {
+            ir = v[0];
+            state[sock].status = v[1];
+            state[sock].rx = v[2] << 8 | v[3];
+            v += 4;
+        } else {
+            if (IS_CLOSED (state[sock].status))
+                state[sock].status = *v++;
+            if (state[sock].rx > 0) {
+                state[sock].rx = v[0] << 8 | v[1];
+                v += 2;
+            }
+        }
+        if (interest[sock] & WZ_WRITABLE) {
+            state[sock].tx = v[0] << 8 | v[1];
+            v += 2;
+        }
+
+        events = 0;
+        if (state[sock].rx > 0)
+            events |= WZ_READABLE;
+        if (state[sock].tx > 0 && (state[sock].status == SnSR_ESTABLISHED ||
+            state[sock].status == SnSR_CLOSE_WAIT ||
+            state[sock].status == SnSR_UDP))
+            events |= WZ_WRITABLE;
+        if (ir & SnIR_CON)
+            events |= WZ_CONNECTED;
+        if ((ir & (SnIR_DISCON | SnIR_TIMEOUT)) ||
+            IS_CLOSED (state[sock].status))
+            events |= WZ_CLOSED;
+
+        if (ir & IR_EVENTS) {
+            if (ir & IR_SENDER)
+                w5100_burst_ir_latch (sock, ir & IR_SENDER);
+            clr_addr[nclr] = CH_BASE + sock*CH_SIZE + 0x02;
+            clr_val[nclr] = ir & IR_EVENTS;
+            nclr++;
+        }
+
+        events &= interest[sock];
+        if (events) {
+            ev[n].sock = sock;
+            ev[n].events = events;
+            ev[n].status = state[sock].status;
+            ev[n].rxsize = state[sock].rx;
+            n++;
+        }
+    }
+
+    /* Acknowledge the edge events: this releases /INT. */
+    if (nclr > 0)
+        w5100_burst_scatter (clr_addr, clr_val, nclr);
+    return n;
+}
+
+/*
+ * Time left until the deadline, 0 when it has passed.
+ */
+static int
+time_left (struct timeval *deadline, struct timeval *left)
+{
+    struct timeval now;
+
+    gettimeofday (&now, 0);
+    if (now.tv_sec > deadline->tv_sec || (now.tv_sec == deadline->tv_sec &&
+        now.tv_usec >= deadline->tv_usec))
+        return 0;
+    left->tv_sec = deadline->tv_sec - now.tv_sec;
+    left->tv_usec = deadline->tv_usec - now.tv_usec;
+    if (left->tv_usec < 0) {
+        left->tv_sec--;
+        left->tv_usec += 1000000;
+    }
+    return 1;
+}
+
+int
+wz_wait (struct wz_event *ev, int intfd, struct timeval *timeout)
+{
+    char records [64];
+    struct timeval deadline, left, *tv;
+    fd_set rfds;
+    int n;
+
+    if (timeout) {
+        gettimeofday (&deadline, 0);
+        deadline.tv_sec += timeout->tv_sec;
+        deadline.tv_usec += timeout->tv_usec;
+        while (deadline.tv_usec >= 1000000) {
+            deadline.tv_sec++;
+            deadline.tv_usec -= 1000000;
+        }
+    }
+    for (;;) {
+        n = wz_poll (ev);
+        if (n != 0)
+            return n;
+        tv = 0;
+        if (timeout) {
+            if (! time_left (&deadline, &left))
+                return 0;
+            tv = &left;
+        }
+
+        if (intfd >= 0) {
+            /*
+             * Sleep until the /INT line changes.  An edge does not
+             * mean an event: the acknowledge in wz_poll() releases
+             * the line, and that edge is captured too.
+             */
+            FD_ZERO (&rfds);
+            FD_SET (intfd, &rfds);
+            n = select (intfd + 1, &rfds, 0, 0, tv);
+            if (n < 0)
+                return -1;
+            if (n > 0)
+                read (intfd, records, sizeof records);
+            continue;
+        }
+
+        if (tv && tv->tv_sec == 0 && tv->tv_usec < WZ_POLL_USEC)
+            usleep (tv->tv_usec);
+        else
+            usleep (WZ_POLL_USEC);
+    }
+}
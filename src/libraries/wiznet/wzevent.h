@@ -0,0 +1,61 @@
+/*
+ * Readiness events for the W5100 sockets.
+ *
+ * Instead of polling SnSR and SnRX_RSR of every socket in turn,
+ * wz_poll() reads IR, one frame, and then the interrupt, status and
+ * size registers of the sockets it flags.  Registers of the other
+ * sockets are read only to confirm a level event: SnRX_RSR while
+ * data is left, SnSR while the socket is closed, and SnTX_FSR for
+ * WZ_WRITABLE.  An idle poll of sockets with nothing pending costs
+ * one frame, however many sockets are watched.
+ *
+ * The chip signals socket interrupts on its /INT line.  When that
+ * line is wired to a pin whose changes can be read from a device
+ * (an edge capture driver), pass its descriptor to wz_wait(): the
+ * process then sleeps in select() until the chip has something to
+ * report.  The stock GPIO driver has no such mode; then wz_wait()
+ * polls every WZ_POLL_USEC microseconds.
+ */
+#ifndef WZEVENT_H_INCLUDED
+#define WZEVENT_H_INCLUDED
+
+#include <sys/time.h>
+#include <wiznet/w5100.h>
+
+#define WZ_READABLE     0x01    /* data in RX memory */
+#define WZ_WRITABLE     0x02    /* room in TX memory */
+#define WZ_CONNECTED    0x04    /* connection established */
+#define WZ_CLOSED       0x08    /* peer closed, timeout or socket closed */
+
+#define WZ_POLL_USEC    1000
+
+struct wz_event {
+    unsigned    sock;
+    unsigned    events;         /* WZ_* bits which are ready */
+    unsigned    status;         /* SnSR */
+    unsigned    rxsize;         /* SnRX_RSR */
+};
+
+/*
+ * Set the events to report for a socket, 0 to stop watching it.
+ */
+void wz_watch (unsigned sock, unsigned events);
+
+/*
+ * Fill ev[] (MAX_SOCK_NUM entries) with the ready sockets.
+ * Returns the number of entries.
+ * WZ_CONNECTED is reported once per connection; the other
+ * events are reported as long as the condition holds.
+ */
+int wz_poll (struct wz_event *ev);
+
+/*
+ * Wait until a watched socket is ready or the timeout expires;
+ * a null timeout waits forever.  intfd is the device
+ * capturing the /INT line, or -1.  Returns the number of entries
+ * in ev[], 0 on timeout, -1 on error.  Edges of /INT which bring
+ * no event do not end the wait.
+ */
+int wz_wait (struct wz_event *ev, int intfd, struct timeval *timeout);
+
+#endif
@@ -0,0 +1,120 @@
+/*
+ * Socket memory partitioning for the W5100.
+ */
+#include "w5100burst.h"
+#include "wzpart.h"
+
+#define MEM_KBYTES  8           /* RX or TX memory */
+#define MAX_KBYTES  8           /* largest socket buffer */
+
+static unsigned rx_class [MAX_SOCK_NUM];
+static unsigned tx_class [MAX_SOCK_NUM];
+static unsigned long rx_seen [MAX_SOCK_NUM];
+static unsigned long tx_seen [MAX_SOCK_NUM];
+
+void
+wz_part_declare (unsigned sock, unsigned rx, unsigned tx)
+{
+    rx_class[sock] = rx;
+    tx_class[sock] = tx;
+}
+
+/*
+ * Weight of a socket: the bytes moved since the previous split
+ * for WZ_PART_AUTO, the extremes for declared classes.
+ */
+static unsigned long
+weight (unsigned class, unsigned long count, unsigned long seen)
+{
+    switch (class) {
+    case WZ_PART_AUTO:
+        return count - seen;
+    case WZ_PART_BULK:
+        return ~0UL;
+    }
+    return 0;
+}
+
+/*
+ * Give each socket 1 kbyte, then keep doubling the socket with
+ * the most traffic per kbyte, or the smallest one on a tie,
+ * while the memory allows.
+ * Returns the RMSR/TMSR value.
+ */
+static unsigned
+partition (const unsigned *class, const unsigned long *w)
+{
+    unsigned size [MAX_SOCK_NUM];
+    unsigned i, nused, total, best, msr;
+    unsigned long wi, wbest;
+
+    nused = 0;
+    for (i=0; i<MAX_SOCK_NUM; i++)
+        if (class[i] != WZ_PART_UNUSED)
+            nused = i + 1;
+
+    total = 0;
+    for (i=0; i<nused; i++) {
+        size[i] = 1;
+        total++;
+    }
+    for (;;) {
+        best = MAX_SOCK_NUM;
+        for (i=0; i<nused; i++) {
+            if (size[i] == MAX_KBYTES || total + size[i] > MEM_KBYTES)
+                continue;
+            if (best == MAX_SOCK_NUM) {
+                best = i;
+                continue;
+            }
+            wi = w[i] / size[i];
+            wbest = w[best] / size[best];
+            if (wi > wbest || (wi == wbest && size[i] < size[best]))
+                best = i;
+        }
+        if (best == MAX_SOCK_NUM)
+            break;
+        total += size[best];
+        size[best] *= 2;
+    }
+
+    /* Unused sockets at the end get what is left, if anything. */
+    msr = 0;
+    for (i=0; i<nused; i++)
+        msr |= (size[i] == 8 ? 3 : size[i] / 2) << (i*2);
+    return msr;
+}
+
+int
+wz_part_apply ()
+{
+    unsigned long rw [MAX_SOCK_NUM], tw [MAX_SOCK_NUM];
+    uint8_t old[2], msr[2];
+    unsigned i, first;
+
+    for (i=0; i<MAX_SOCK_NUM; i++) {
+        rw[i] = weight (rx_class[i], w5100_burst_stats.sock_rx[i], rx_seen[i]);
+        tw[i] = weight (tx_class[i], w5100_burst_stats.sock_tx[i], tx_seen[i]);
+    }
+    msr[0] = partition (rx_class, rw);
+    msr[1] = partition (tx_class, tw);
+
+    w5100_burst_read (0x001A, old, 2);
+    if (msr[0] == old[0] && msr[1] == old[1])
+        return 0;
+
+    /* Every socket from the first changed one on is moved. */
+    for (first=0; first<MAX_SOCK_NUM; first++)
+        if (((msr[0] ^ old[0]) | (msr[1] ^ old[1])) >> (first*2) & 3)
+            break;
+    for (i=first; i<MAX_SOCK_NUM; i++)
+        if (w5100b_readSnSR (i) != SnSR_CLOSED)
+            return -1;
+
+    w5100_burst_write (0x001A, msr, 2);
+    for (i=0; i<MAX_SOCK_NUM; i++) {
+        rx_seen[i] = w5100_burst_stats.sock_rx[i];
+        tx_seen[i] = w5100_burst_stats.sock_tx[i];
+    }
+    return 1;
+}
@@ -0,0 +1,42 @@
+/*
+ * Socket memory partitioning for the W5100.
+ *
+ * w5100_init() gives each socket 2 kbytes of RX and 2 kbytes of TX
+ * memory.  A socket which moves bulk data is limited by its window,
+ * while control sockets never fill theirs.  This layer splits the
+ * 8 kbytes of each memory by the traffic declared for each socket,
+ * or observed since the previous split, and writes RMSR and TMSR.
+ *
+ * Memory is given to the sockets in order, so a change of one
+ * socket moves every socket after it: wz_part_apply() does
+ * nothing while any of those is open.  Call it when sockets are
+ * (re)opened, before socket_init().
+ *
+ * The stock socket_*() and client_*() data routines assume the
+ * layout of w5100_init().  After a new split, move socket data
+ * with the burst layer: bclient, w5100_burst_send_chunk() and
+ * w5100_burst_recv_chunk().
+ */
+#ifndef WZPART_H_INCLUDED
+#define WZPART_H_INCLUDED
+
+#include <wiznet/w5100.h>
+
+#define WZ_PART_AUTO    0       /* size from observed traffic */
+#define WZ_PART_IDLE    1       /* control traffic, smallest size */
+#define WZ_PART_BULK    2       /* as much memory as possible */
+#define WZ_PART_UNUSED  3       /* no memory, when last in order */
+
+/*
+ * Declare the traffic class of a socket for each direction.
+ */
+void wz_part_declare (unsigned sock, unsigned rx, unsigned tx);
+
+/*
+ * Compute the split and write RMSR and TMSR.
+ * Returns 1 when the layout changed, 0 when it is already
+ * in effect, -1 when an open socket would be moved.
+ */
+int wz_part_apply (void);
+
+#endif
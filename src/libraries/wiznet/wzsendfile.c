@@ -0,0 +1,89 @@
+/*
+ * File to socket transfer for the W5100.
+ */
+#include <unistd.h>
+#include <sys/param.h>
+#include "w5100burst.h"
+#include "wzsendfile.h"
+
+static int
+is_open (unsigned sock)
+{
+    unsigned status = w5100b_readSnSR (sock);
+
+    return status == SnSR_ESTABLISHED || status == SnSR_CLOSE_WAIT;
+}
+
+/*
+ * Wait for the SEND in progress, if any.
+ * Returns 0 when the connection was lost.
+ */
+static int
+wait_sent (unsigned sock, int *sending)
+{
+    if (! *sending)
+        return 1;
+    if (! w5100_burst_wait_send (sock, SnIR_SEND_OK))
+        return 0;
+    *sending = 0;
+    return 1;
+}
+
+long
+wz_sendfile (unsigned sock, int fd, long count)
+{
+    uint8_t block [MAXBSIZE];
+    unsigned ptr, free, fill, want;
+    long done;
+    int n, sending, eof;
+
+    done = 0;
+    sending = 0;
+    eof = 0;
+    while (done < count && ! eof) {
+        /* Wait for room for one block. */
+        want = (count - done < MAXBSIZE) ? count - done : MAXBSIZE;
+        while ((free = w5100_burst_tx_free (sock)) < want) {
+            if (! is_open (sock))
+                return -1;
+        }
+
+        /* Copy blocks to TX memory behind the data being sent. */
+        ptr = w5100b_readSnTX_WR (sock);
+        fill = 0;
+        while (fill + want <= free) {
+            n = read (fd, block, want);
+            if (n < 0)
+                return -1;
+            if (n == 0) {
+                eof = 1;
+                break;
+            }
+            w5100_burst_write_data (sock, ptr + fill, block, n);
+            fill += n;
+            if (n < want) {
+                eof = 1;
+                break;
+            }
+            if (done + fill == count)
+                break;
+            want = (count - done - fill < MAXBSIZE) ?
+                count - done - fill : MAXBSIZE;
+        }
+        if (fill == 0)
+            break;
+
+        if (! wait_sent (sock, &sending))
+            return -1;
+        w5100b_writeSnTX_WR (sock, ptr + fill);
+        w5100_burst_cmd (sock, Sock_SEND);
+        sending = 1;
+
+        done += fill;
+        w5100_burst_stats.tx_bytes += fill;
+        w5100_burst_stats.sock_tx[sock] += fill;
+    }
+    if (! wait_sent (sock, &sending))
+        return -1;
+    return done;
+}
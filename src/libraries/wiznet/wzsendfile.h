@@ -0,0 +1,24 @@
+/*
+ * File to socket transfer for the W5100.
+ *
+ * Sending a file with read() and client_write() copies each block
+ * into a user buffer, then through the socket layer, and waits for
+ * every SEND to finish before reading the next block.  wz_sendfile()
+ * bursts each file block into the TX memory of the socket as soon
+ * as it is read, fills as much memory as SnTX_FSR allows with one
+ * SEND, and does so while the previous SEND is still on the wire.
+ */
+#ifndef WZSENDFILE_H_INCLUDED
+#define WZSENDFILE_H_INCLUDED
+
+#include <wiznet/w5100.h>
+
+/*
+ * Send up to count bytes of file fd, from its current offset,
+ * on a connected TCP socket.  Returns the number of bytes sent,
+ * which is less than count at end of file, or -1 when the
+ * connection is lost or read() fails, with errno as read() left it.
+ */
+long wz_sendfile (unsigned sock, int fd, long count);
+
+#endif
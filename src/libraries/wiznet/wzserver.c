@@ -0,0 +1,122 @@
+/*
+ * Multi-client TCP server for the wiznet library.
+ */
+#include "wzserver.h"
+
+/*
+ * Keep the free sockets listening on the port, up to maxconn
+ * sockets in all, so that clients connecting at the same time
+ * are all accepted.
+ */
+static void
+listen_all (struct wzserver *s)
+{
+    unsigned sock, used;
+
+    used = 0;
+    for (sock=0; sock<MAX_SOCK_NUM; sock++)
+        if (_socket_port [sock] == s->port &&
+            w5100_readSnSR (sock) != SnSR_CLOSED)
+            used++;
+
+    for (sock=0; sock<MAX_SOCK_NUM && used<s->maxconn; sock++) {
+        if (w5100_readSnSR (sock) != SnSR_CLOSED)
+            continue;
+        socket_init (sock, SnMR_TCP, s->port, 0);
+        socket_listen (sock);
+        _socket_port [sock] = s->port;
+        used++;
+    }
+}
+
+static void
+start_slice (struct wzserver *s)
+{
+    gettimeofday (&s->deadline, 0);
+    s->deadline.tv_usec += s->slice;
+    s->deadline.tv_sec += s->deadline.tv_usec / 1000000;
+    s->deadline.tv_usec %= 1000000;
+}
+
+int
+wzserver_expired (struct wzserver *s)
+{
+    struct timeval now;
+
+    gettimeofday (&now, 0);
+    if (now.tv_sec != s->deadline.tv_sec)
+        return now.tv_sec > s->deadline.tv_sec;
+    return now.tv_usec >= s->deadline.tv_usec;
+}
+
+void
+wzserver_close (struct wzserver *s, client_t *c)
+{
+    s->connected &= ~(1 << c->sock);
+    socket_disconnect (c->sock);
+}
+
+static void
+serve (struct wzserver *s, unsigned sock)
+{
+    client_t *c = &s->client[sock];
+    unsigned status, bit = 1 << sock;
+    uint8_t junk [64];
+    int n;
+
+    if (_socket_port [sock] != s->port)
+        return;
+    status = w5100_readSnSR (sock);
+
+    if (status == SnSR_ESTABLISHED || status == SnSR_CLOSE_WAIT) {
+        if (! (s->connected & bit)) {
+            s->connected |= bit;
+            s->handler (s, WZS_CONNECT, c);
+        }
+        if (s->connected & bit) {
+            start_slice (s);
+            s->handler (s, WZS_SLICE, c);
+        }
+        return;
+    }
+
+    if (s->connected & bit) {
+        s->connected &= ~bit;
+        s->handler (s, WZS_CLOSE, c);
+    }
+    if (status == SnSR_FIN_WAIT) {
+        /* Drop data which arrives after our FIN. */
+        n = client_available (c);
+        if (n > 0)
+            client_read (c, junk, (n < sizeof junk) ? n : sizeof junk);
+    }
+}
+
+void
+wzserver_init (struct wzserver *s, unsigned port,
+               wzserver_handler_t *handler, void *arg)
+{
+    unsigned sock;
+
+    s->port = port;
+    s->maxconn = MAX_SOCK_NUM;
+    s->slice = WZS_SLICE_USEC;
+    s->handler = handler;
+    s->arg = arg;
+    s->next = 0;
+    s->connected = 0;
+    for (sock=0; sock<MAX_SOCK_NUM; sock++)
+        client_init_sock (&s->client[sock], sock);
+}
+
+void
+wzserver_poll (struct wzserver *s)
+{
+    unsigned i;
+
+    /* The first call starts listening, with maxconn as set by now. */
+    listen_all (s);
+    for (i=0; i<MAX_SOCK_NUM; i++)
+        serve (s, (s->next + i) % MAX_SOCK_NUM);
+    s->next = (s->next + 1) % MAX_SOCK_NUM;
+}
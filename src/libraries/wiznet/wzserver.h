@@ -0,0 +1,75 @@
+/*
+ * Multi-client TCP server for the wiznet library.
+ *
+ * <wiznet/server.h> keeps a single listening socket per program
+ * and broadcasts its output to every client.  A struct wzserver
+ * keeps every free socket listening on its port, up to maxconn,
+ * listens again as soon as a socket is closed, and calls the
+ * handler for each client in turn.  Each call is one time slice:
+ * the handler does a bounded amount of work, or keeps working
+ * until wzserver_expired() tells it to return, so that a slow
+ * or busy client does not delay the others.
+ *
+ * With the default slice of 0, wzserver_expired() is true at once
+ * and the handler does one piece of work per turn.  A longer slice
+ * gives a busy client more throughput, and the others more latency.
+ *
+ * Sockets beyond maxconn are never touched, so a program can keep
+ * some for UDP or outgoing clients.  Set maxconn after
+ * wzserver_init() and before the first wzserver_poll(), which is
+ * when listening starts.
+ */
+#ifndef WZSERVER_H_INCLUDED
+#define WZSERVER_H_INCLUDED
+
+#include <sys/time.h>
+#include <wiznet/ethernet.h>
+#include <wiznet/socket.h>
+
+#define WZS_CONNECT     1       /* new client: set up its state */
+#define WZS_SLICE       2       /* time slice for the client */
+#define WZS_CLOSE       3       /* connection closed by the peer or the chip */
+
+#define WZS_SLICE_USEC  0       /* default slice: one piece of work */
+
+struct wzserver;
+
+typedef void wzserver_handler_t (struct wzserver *s, unsigned event,
+                                 client_t *c);
+
+struct wzserver {
+    unsigned        port;
+    unsigned        maxconn;        /* sockets to use, all by default */
+    unsigned long   slice;          /* time slice, microseconds */
+    wzserver_handler_t *handler;
+    void            *arg;           /* for the handler */
+    unsigned        next;           /* client to serve first */
+    unsigned        connected;      /* bit per socket with a client */
+    struct timeval  deadline;       /* end of the current slice */
+    client_t        client [MAX_SOCK_NUM];
+};
+
+/*
+ * Set up the server, with maxconn of MAX_SOCK_NUM.  Nothing listens
+ * until the first wzserver_poll().
+ */
+void wzserver_init (struct wzserver *s, unsigned port,
+                    wzserver_handler_t *handler, void *arg);
+
+/*
+ * Accept new clients and give every client one time slice.
+ */
+void wzserver_poll (struct wzserver *s);
+
+/*
+ * Returns 1 when the current time slice is used up.
+ */
+int wzserver_expired (struct wzserver *s);
+
+/*
+ * Send FIN and forget the client, without waiting for the
+ * connection to close.  The handler gets no WZS_CLOSE for it.
+ */
+void wzserver_close (struct wzserver *s, client_t *c);
+
+#endif
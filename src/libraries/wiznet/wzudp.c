@@ -0,0 +1,125 @@
+/*
+ * Batched UDP datagram receive and send for the W5100.
+ */
+#include "w5100burst.h"
+#include "wzudp.h"
+
+#define HDR_SIZE    8           /* peer address, port and length */
+
+int
+wz_recvmmsg (udp_t *u, struct wz_msg *msg, unsigned n)
+{
+    unsigned sock = u->sock;
+    unsigned avail, start, ptr, end, len, copy;
+    uint8_t hdr [HDR_SIZE];
+    int count;
+
+    if (sock >= MAX_SOCK_NUM)
+        return 0;
+    avail = w5100_burst_rx_size (sock);
+    if (avail < HDR_SIZE)
+        return 0;
+
+    start = ptr = w5100b_readSnRX_RD (sock);
+    end = ptr + avail;
+    for (count=0; count<n && end - ptr >= HDR_SIZE; count++) {
+        w5100_burst_read_data (sock, ptr, hdr, HDR_SIZE);
+        len = hdr[6] << 8 | hdr[7];
+        ptr += HDR_SIZE;
+        if (len > end - ptr) {
+            /* Not a header: the rest cannot be parsed, drop it. */
+            ptr = end;
+            break;
+        }
+
+        msg[count].ip[0] = hdr[0];
+        msg[count].ip[1] = hdr[1];
+        msg[count].ip[2] = hdr[2];
+        msg[count].ip[3] = hdr[3];
+        msg[count].port = hdr[4] << 8 | hdr[5];
+        msg[count].len = len;
+
+        copy = (len > msg[count].size) ? msg[count].size : len;
+        w5100_burst_read_data (sock, ptr, msg[count].buf, copy);
+        ptr += len;
+        w5100_burst_stats.rx_bytes += copy;
+        w5100_burst_stats.sock_rx[sock] += copy;
+    }
+    if (ptr != start) {
+        w5100b_writeSnRX_RD (sock, ptr);
+        w5100_burst_cmd (sock, Sock_RECV);
+    }
+    return count;
+}
+
+/*
+ * Wait for the result of a SEND.
+ * Returns 0 on ARP or send timeout.
+ */
+static int
+wait_sent (unsigned sock)
+{
+    unsigned ir = w5100_burst_wait_send (sock, SnIR_SEND_OK | SnIR_TIMEOUT);
+
+    return (ir & SnIR_SEND_OK) != 0;
+}
+
+int
+wz_sendmmsg (udp_t *u, const struct wz_msg *msg, unsigned n)
+{
+    unsigned sock = u->sock;
+    unsigned base = CH_BASE + sock*CH_SIZE;
+    unsigned free, ptr, total, queued, i, nregs;
+    unsigned addr [9];
+    uint8_t val [9];
+    const struct wz_msg *prev;
+
+    if (sock >= MAX_SOCK_NUM || n == 0)
+        return 0;
+
+    /* Copy the datagrams which fit into TX memory. */
+    free = w5100_burst_tx_free (sock);
+    ptr = w5100b_readSnTX_WR (sock);
+    total = 0;
+    for (queued=0; queued<n; queued++) {
+        if (msg[queued].len > free - total)
+            break;
+        w5100_burst_write_data (sock, ptr + total, msg[queued].buf,
+            msg[queued].len);
+        total += msg[queued].len;
+    }
+
+    /* Send them one by one. */
+    prev = 0;
+    for (i=0; i<queued; i++) {
+        nregs = 0;
+        if (! prev || prev->port != msg[i].port ||
+            prev->ip[0] != msg[i].ip[0] || prev->ip[1] != msg[i].ip[1] ||
+            prev->ip[2] != msg[i].ip[2] || prev->ip[3] != msg[i].ip[3]) {
+            for (; nregs<4; nregs++) {
+                addr[nregs] = base + 0x0C + nregs;      /* SnDIPR */
+                val[nregs] = msg[i].ip[nregs];
+            }
+            addr[4] = base + 0x10;                      /* SnDPORT */
+            val[4] = msg[i].port >> 8;
+            addr[5] = base + 0x11;
+            val[5] = msg[i].port;
+            nregs = 6;
+        }
+        ptr += msg[i].len;
+        addr[nregs] = base + 0x24;                      /* SnTX_WR */
+        val[nregs++] = ptr >> 8;
+        addr[nregs] = base + 0x25;
+        val[nregs++] = ptr;
+        addr[nregs] = base + 0x01;                      /* SnCR */
+        val[nregs++] = Sock_SEND;
+        w5100_burst_scatter (addr, val, nregs);
+
+        if (! wait_sent (sock))
+            return i;
+        prev = &msg[i];
+        w5100_burst_stats.tx_bytes += msg[i].len;
+        w5100_burst_stats.sock_tx[sock] += msg[i].len;
+    }
+    return queued;
+}
@@ -0,0 +1,43 @@
+/*
+ * Batched UDP datagram receive and send for the W5100.
+ *
+ * udp_read_packet() and udp_send_packet() handle one datagram per
+ * call, reading the size and pointer registers each time.
+ * wz_recvmmsg() reads SnRX_RSR and SnRX_RD once, walks every queued
+ * datagram in RX memory, and returns the memory to the chip with a
+ * single RECV.  wz_sendmmsg() copies as many datagrams as fit into
+ * TX memory first; the chip sends one datagram per SEND, so each
+ * then costs only the writes of its pointer, destination (when it
+ * changes) and command.
+ */
+#ifndef WZUDP_H_INCLUDED
+#define WZUDP_H_INCLUDED
+
+#include <wiznet/ethernet.h>
+#include <wiznet/udp.h>
+
+struct wz_msg {
+    uint8_t     *buf;
+    unsigned    size;           /* buffer size, for receive */
+    unsigned    len;            /* datagram length */
+    uint8_t     ip [4];         /* peer address */
+    unsigned    port;           /* peer port */
+};
+
+/*
+ * Receive up to n queued datagrams without waiting.
+ * A datagram longer than its buffer is truncated to size bytes,
+ * with len telling the original length.  A header giving more
+ * bytes than RX memory holds is not trusted: the rest of the
+ * received data is dropped.  Returns the number of datagrams
+ * received.
+ */
+int wz_recvmmsg (udp_t *u, struct wz_msg *msg, unsigned n);
+
+/*
+ * Send up to n datagrams.  Returns the number sent, which is less
+ * than n when TX memory is full or a destination does not answer ARP.
+ */
+int wz_sendmmsg (udp_t *u, const struct wz_msg *msg, unsigned n);
+
+#endif
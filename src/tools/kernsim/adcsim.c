@@ -0,0 +1,203 @@
+/*
+ * Host model of continuous acquisition for the ADC driver.
+ *
+ * The stock driver converts one channel per read() of /dev/adcN,
+ * so a program sampling several channels pays a system call and a
+ * conversion for every sample, at whatever moment it gets there.
+ * In streaming mode a timer starts a scan of the selected channels
+ * at a fixed rate; the interrupt stores the results in a ring of
+ * 16-bit samples, and read() returns whole scans, blocking until
+ * one is complete.  Scans which find the ring full are dropped and
+ * counted as overruns.
+ *
+ * The model runs both schemes in simulated time over a range of scan
+ * rates.  Every sample carries its channel and scan number, so the
+ * reader checks that the scans come in order, whole, and that every
+ * gap is accounted for by an overrun.  It reports the scans delivered
+ * per second, the overruns and the processor load.
+ *
+ * Costs are assumptions for an 80 MHz PIC32: a conversion takes 2 us,
+ * the scan interrupt 3 us plus 1 us per sample, a system call 10 us
+ * plus 0.05 us per byte copied, and a woken reader runs after the
+ * given latency.
+ *
+ * Usage: adcsim [-c channels] [-l latency, us] [-r ring size] [-t seconds]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define CONV_USEC       2.0
+#define INTR_USEC       3.0
+#define INTR_SAMPLE     1.0
+#define SYSCALL_USEC    10.0
+#define COPY_USEC       0.05            /* per byte */
+
+#define READ_SAMPLES    256             /* reader buffer */
+
+/*
+ * Ring of samples, filled by whole scans.
+ */
+static unsigned short *ring;
+static unsigned ringsize, head, tail;
+
+static unsigned nchan;
+static unsigned long scans, overruns, delivered, gaps, nreads, nerrors;
+static double cpu;
+
+/*
+ * Sample value: scan number in the upper bits, channel in the lower.
+ */
+#define SAMPLE(scan, chan)  ((unsigned short) ((scan) << 4 | (chan)))
+
+/*
+ * Timer interrupt: convert the scan list into the ring.
+ */
+static void
+adc_scan (unsigned long scan)
+{
+    unsigned c;
+
+    scans++;
+    cpu += INTR_USEC + nchan * INTR_SAMPLE;
+    if (ringsize - (head - tail) < nchan) {
+        overruns++;
+        return;
+    }
+    for (c=0; c<nchan; c++)
+        ring[head++ % ringsize] = SAMPLE (scan, c);
+}
+
+/*
+ * read(): copy whole scans, check them on the way.
+ */
+static unsigned long expect_scan;
+
+static void
+adc_read (void)
+{
+    unsigned n, i, c;
+    unsigned short s;
+
+    n = head - tail;
+    if (n > READ_SAMPLES)
+        n = READ_SAMPLES;
+    n -= n % nchan;
+    cpu += SYSCALL_USEC + n * 2 * COPY_USEC;
+    nreads++;
+    for (i=0; i<n; i+=nchan) {
+        for (c=0; c<nchan; c++) {
+            s = ring[tail++ % ringsize];
+            if ((s & 15) != c) {
+                nerrors++;
+                continue;
+            }
+            if (c == 0) {
+                /* Scans missing in between were dropped. */
+                gaps += ((s >> 4) - expect_scan) & 0xfff;
+                expect_scan += (((s >> 4) - expect_scan) & 0xfff) + 1;
+            }
+        }
+        delivered++;
+    }
+}
+
+/*
+ * Streaming: scans come from the timer, the reader is woken by the
+ * first complete scan and drains the ring when it runs.
+ */
+static void
+stream (unsigned rate, double seconds, double latency)
+{
+    double period = 1e6 / rate, t, wake = -1;
+    unsigned long scan, nscans = seconds * rate;
+
+    head = tail = 0;
+    scans = overruns = delivered = gaps = nreads = 0;
+    expect_scan = 0;
+    cpu = 0;
+    for (scan=0; scan<nscans; scan++) {
+        t = scan * period;
+        while (wake >= 0 && wake <= t) {
+            adc_read ();
+            wake = (head != tail) ? wake + SYSCALL_USEC : -1;
+        }
+        adc_scan (scan);
+        if (wake < 0)
+            wake = t + nchan * CONV_USEC + latency;
+    }
+    while (head != tail)
+        adc_read ();
+
+    /* Every scan is either delivered or counted as an overrun. */
+    gaps += scans - expect_scan;
+    if (delivered + overruns != scans || gaps != overruns || nerrors) {
+        printf ("rate %u: %lu delivered, %lu overruns, %lu missing, "
+            "%lu scans\n", rate, delivered, overruns, gaps, scans);
+        nerrors++;
+    }
+}
+
+/*
+ * One read() per sample: the scan rate the stock driver can keep,
+ * with the process spending all its time in the loop.
+ */
+static double
+per_sample_rate (void)
+{
+    return 1e6 / (nchan * (SYSCALL_USEC + CONV_USEC + 2 * COPY_USEC));
+}
+
+int
+main (int argc, char **argv)
+{
+    static const unsigned rates [] = { 1000, 2000, 5000, 10000, 20000, 40000 };
+    double seconds = 1, latency = 1000, limit;
+    unsigned i;
+    int opt;
+
+    nchan = 4;
+    ringsize = 512;
+    while ((opt = getopt (argc, argv, "c:l:r:t:")) != -1) {
+        switch (opt) {
+        case 'c':
+            nchan = strtoul (optarg, 0, 0);
+            break;
+        case 'l':
+            latency = atof (optarg);
+            break;
+        case 'r':
+            ringsize = strtoul (optarg, 0, 0);
+            break;
+        case 't':
+            seconds = atof (optarg);
+            break;
+        default:
+            fprintf (stderr, "Usage: adcsim [-c channels] [-l latency, us] "
+                "[-r ring size] [-t seconds]\n");
+            return 1;
+        }
+    }
+    if (nchan < 1 || nchan > 15 || ringsize < nchan) {
+        fprintf (stderr, "adcsim: bad channel count or ring size\n");
+        return 1;
+    }
+    ring = malloc (ringsize * sizeof *ring);
+
+    limit = per_sample_rate ();
+    printf ("%u channels, ring of %u samples, reader latency %.0f us\n",
+        nchan, ringsize, latency);
+    printf ("per-sample read(): at most %.0f scans/s, processor 100%%, "
+        "sampling times set by the loop\n",
+        limit);
+    printf ("%8s %10s %10s %8s %8s\n", "rate", "delivered", "overruns",
+        "reads", "cpu");
+    for (i=0; i<sizeof rates / sizeof rates[0]; i++) {
+        stream (rates[i], seconds, latency);
+        printf ("%8u %10.0f %10lu %8lu %7.1f%%\n", rates[i],
+            delivered / seconds, overruns, nreads,
+            100 * cpu / (seconds * 1e6));
+    }
+    return nerrors != 0;
+}
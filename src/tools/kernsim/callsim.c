@@ -0,0 +1,419 @@
+/*
+ * Host model of the callout queue: the calltodo delta list against
+ * hashed timing wheels.
+ *
+ * The kernel keeps pending callouts on calltodo sorted by due time,
+ * each c_time relative to the entry before it: timeout() and
+ * untimeout() walk the list, hardclock() decrements the first entry
+ * and runs the ones which reach zero.  A hashed wheel keeps a slot
+ * per tick modulo its size, c_time absolute and c_prev pointing to
+ * the link to the entry: insert and cancel touch one slot, and each
+ * tick walks the slot of that tick, skipping the entries due on a
+ * later turn.  With HZ = 200 a wheel of 64 slots turns every 320 ms,
+ * shorter than many timeouts; one of 256 slots turns in 1.28 s.
+ *
+ * The workload is a set of timers drawn from a seeded generator:
+ * retransmit timers of 0.2-3 s which are mostly cancelled and armed
+ * again when the reply comes, terminal timers of 1-10 ticks which
+ * run, and watchdogs of 10-60 s.  Every scheme runs the same timers,
+ * each with its own random sequence, so the order of the callouts
+ * within a tick does not change the workload.  The model checks that
+ * every callout runs in its due tick, that a cancelled one never
+ * runs, and that all schemes run the same callouts.  It counts the
+ * entries touched per operation, and times insert and cancel on the
+ * build machine with the timers pending.
+ *
+ * Usage: callsim [-n timers] [-t seconds] [-s seed]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#define HZ              200
+
+struct callout {
+    int             c_time;             /* delta, or tick when due */
+    void            *c_arg;
+    void            (*c_func) (void *);
+    struct callout  *c_next;
+    struct callout  **c_prev;           /* wheel: link to this entry */
+};
+
+/*
+ * A timer of the workload, with its callout.
+ */
+enum { RETRANSMIT, TERMINAL, WATCHDOG };
+
+struct timer {
+    struct callout  c;
+    int             class;
+    int             pending;
+    long            due;                /* tick it must run in */
+    long            action;             /* tick of the next cancel */
+    unsigned long   seed;
+    unsigned long   fired;
+};
+
+struct stats {
+    unsigned long   ninsert, insert_visits, insert_max;
+    unsigned long   ncancel, cancel_visits, cancel_max;
+    unsigned long   tick_visits, tick_max, skipped;
+    unsigned long   fired;
+    unsigned long   sum;                /* of the ticks callouts ran in */
+};
+
+static struct timer *timer;
+static int ntimer = 300;
+static long ticks;
+static struct stats st;
+static int nerrors;
+
+static int wheelsize;                   /* 0 for the delta list */
+static struct callout calltodo;
+static struct callout **wheel;
+
+static unsigned
+rnd (unsigned long *seed, unsigned n)
+{
+    *seed = *seed * 1103515245 + 12345;
+    return (*seed >> 16) % n;
+}
+
+static void
+count (unsigned long *total, unsigned long *max, unsigned long n)
+{
+    *total += n;
+    if (n > *max)
+        *max = n;
+}
+
+/*
+ * timeout() and untimeout() on calltodo.
+ */
+static void
+list_insert (struct callout *c, int t)
+{
+    struct callout *p1, *p2;
+    unsigned long n = 0;
+
+    for (p1 = &calltodo; (p2 = p1->c_next) && p2->c_time < t; p1 = p2) {
+        t -= p2->c_time;
+        n++;
+    }
+    c->c_time = t;
+    c->c_next = p2;
+    p1->c_next = c;
+    if (p2)
+        p2->c_time -= t;
+    count (&st.insert_visits, &st.insert_max, n + 1);
+}
+
+static int
+list_cancel (struct callout *c)
+{
+    struct callout *p1, *p2;
+    unsigned long n = 0;
+
+    for (p1 = &calltodo; (p2 = p1->c_next); p1 = p2) {
+        n++;
+        if (p2 == c) {
+            if (c->c_next)
+                c->c_next->c_time += c->c_time;
+            p1->c_next = c->c_next;
+            break;
+        }
+    }
+    count (&st.cancel_visits, &st.cancel_max, n);
+    return p2 != 0;
+}
+
+static void
+list_tick ()
+{
+    struct callout *c;
+    unsigned long n = 0;
+
+    c = calltodo.c_next;
+    if (c) {
+        c->c_time--;
+        n++;
+    }
+    while ((c = calltodo.c_next) && c->c_time <= 0) {
+        calltodo.c_next = c->c_next;
+        if (c->c_next) {
+            c->c_next->c_time += c->c_time;
+            n++;
+        }
+        (*c->c_func) (c->c_arg);
+    }
+    count (&st.tick_visits, &st.tick_max, n);
+}
+
+/*
+ * callout_reset() and callout_stop() on a wheel.
+ */
+static void
+wheel_insert (struct callout *c, int t)
+{
+    struct callout **slot;
+
+    c->c_time = ticks + t;
+    slot = &wheel[c->c_time & (wheelsize - 1)];
+    c->c_next = *slot;
+    if (c->c_next)
+        c->c_next->c_prev = &c->c_next;
+    c->c_prev = slot;
+    *slot = c;
+    count (&st.insert_visits, &st.insert_max, 1);
+}
+
+static int
+wheel_unlink (struct callout *c)
+{
+    if (! c->c_prev)
+        return 0;
+    *c->c_prev = c->c_next;
+    if (c->c_next)
+        c->c_next->c_prev = c->c_prev;
+    c->c_prev = 0;
+    return 1;
+}
+
+static int
+wheel_cancel (struct callout *c)
+{
+    count (&st.cancel_visits, &st.cancel_max, 1);
+    return wheel_unlink (c);
+}
+
+static void
+wheel_tick ()
+{
+    struct callout *c, *next;
+    unsigned long n = 0;
+
+    for (c = wheel[ticks & (wheelsize - 1)]; c; c = next) {
+        next = c->c_next;
+        n++;
+        if (c->c_time - ticks > 0) {
+            st.skipped++;
+            continue;
+        }
+        /* The function may arm c again, but no other callout. */
+        wheel_unlink (c);
+        (*c->c_func) (c->c_arg);
+    }
+    count (&st.tick_visits, &st.tick_max, n);
+}
+
+static void
+insert (struct timer *tm, int t)
+{
+    st.ninsert++;
+    tm->pending = 1;
+    tm->due = ticks + t;
+    if (wheelsize)
+        wheel_insert (&tm->c, t);
+    else
+        list_insert (&tm->c, t);
+}
+
+static void
+cancel (struct timer *tm)
+{
+    int found;
+
+    st.ncancel++;
+    found = wheelsize ? wheel_cancel (&tm->c) : list_cancel (&tm->c);
+    if (found != tm->pending) {
+        printf ("cancel: timer %ld %s\n", (long) (tm - timer),
+            found ? "found but not pending" : "pending but not found");
+        nerrors++;
+    }
+    tm->pending = 0;
+}
+
+/*
+ * Arm a timer for its class, and pick when its reply cancels it.
+ */
+static void
+arm (struct timer *tm)
+{
+    int t;
+
+    tm->action = -1;
+    switch (tm->class) {
+    case RETRANSMIT:
+        t = 40 + rnd (&tm->seed, 560);
+        if (rnd (&tm->seed, 10) != 0)
+            tm->action = ticks + 1 + rnd (&tm->seed, 30);
+        break;
+    case TERMINAL:
+        t = 1 + rnd (&tm->seed, 10);
+        break;
+    default:
+        t = 2000 + rnd (&tm->seed, 10000);
+        if (rnd (&tm->seed, 2) != 0)
+            tm->action = ticks + 1 + rnd (&tm->seed, t - 1);
+        break;
+    }
+    insert (tm, t);
+}
+
+static void
+expire (void *arg)
+{
+    struct timer *tm = arg;
+
+    if (! tm->pending || tm->due != ticks) {
+        printf ("timer %ld ran at tick %ld, due %ld%s\n",
+            (long) (tm - timer), ticks, tm->due,
+            tm->pending ? "" : " after cancel");
+        nerrors++;
+    }
+    tm->pending = 0;
+    tm->fired++;
+    st.fired++;
+    st.sum += ticks;
+    arm (tm);
+}
+
+static void
+reset (unsigned long seed)
+{
+    int i, size = wheelsize ? wheelsize : 1;
+
+    memset (&st, 0, sizeof st);
+    memset (&calltodo, 0, sizeof calltodo);
+    free (wheel);
+    wheel = calloc (size, sizeof *wheel);
+    memset (timer, 0, ntimer * sizeof *timer);
+    ticks = 0;
+    for (i=0; i<ntimer; i++) {
+        timer[i].seed = seed + i * 7919;
+        timer[i].class = (i % 10 < 6) ? RETRANSMIT :
+            (i % 10 < 9) ? TERMINAL : WATCHDOG;
+        timer[i].c.c_func = expire;
+        timer[i].c.c_arg = &timer[i];
+    }
+}
+
+static void
+run (long nticks, unsigned long seed)
+{
+    struct timer *tm;
+    int i;
+
+    reset (seed);
+    for (i=0; i<ntimer; i++)
+        arm (&timer[i]);
+    for (ticks=1; ticks<nticks; ticks++) {
+        if (wheelsize)
+            wheel_tick ();
+        else
+            list_tick ();
+
+        /* Replies after the clock tick: cancel and arm again. */
+        for (i=0; i<ntimer; i++) {
+            tm = &timer[i];
+            if (tm->action == ticks && tm->pending) {
+                cancel (tm);
+                arm (tm);
+            }
+        }
+    }
+}
+
+/*
+ * Insert and cancel rate with all the timers pending.
+ */
+static double
+rate (long n, unsigned long seed)
+{
+    struct timespec t0, t1;
+    struct timer *tm;
+    long i;
+
+    reset (seed);
+    ticks = 1000;
+    for (i=0; i<ntimer; i++)
+        insert (&timer[i], 1 + rnd (&seed, 2000));
+    clock_gettime (CLOCK_MONOTONIC, &t0);
+    for (i=0; i<n; i++) {
+        tm = &timer[rnd (&seed, ntimer)];
+        cancel (tm);
+        insert (tm, 1 + rnd (&seed, 2000));
+    }
+    clock_gettime (CLOCK_MONOTONIC, &t1);
+    return 2 * n / ((t1.tv_sec - t0.tv_sec) +
+        (t1.tv_nsec - t0.tv_nsec) / 1e9);
+}
+
+int
+main (int argc, char **argv)
+{
+    static const int sizes [] = { 0, 64, 256 };
+    unsigned long seed = 1, fired = 0, sum = 0, ninsert = 0;
+    double seconds = 60, r;
+    struct stats s;
+    int opt, k;
+
+    while ((opt = getopt (argc, argv, "n:t:s:")) != -1) {
+        switch (opt) {
+        case 'n':
+            ntimer = strtoul (optarg, 0, 0);
+            break;
+        case 't':
+            seconds = atof (optarg);
+            break;
+        case 's':
+            seed = strtoul (optarg, 0, 0);
+            break;
+        default:
+usage:      fprintf (stderr,
+                "Usage: callsim [-n timers] [-t seconds] [-s seed]\n");
+            return 1;
+        }
+    }
+    if (ntimer < 1)
+        goto usage;
+    timer = calloc (ntimer, sizeof *timer);
+
+    printf ("%d timers, %.0f seconds at HZ = %d:\n", ntimer, seconds, HZ);
+    for (k=0; k<3; k++) {
+        wheelsize = sizes[k];
+        run (seconds * HZ, seed);
+        s = st;
+        if (k == 0) {
+            fired = s.fired;
+            sum = s.sum;
+            ninsert = s.ninsert;
+        } else if (s.fired != fired || s.sum != sum) {
+            printf ("wheel of %d ran %lu callouts, the list %lu\n",
+                wheelsize, s.fired, fired);
+            nerrors++;
+        }
+        r = rate (1000000, seed);
+        if (wheelsize)
+            printf ("wheel %3d: ", wheelsize);
+        else
+            printf ("calltodo:  ");
+        printf ("insert %.1f (max %lu), cancel %.1f (max %lu), "
+            "tick %.2f (max %lu) entries; %.1f M ops/s\n",
+            (double) s.insert_visits / s.ninsert, s.insert_max,
+            (double) s.cancel_visits / s.ncancel, s.cancel_max,
+            (double) s.tick_visits / (seconds * HZ), s.tick_max,
+            r / 1e6);
+        if (wheelsize)
+            printf ("           %lu entries skipped for a later turn, "
+                "%.2f per tick\n", s.skipped, s.skipped / (seconds * HZ));
+    }
+    printf ("%lu callouts ran, %lu inserts\n", fired, ninsert);
+    if (nerrors) {
+        printf ("%d errors\n", nerrors);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,659 @@
+/*
+ * Host model of the tty character queues: clists moved a character
+ * at a time, clists moved in cblock spans, and a single-producer,
+ * single-consumer ring between the interrupt handler and the top
+ * half.
+ *
+ * The clist code is that of the kernel: NCLIST blocks of CBLOCK
+ * bytes, aligned on CBLOCK, each a link and CBSIZE characters;
+ * c_cf and c_cl point into the first and last block, and a pointer
+ * on a block boundary means the block is used up.  putc() and getc()
+ * mask interrupts around every character.  The span versions of
+ * b_to_q() and q_to_b() mask them once per call and memcpy() up to
+ * the end of each block.  The ring has a power of two size and free
+ * running indices: the producer writes only r_head and the consumer
+ * only r_tail, so neither masks interrupts.
+ *
+ * The data goes through a simulated UART in loopback: write() puts
+ * the user buffer on the output queue, the transmit interrupt moves
+ * it to the 8 character FIFO, the receive interrupt moves the FIFO
+ * to the input queue, and read() copies it to the user.  Every byte
+ * is checked, and every cblock must be back on the free list at the
+ * end.  The model times the transfer on the build machine and counts
+ * the interrupt masking per byte.  The ring is then run between two
+ * threads, a producer and a consumer, to check that it needs no
+ * lock.  Last, lines are moved from a raw queue to a canonical one
+ * with catq(), a character at a time as in the kernel and in spans.
+ * A cblock holds 28 characters, as on the PIC32.
+ *
+ * Usage: clistsim [-n mbytes] [-w write size]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+/* The kernel names clash with stdio. */
+#undef getc
+#undef putc
+#define getc            cgetc
+#define putc            cputc
+
+#define CBLOCK          32
+#define CBSIZE          28              /* CBLOCK less a PIC32 pointer */
+#define CROUND          (CBLOCK - 1)
+#define NCLIST          32
+#define QLIMIT          (NCLIST / 2 * CBSIZE)   /* per queue */
+#define FIFOSIZE        8
+#define RINGSIZE        512
+#define LINESIZE        72
+
+#define MIN(a, b)       ((a) < (b) ? (a) : (b))
+
+/*
+ * The link is an index into cfree, 32 bits like a pointer on the
+ * PIC32, so that a cblock holds as many characters as there.
+ */
+struct cblock {
+    uint32_t        c_next;
+    char            c_info [CBSIZE];
+};
+
+struct clist {
+    int             c_cc;
+    char            *c_cf;
+    char            *c_cl;
+};
+
+struct cring {
+    volatile unsigned short r_head;     /* next slot to fill */
+    volatile unsigned short r_tail;     /* next slot to drain */
+    unsigned short  r_mask;             /* size - 1 */
+    char            *r_buf;
+};
+
+static struct cblock cfree [NCLIST] __attribute__ ((aligned (CBLOCK)));
+static struct cblock *cfreelist;
+static int cfreecount;
+static unsigned long nspl;
+static int nerrors;
+
+static struct cblock *
+cbnext (struct cblock *bp)
+{
+    return bp->c_next ? &cfree[bp->c_next - 1] : 0;
+}
+
+static uint32_t
+cblink (struct cblock *bp)
+{
+    return bp ? bp - cfree + 1 : 0;
+}
+
+static void
+expect (int cond, const char *what)
+{
+    if (! cond) {
+        printf ("FAIL: %s\n", what);
+        nerrors++;
+    }
+}
+
+/*
+ * Interrupt masking is counted; the model runs in one thread.
+ */
+static int
+spltty ()
+{
+    nspl++;
+    return 0;
+}
+
+static void
+splx (int s)
+{
+}
+
+static void
+cinit ()
+{
+    int i;
+
+    cfreelist = 0;
+    for (i=0; i<NCLIST; i++) {
+        cfree[i].c_next = cblink (cfreelist);
+        cfreelist = &cfree[i];
+    }
+    cfreecount = NCLIST * CBSIZE;
+}
+
+static void
+cbfree (struct cblock *bp)
+{
+    bp->c_next = cblink (cfreelist);
+    cfreelist = bp;
+    cfreecount += CBSIZE;
+}
+
+static struct cblock *
+cballoc ()
+{
+    struct cblock *bp = cfreelist;
+
+    if (bp) {
+        cfreelist = cbnext (bp);
+        cfreecount -= CBSIZE;
+        bp->c_next = 0;
+    }
+    return bp;
+}
+
+/*
+ * A character at a time.
+ */
+static int
+getc (struct clist *p)
+{
+    struct cblock *bp;
+    int c, s;
+
+    s = spltty ();
+    if (p->c_cc <= 0) {
+        c = -1;
+        p->c_cc = 0;
+        p->c_cf = p->c_cl = 0;
+    } else {
+        c = *p->c_cf++ & 0377;
+        if (--p->c_cc <= 0) {
+            bp = (struct cblock*) ((uintptr_t) (p->c_cf - 1) & ~CROUND);
+            p->c_cf = p->c_cl = 0;
+            cbfree (bp);
+        } else if (((uintptr_t) p->c_cf & CROUND) == 0) {
+            bp = (struct cblock*) p->c_cf - 1;
+            p->c_cf = cbnext (bp)->c_info;
+            cbfree (bp);
+        }
+    }
+    splx (s);
+    return c;
+}
+
+static int
+putc (int c, struct clist *p)
+{
+    struct cblock *bp;
+    char *cp;
+    int s;
+
+    s = spltty ();
+    if ((cp = p->c_cl) == 0) {
+        if ((bp = cballoc ()) == 0) {
+            splx (s);
+            return -1;
+        }
+        p->c_cf = cp = bp->c_info;
+    } else if (((uintptr_t) cp & CROUND) == 0) {
+        bp = (struct cblock*) cp - 1;
+        if ((bp->c_next = cblink (cballoc ())) == 0) {
+            splx (s);
+            return -1;
+        }
+        cp = cbnext (bp)->c_info;
+    }
+    *cp++ = c;
+    p->c_cc++;
+    p->c_cl = cp;
+    splx (s);
+    return 0;
+}
+
+/*
+ * A cblock span at a time.  b_to_q() returns the number of
+ * characters not copied, q_to_b() the number copied.
+ */
+static int
+b_to_q (const char *cp, int cc, struct clist *q)
+{
+    struct cblock *bp;
+    char *cq;
+    int nc, s;
+
+    if (cc <= 0)
+        return 0;
+    s = spltty ();
+    if ((cq = q->c_cl) == 0) {
+        if ((bp = cballoc ()) == 0) {
+            splx (s);
+            return cc;
+        }
+        q->c_cf = cq = bp->c_info;
+    }
+    while (cc) {
+        if (((uintptr_t) cq & CROUND) == 0) {
+            bp = (struct cblock*) cq - 1;
+            if ((bp->c_next = cblink (cballoc ())) == 0)
+                break;
+            cq = cbnext (bp)->c_info;
+        }
+        nc = MIN (cc, CBLOCK - ((uintptr_t) cq & CROUND));
+        memcpy (cq, cp, nc);
+        cp += nc;
+        cq += nc;
+        cc -= nc;
+        q->c_cc += nc;
+    }
+    q->c_cl = cq;
+    splx (s);
+    return cc;
+}
+
+static int
+q_to_b (struct clist *q, char *cp, int cc)
+{
+    struct cblock *bp;
+    char *acp = cp;
+    int nc, s;
+
+    if (cc <= 0)
+        return 0;
+    s = spltty ();
+    while (cc && q->c_cc > 0) {
+        nc = CBLOCK - ((uintptr_t) q->c_cf & CROUND);
+        nc = MIN (nc, cc);
+        nc = MIN (nc, q->c_cc);
+        memcpy (cp, q->c_cf, nc);
+        q->c_cf += nc;
+        q->c_cc -= nc;
+        cp += nc;
+        cc -= nc;
+        if (q->c_cc <= 0) {
+            bp = (struct cblock*) ((uintptr_t) (q->c_cf - 1) & ~CROUND);
+            q->c_cf = q->c_cl = 0;
+            cbfree (bp);
+        } else if (((uintptr_t) q->c_cf & CROUND) == 0) {
+            bp = (struct cblock*) q->c_cf - 1;
+            q->c_cf = cbnext (bp)->c_info;
+            cbfree (bp);
+        }
+    }
+    splx (s);
+    return cp - acp;
+}
+
+/*
+ * Append one queue to another, as when a line moves from the raw
+ * queue to the canonical one.  The character version is that of
+ * the kernel.  The span version hands the blocks over when the
+ * target is empty, and otherwise copies through a buffer of a few
+ * cblocks with the span routines.
+ */
+static void
+catq_char (struct clist *from, struct clist *to)
+{
+    int c;
+
+    while ((c = getc (from)) >= 0)
+        putc (c, to);
+}
+
+static void
+catq_span (struct clist *from, struct clist *to)
+{
+    char bbuf [CBSIZE * 4];
+    int s, n;
+
+    s = spltty ();
+    if (to->c_cc == 0) {
+        *to = *from;
+        from->c_cc = 0;
+        from->c_cf = from->c_cl = 0;
+        splx (s);
+        return;
+    }
+    splx (s);
+    while (from->c_cc > 0) {
+        n = q_to_b (from, bbuf, sizeof bbuf);
+        b_to_q (bbuf, n, to);
+    }
+}
+
+/*
+ * The ring.  The release store of an index publishes the characters
+ * written before it; on the single PIC32 core volatile is enough.
+ */
+static int
+cring_put (struct cring *r, const char *cp, int n)
+{
+    unsigned short head = r->r_head;
+    unsigned short tail = __atomic_load_n (&r->r_tail, __ATOMIC_ACQUIRE);
+    int space = r->r_mask + 1 - (unsigned short) (head - tail);
+    int i, nc;
+
+    n = MIN (n, space);
+    i = head & r->r_mask;
+    nc = MIN (n, r->r_mask + 1 - i);
+    memcpy (r->r_buf + i, cp, nc);
+    memcpy (r->r_buf, cp + nc, n - nc);
+    __atomic_store_n (&r->r_head, (unsigned short) (head + n),
+        __ATOMIC_RELEASE);
+    return n;
+}
+
+static int
+cring_get (struct cring *r, char *cp, int n)
+{
+    unsigned short tail = r->r_tail;
+    unsigned short head = __atomic_load_n (&r->r_head, __ATOMIC_ACQUIRE);
+    int count = (unsigned short) (head - tail);
+    int i, nc;
+
+    n = MIN (n, count);
+    i = tail & r->r_mask;
+    nc = MIN (n, r->r_mask + 1 - i);
+    memcpy (cp, r->r_buf + i, nc);
+    memcpy (cp + nc, r->r_buf, n - nc);
+    __atomic_store_n (&r->r_tail, (unsigned short) (tail + n),
+        __ATOMIC_RELEASE);
+    return n;
+}
+
+static void
+cring_init (struct cring *r, char *buf, int size)
+{
+    r->r_head = r->r_tail = 0;
+    r->r_mask = size - 1;
+    r->r_buf = buf;
+}
+
+static char
+pattern (unsigned long i)
+{
+    return (i * 131 + (i >> 8)) & 0xFF;
+}
+
+enum { CHAR, SPAN, RING };
+
+/*
+ * The queues and the UART.
+ */
+static struct clist outq, rawq;
+static struct cring txring, rxring;
+static char txbuf [RINGSIZE], rxbuf [RINGSIZE];
+static char fifo [FIFOSIZE];
+static int fifolen;
+
+static int
+qspace (int mode, int out)
+{
+    if (mode == RING)
+        return out ? RINGSIZE - (unsigned short) (txring.r_head -
+            txring.r_tail) : 0;
+    return QLIMIT - (out ? outq.c_cc : rawq.c_cc);
+}
+
+static int
+put (int mode, int out, const char *cp, int n)
+{
+    struct clist *q = out ? &outq : &rawq;
+    int i;
+
+    switch (mode) {
+    case CHAR:
+        for (i=0; i<n; i++)
+            if (putc (cp[i] & 0377, q) < 0)
+                break;
+        return i;
+    case SPAN:
+        return n - b_to_q (cp, n, q);
+    default:
+        return cring_put (out ? &txring : &rxring, cp, n);
+    }
+}
+
+static int
+get (int mode, int out, char *cp, int n)
+{
+    struct clist *q = out ? &outq : &rawq;
+    int i, c;
+
+    switch (mode) {
+    case CHAR:
+        for (i=0; i<n && (c = getc (q)) >= 0; i++)
+            cp[i] = c;
+        return i;
+    case SPAN:
+        return q_to_b (q, cp, n);
+    default:
+        return cring_get (out ? &txring : &rxring, cp, n);
+    }
+}
+
+static int
+rxspace (int mode)
+{
+    if (mode == RING)
+        return RINGSIZE - (unsigned short) (rxring.r_head - rxring.r_tail);
+    return QLIMIT - rawq.c_cc;
+}
+
+/*
+ * Push total bytes through the loopback.  Returns MB/s.
+ */
+static double
+transfer (int mode, unsigned long total, int wsize)
+{
+    static char ubuf [65536], rbuf [65536];
+    unsigned long sent = 0, got = 0, i;
+    struct timespec t0, t1;
+    int n, m, bad = 0;
+
+    cinit ();
+    memset (&outq, 0, sizeof outq);
+    memset (&rawq, 0, sizeof rawq);
+    cring_init (&txring, txbuf, RINGSIZE);
+    cring_init (&rxring, rxbuf, RINGSIZE);
+    fifolen = 0;
+    nspl = 0;
+
+    clock_gettime (CLOCK_MONOTONIC, &t0);
+    while (got < total) {
+        /* write(): as much of the user buffer as the queue takes. */
+        if (sent < total) {
+            n = MIN (wsize, total - sent);
+            n = MIN (n, qspace (mode, 1));
+            for (i=0; i<n; i++)
+                ubuf[i] = pattern (sent + i);
+            sent += put (mode, 1, ubuf, n);
+        }
+
+        /* Transmit and receive interrupts until the FIFO runs dry. */
+        for (;;) {
+            if (fifolen == 0)
+                fifolen = get (mode, 1, fifo, FIFOSIZE);
+            m = MIN (fifolen, rxspace (mode));
+            if (m == 0)
+                break;
+            m = put (mode, 0, fifo, m);
+            memmove (fifo, fifo + m, fifolen - m);
+            fifolen -= m;
+        }
+
+        /* read(). */
+        n = get (mode, 0, rbuf, sizeof rbuf);
+        for (i=0; i<n; i++)
+            if (rbuf[i] != pattern (got + i))
+                bad = 1;
+        got += n;
+    }
+    clock_gettime (CLOCK_MONOTONIC, &t1);
+
+    expect (! bad, "data arrived intact");
+    if (mode != RING)
+        expect (cfreecount == NCLIST * CBSIZE, "cblocks freed");
+    return total / 1e6 / ((t1.tv_sec - t0.tv_sec) +
+        (t1.tv_nsec - t0.tv_nsec) / 1e9);
+}
+
+/*
+ * Lines through catq() from the raw queue to the canonical one,
+ * which read() drains every fourth line, so that most lines are
+ * copied and some are handed over.  Returns MB/s, with nspl the
+ * interrupt masks of catq() alone.
+ */
+static struct clist canq;
+
+static double
+lines (int mode, unsigned long total)
+{
+    static char line [LINESIZE], rbuf [1024];
+    unsigned long sent = 0, got = 0, nline = 0, masks = 0, m, i;
+    struct timespec t0, t1;
+    int n, bad = 0;
+
+    cinit ();
+    memset (&rawq, 0, sizeof rawq);
+    memset (&canq, 0, sizeof canq);
+
+    clock_gettime (CLOCK_MONOTONIC, &t0);
+    while (got < total) {
+        n = MIN (LINESIZE, total - sent);
+        if (n > 0) {
+            for (i=0; i<n; i++)
+                line[i] = pattern (sent + i);
+            if (b_to_q (line, n, &rawq) != 0)
+                bad = 1;
+            sent += n;
+            m = nspl;
+            if (mode == SPAN)
+                catq_span (&rawq, &canq);
+            else
+                catq_char (&rawq, &canq);
+            masks += nspl - m;
+            nline++;
+        }
+        if (nline % 4 == 0 || sent == total) {
+            while ((n = q_to_b (&canq, rbuf, sizeof rbuf)) > 0) {
+                for (i=0; i<n; i++)
+                    if (rbuf[i] != pattern (got + i))
+                        bad = 1;
+                got += n;
+            }
+        }
+    }
+    clock_gettime (CLOCK_MONOTONIC, &t1);
+
+    expect (! bad, "lines arrived intact");
+    expect (cfreecount == NCLIST * CBSIZE, "cblocks freed after catq");
+    nspl = masks;
+    return total / 1e6 / ((t1.tv_sec - t0.tv_sec) +
+        (t1.tv_nsec - t0.tv_nsec) / 1e9);
+}
+
+/*
+ * The ring between two threads.
+ */
+static unsigned long thread_total;
+
+static void *
+producer (void *arg)
+{
+    static char buf [FIFOSIZE];
+    unsigned long sent = 0, i;
+    int n, m;
+
+    while (sent < thread_total) {
+        n = MIN (FIFOSIZE, thread_total - sent);
+        for (i=0; i<n; i++)
+            buf[i] = pattern (sent + i);
+        for (i=0; i<n; i+=m) {
+            m = cring_put (&rxring, buf + i, n - i);
+            if (m == 0)
+                sched_yield ();
+        }
+        sent += n;
+    }
+    return 0;
+}
+
+static double
+threads (unsigned long total)
+{
+    static char buf [1024];
+    struct timespec t0, t1;
+    unsigned long got = 0, i;
+    pthread_t tid;
+    int n, bad = 0;
+
+    cring_init (&rxring, rxbuf, RINGSIZE);
+    thread_total = total;
+    clock_gettime (CLOCK_MONOTONIC, &t0);
+    pthread_create (&tid, 0, producer, 0);
+    while (got < total) {
+        n = cring_get (&rxring, buf, sizeof buf);
+        if (n == 0)
+            sched_yield ();
+        for (i=0; i<n; i++)
+            if (buf[i] != pattern (got + i))
+                bad = 1;
+        got += n;
+    }
+    pthread_join (tid, 0);
+    clock_gettime (CLOCK_MONOTONIC, &t1);
+    expect (! bad, "ring between threads kept the data in order");
+    return total / 1e6 / ((t1.tv_sec - t0.tv_sec) +
+        (t1.tv_nsec - t0.tv_nsec) / 1e9);
+}
+
+int
+main (int argc, char **argv)
+{
+    static const char *name[] = { "putc/getc:", "cblock spans:", "ring:" };
+    static const char *cname[] = { "catq, chars:", "catq, spans:" };
+    unsigned long total = 16L * 1024 * 1024;
+    int opt, wsize = 100, mode;
+    double mbs;
+
+    while ((opt = getopt (argc, argv, "n:w:")) != -1) {
+        switch (opt) {
+        case 'n':
+            total = strtoul (optarg, 0, 0) * 1024 * 1024;
+            break;
+        case 'w':
+            wsize = strtoul (optarg, 0, 0);
+            break;
+        default:
+usage:      fprintf (stderr, "Usage: clistsim [-n mbytes] [-w write size]\n");
+            return 1;
+        }
+    }
+    if (total == 0 || wsize < 1 || wsize > 65536)
+        goto usage;
+
+    printf ("%lu Mbytes through the UART loopback, %d byte writes, "
+        "%d byte FIFO:\n", total >> 20, wsize, FIFOSIZE);
+    for (mode=CHAR; mode<=RING; mode++) {
+        mbs = transfer (mode, total, wsize);
+        printf ("%-14s %7.1f Mbytes/s, %.3f interrupt masks per byte\n",
+            name[mode], mbs, (double) nspl / total);
+    }
+    printf ("ring, 2 threads: %6.1f Mbytes/s\n", threads (total));
+
+    printf ("%d character lines through catq(), read every 4 lines:\n",
+        LINESIZE);
+    for (mode=CHAR; mode<=SPAN; mode++) {
+        mbs = lines (mode, total);
+        printf ("%-14s %7.1f Mbytes/s, %.3f interrupt masks per byte\n",
+            cname[mode], mbs, (double) nspl / total);
+    }
+
+    if (nerrors) {
+        printf ("%d checks failed\n", nerrors);
+        return 1;
+    }
+    printf ("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,240 @@
+/*
+ * Host model of the glcd driver with a shadow copy of display RAM.
+ *
+ * The display is two KS0108 controllers of 64 columns by 8 pages,
+ * selected by CS1/CS2.  Every transaction on the parallel bus sets
+ * DI, RW, the chip selects and the eight data pins one by one, then
+ * strobes E, so the cost of an update is the number of transactions.
+ *
+ * The stock GLCD_UPDATE rewrites the whole frame buffer: for every
+ * chip and page, SET_PAGE, SET_Y 0 and 64 data writes.  The shadow
+ * update compares the frame buffer with a copy of what the display
+ * holds and writes only the changed runs of columns, with SET_PAGE
+ * once per touched page and SET_Y only where the auto-incremented
+ * address does not already point to the run.
+ *
+ * The controller model checks after every update that its RAM
+ * matches the frame buffer.
+ *
+ * Usage: glcdsim [-n updates]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define GLCD_CMD_SET_Y      0x40
+#define GLCD_CMD_SET_PAGE   0xb8
+
+#define CHIPS       2
+#define CHIP_WIDTH  64
+#define WIDTH       (CHIPS * CHIP_WIDTH)
+#define PAGES       8
+#define HEIGHT      (PAGES * 8)
+
+#define PINS_PER_XFER   14      /* DI, RW, CS1, CS2, DB0-7, E high, E low */
+
+/*
+ * One KS0108 controller.
+ */
+struct ks0108 {
+    unsigned char   ram [PAGES] [CHIP_WIDTH];
+    unsigned        page;
+    unsigned        y;
+};
+
+static struct ks0108 chip [CHIPS];
+static unsigned long ninstr, ndata;
+
+/*
+ * One bus transaction to the selected chip.
+ */
+static void
+bus_write (unsigned c, int di, unsigned data)
+{
+    struct ks0108 *k = &chip[c];
+
+    if (di) {
+        k->ram[k->page][k->y] = data;
+        k->y = (k->y + 1) % CHIP_WIDTH;
+        ndata++;
+        return;
+    }
+    if ((data & 0xc0) == GLCD_CMD_SET_Y)
+        k->y = data & 0x3f;
+    else if ((data & 0xf8) == GLCD_CMD_SET_PAGE)
+        k->page = data & 7;
+    ninstr++;
+}
+
+/*
+ * Driver state: the frame buffer filled by the drawing ioctls,
+ * and the shadow of display RAM.
+ */
+static unsigned char screen [PAGES] [WIDTH];
+static unsigned char shadow [PAGES] [WIDTH];
+static int shadow_valid;
+static unsigned seed;
+
+static void
+update_full ()
+{
+    unsigned c, page, x;
+
+    for (c=0; c<CHIPS; c++) {
+        for (page=0; page<PAGES; page++) {
+            bus_write (c, 0, GLCD_CMD_SET_PAGE | page);
+            bus_write (c, 0, GLCD_CMD_SET_Y | 0);
+            for (x=0; x<CHIP_WIDTH; x++)
+                bus_write (c, 1, screen[page][c*CHIP_WIDTH + x]);
+        }
+    }
+}
+
+static void
+update_shadow ()
+{
+    unsigned c, page, x, col, y;
+    int page_set;
+
+    if (! shadow_valid) {
+        update_full ();
+        memcpy (shadow, screen, sizeof shadow);
+        shadow_valid = 1;
+        return;
+    }
+    for (c=0; c<CHIPS; c++) {
+        for (page=0; page<PAGES; page++) {
+            page_set = 0;
+            y = CHIP_WIDTH;                 /* address unknown */
+            for (x=0; x<CHIP_WIDTH; x++) {
+                col = c*CHIP_WIDTH + x;
+                if (screen[page][col] == shadow[page][col])
+                    continue;
+                if (! page_set) {
+                    bus_write (c, 0, GLCD_CMD_SET_PAGE | page);
+                    page_set = 1;
+                }
+                if (y != x)
+                    bus_write (c, 0, GLCD_CMD_SET_Y | x);
+                bus_write (c, 1, screen[page][col]);
+                shadow[page][col] = screen[page][col];
+                y = x + 1;
+            }
+        }
+    }
+}
+
+static void
+set_pixel (unsigned x, unsigned y, int ink)
+{
+    if (x >= WIDTH || y >= HEIGHT)
+        return;
+    if (ink)
+        screen[y/8][x] |= 1 << (y % 8);
+    else
+        screen[y/8][x] &= ~(1 << (y % 8));
+}
+
+/*
+ * Compare the controllers with the frame buffer.
+ */
+static int
+check ()
+{
+    unsigned c, page;
+
+    for (c=0; c<CHIPS; c++)
+        for (page=0; page<PAGES; page++)
+            if (memcmp (chip[c].ram[page], &screen[page][c*CHIP_WIDTH],
+                        CHIP_WIDTH) != 0)
+                return -1;
+    return 0;
+}
+
+/*
+ * Workload: a strip chart scrolling one column per update in the
+ * lower half, a counter redrawn in the upper left, and a blinking
+ * cursor.  Every tenth update clears the screen and redraws a frame.
+ */
+static void
+draw (unsigned n)
+{
+    unsigned x, y, v;
+
+    if (n % 10 == 0) {
+        memset (screen, 0, sizeof screen);
+        for (x=0; x<WIDTH; x++) {
+            set_pixel (x, 0, 1);
+            set_pixel (x, HEIGHT - 1, 1);
+        }
+    }
+
+    /* Strip chart: shift pages 4..7 left by one column. */
+    for (y=4; y<PAGES; y++) {
+        memmove (&screen[y][0], &screen[y][1], WIDTH - 1);
+        screen[y][WIDTH - 1] = 0;
+    }
+    seed = seed * 1103515245 + 12345;
+    v = (seed >> 16) % 31;
+    set_pixel (WIDTH - 1, 32 + v, 1);
+
+    /* Counter: an 8x8 cell pattern per digit. */
+    for (x=0; x<5; x++)
+        for (y=0; y<8; y++)
+            screen[1][8 + x*8 + y] = ((n >> x) & 1) ? 0x7e >> (y & 1) : 0x3c;
+
+    /* Cursor. */
+    for (y=16; y<24; y++)
+        set_pixel (120, y, n & 1);
+}
+
+int
+main (int argc, char **argv)
+{
+    unsigned long full_instr, full_data;
+    unsigned n, nupdates = 1000;
+    int opt, pass;
+
+    while ((opt = getopt (argc, argv, "n:")) != -1) {
+        switch (opt) {
+        case 'n':
+            nupdates = strtoul (optarg, 0, 0);
+            break;
+        default:
+            fprintf (stderr, "Usage: glcdsim [-n updates]\n");
+            return 1;
+        }
+    }
+
+    full_instr = full_data = 0;
+    for (pass=0; pass<2; pass++) {
+        memset (chip, 0, sizeof chip);
+        memset (screen, 0, sizeof screen);
+        shadow_valid = 0;
+        seed = 1;
+        ninstr = ndata = 0;
+        for (n=0; n<nupdates; n++) {
+            draw (n);
+            if (pass == 0)
+                update_full ();
+            else
+                update_shadow ();
+            if (check () < 0) {
+                printf ("%s update %u: display RAM differs\n",
+                    pass ? "shadow" : "full", n);
+                return 1;
+            }
+        }
+        printf ("%-7s %lu instructions, %lu data writes, %lu pin operations\n",
+            pass ? "shadow:" : "full:", ninstr, ndata,
+            (ninstr + ndata) * PINS_PER_XFER);
+        if (pass == 0) {
+            full_instr = ninstr;
+            full_data = ndata;
+        }
+    }
+    printf ("saved:  %.1f%% of the bus transactions, %u updates verified\n",
+        100.0 - 100.0 * (ninstr + ndata) / (full_instr + full_data), nupdates);
+    return 0;
+}
@@ -0,0 +1,290 @@
+/*
+ * Host model of edge capture for the GPIO driver.
+ *
+ * With GPIO_POLL a program reads the port once per ioctl and sees
+ * a pulse only if a sample falls inside it.  In capture mode the
+ * change notice interrupt reads the port when a pin changes and
+ * stores (changed pins, port value, core timer count) in a ring
+ * buffer, which the program drains with read() when select() says
+ * there is data.
+ *
+ * The model feeds synthetic pulse trains, like those of flow meters,
+ * to both schemes in simulated time and counts how many pulses each
+ * one sees on every pin.  Edges which come closer together than the
+ * interrupt can take them are merged, as on the chip: the handler
+ * compares the port with the value it recorded last, so a pulse that
+ * is over by the time the handler runs is lost.  When the reader is
+ * late the ring overflows; the oldest records are dropped and the
+ * next record returned carries the overrun flag.
+ *
+ * Costs are assumptions for an 80 MHz PIC32: the core timer counts
+ * at 40 MHz, the interrupt starts 1.5 us after the edge and takes
+ * 2 us, and the reading process runs 1 ms after select() wakes it.
+ * A GPIO_POLL ioctl takes 12 us, and a polling process shares the
+ * processor with another one in 10 ms slices.
+ *
+ * Usage: gpiosim [-r ring size] [-t seconds]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define NS_PER_TICK     25              /* core timer at 40 MHz */
+#define INTR_LATENCY    1500            /* ns */
+#define INTR_SERVICE    2000            /* ns */
+#define POLL_NS         12000           /* one GPIO_POLL ioctl */
+#define WAKEUP_NS       1000000         /* reader runs 1 ms after wakeup */
+#define SLICE_NS        10000000        /* time slice of the poller */
+
+#define GPIO_OVERRUN    0x80000000
+
+#define NEVER           (~0ULL >> 1)
+
+typedef unsigned long long nsec_t;
+
+/*
+ * A record in the capture ring, as read() returns it.
+ */
+struct gpio_event {
+    unsigned    mask;       /* pins which changed */
+    unsigned    value;      /* port value after the change */
+    unsigned    time;       /* core timer count */
+};
+
+/*
+ * A pulse train on one pin.
+ */
+struct meter {
+    const char  *name;
+    unsigned    pin;
+    nsec_t      period;     /* ns */
+    nsec_t      width;      /* ns */
+};
+
+static struct meter meters [] = {
+    { "slow",   0, 2000000,  50000 },   /* 500 Hz, 50 us */
+    { "medium", 1,  500000,  10000 },   /* 2 kHz, 10 us */
+    { "fast",   2,  125000,   3000 },   /* 8 kHz, 3 us */
+    { "spike",  3,  333333,   1000 },   /* 3 kHz, 1 us */
+};
+
+#define NMETERS (sizeof meters / sizeof meters[0])
+
+struct edge {
+    nsec_t      time;
+    unsigned    pin;
+};
+
+static struct edge *edges;
+static unsigned nedges;
+static unsigned long npulses [NMETERS];
+
+static int
+edge_cmp (const void *a, const void *b)
+{
+    const struct edge *x = a, *y = b;
+
+    if (x->time != y->time)
+        return (x->time < y->time) ? -1 : 1;
+    return (int) x->pin - (int) y->pin;
+}
+
+/*
+ * Rising and falling edge of every pulse, with a random jitter
+ * of up to a quarter of the period between the pulses.
+ */
+static void
+make_edges (nsec_t duration)
+{
+    unsigned i, max = 0, seed = 1;
+    nsec_t t;
+
+    for (i=0; i<NMETERS; i++)
+        max += 2 * (duration / meters[i].period + 1);
+    edges = malloc (max * sizeof *edges);
+    nedges = 0;
+    for (i=0; i<NMETERS; i++) {
+        t = meters[i].period / (i + 2);
+        while (t + meters[i].width < duration) {
+            edges[nedges].time = t;
+            edges[nedges++].pin = meters[i].pin;
+            edges[nedges].time = t + meters[i].width;
+            edges[nedges++].pin = meters[i].pin;
+            npulses[i]++;
+
+            seed = seed * 1103515245 + 12345;
+            t += meters[i].period - meters[i].period / 8 +
+                (seed >> 8) % (meters[i].period / 4);
+        }
+    }
+    qsort (edges, nedges, sizeof *edges, edge_cmp);
+}
+
+/*
+ * Count the rising edges seen in a sequence of port values.
+ */
+static void
+count_rising (unsigned long *count, unsigned prev, unsigned value)
+{
+    unsigned i, rose = ~prev & value;
+
+    for (i=0; i<NMETERS; i++)
+        if (rose >> meters[i].pin & 1)
+            count[i]++;
+}
+
+/*
+ * Capture mode.
+ */
+static unsigned long cap_seen [NMETERS];
+static unsigned long cap_records, cap_dropped, cap_overruns, cap_reads;
+static nsec_t cap_max_error;
+
+static void
+capture (nsec_t duration, unsigned ringsize)
+{
+    struct gpio_event *ring, *ev;
+    unsigned head = 0, tail = 0, port = 0, last = 0, seen = 0, lost = 0;
+    nsec_t now, intr = NEVER, busy = 0, reader = NEVER;
+    nsec_t first_edge = 0, err;
+    unsigned i = 0;
+
+    ring = malloc (ringsize * sizeof *ring);
+    for (;;) {
+        now = (i < nedges) ? edges[i].time : NEVER;
+        if (intr < now)
+            now = intr;
+        if (reader < now)
+            now = reader;
+        if (now >= duration)
+            break;
+
+        if (now == reader) {
+            /* The process runs: read() everything in the ring. */
+            if (head != tail)
+                cap_reads++;
+            while (tail != head) {
+                ev = &ring[tail++ % ringsize];
+                if (ev->mask & GPIO_OVERRUN)
+                    cap_overruns++;
+                count_rising (cap_seen, seen, ev->value);
+                seen = ev->value;
+            }
+            reader = NEVER;
+
+        } else if (now == intr) {
+            /* Change notice interrupt: read the port. */
+            intr = NEVER;
+            busy = now + INTR_SERVICE;
+            if (port == last)
+                continue;
+            if (head - tail == ringsize) {
+                tail++;
+                cap_dropped++;
+                lost = GPIO_OVERRUN;
+            }
+            ev = &ring[head++ % ringsize];
+            ev->mask = (port ^ last) | lost;
+            ev->value = port;
+            ev->time = now / NS_PER_TICK;
+            lost = 0;
+            last = port;
+            cap_records++;
+
+            /* Wake up the reader in select(). */
+            if (reader == NEVER)
+                reader = now + WAKEUP_NS;
+
+            err = now - first_edge;
+            if (err > cap_max_error)
+                cap_max_error = err;
+
+        } else {
+            /* A pin changes. */
+            port ^= 1 << edges[i].pin;
+            i++;
+            if (intr == NEVER) {
+                first_edge = now;
+                intr = now + INTR_LATENCY;
+                if (intr < busy)
+                    intr = busy;
+            }
+        }
+    }
+    free (ring);
+}
+
+/*
+ * GPIO_POLL in a loop, whenever the process has the processor.
+ * It is given half of it, in 10 ms slices.
+ */
+static unsigned long poll_seen [NMETERS];
+static unsigned long poll_calls;
+
+static void
+poll (nsec_t duration)
+{
+    unsigned i = 0, port = 0, prev = 0;
+    nsec_t t;
+
+    for (t=0; t<duration; t+=POLL_NS) {
+        if ((t / SLICE_NS) & 1)
+            continue;
+        while (i < nedges && edges[i].time <= t)
+            port ^= 1 << edges[i++].pin;
+        count_rising (poll_seen, prev, port);
+        prev = port;
+        poll_calls++;
+    }
+}
+
+int
+main (int argc, char **argv)
+{
+    unsigned ringsize = 64, i;
+    double seconds = 1;
+    nsec_t duration;
+    int opt;
+
+    while ((opt = getopt (argc, argv, "r:t:")) != -1) {
+        switch (opt) {
+        case 'r':
+            ringsize = strtoul (optarg, 0, 0);
+            break;
+        case 't':
+            seconds = atof (optarg);
+            break;
+        default:
+            fprintf (stderr, "Usage: gpiosim [-r ring size] [-t seconds]\n");
+            return 1;
+        }
+    }
+    if (ringsize == 0)
+        ringsize = 1;
+    duration = seconds * 1e9;
+
+    make_edges (duration);
+    capture (duration, ringsize);
+    poll (duration);
+
+    printf ("%-8s %8s %8s %8s %8s\n", "pin", "width", "pulses",
+        "capture", "poll");
+    for (i=0; i<NMETERS; i++) {
+        printf ("%-8s %5llu us %8lu %7.1f%% %7.1f%%\n",
+            meters[i].name, meters[i].width / 1000, npulses[i],
+            100.0 * cap_seen[i] / npulses[i],
+            100.0 * poll_seen[i] / npulses[i]);
+    }
+    printf ("capture: ring %u, %lu records in %lu reads, %lu dropped, "
+        "%lu overrun marks, timestamp late by %llu ns at most\n",
+        ringsize, cap_records, cap_reads, cap_dropped, cap_overruns,
+        cap_max_error);
+    printf ("poll:    %lu ioctls\n", poll_calls);
+
+    /* Nothing may be seen that was not there. */
+    for (i=0; i<NMETERS; i++)
+        if (cap_seen[i] > npulses[i] || poll_seen[i] > npulses[i])
+            return 1;
+    return 0;
+}
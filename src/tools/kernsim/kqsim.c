@@ -0,0 +1,484 @@
+/*
+ * Host model of event wakeup: select() against a kqueue which keeps
+ * the registered events between calls.
+ *
+ * select() copies in the fd_set and calls fo_select() on every
+ * descriptor in it.  When none is ready it records itself as the
+ * selecting process of each file and sleeps on selwait; a second
+ * process selecting on the same file is a collision, and then
+ * selwakeup() wakes every process sleeping on selwait.  After the
+ * wakeup select() scans all the descriptors again.  The user then
+ * looks for the bits set in the returned fd_set.  With a kqueue the
+ * events are added once, as knotes on the watched file.  The driver
+ * calls kqwakeup() next to selwakeup(): it puts each knote of the
+ * file on the ready list of its kqueue and wakes the process sleeping
+ * in kevent().  kevent() confirms the queued knotes through
+ * fo_select() and copies out a struct kevent for each ready one.  A
+ * knote stays queued while the file is ready, unless it was added
+ * with EV_CLEAR.
+ *
+ * Each process watches its own descriptors, plus one file shared by
+ * all of them, like a listening socket.  Data arrives on random files
+ * one event at a time, and the process that wakes up reads every
+ * ready descriptor, then waits again.  Both ways must deliver all the
+ * data, and the kqueue must keep the level and edge triggered rules.
+ * The model counts the operations per event and converts them into
+ * processor cycles with the costs below, assumptions for an 80 MHz
+ * PIC32.
+ *
+ * Usage: kqsim [-p procs] [-n events] [-s seed]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define SYSCALL_CYCLES  600     /* select(), kevent() or read() */
+#define SWITCH_CYCLES   500     /* wakeup() and swtch() */
+#define FOSEL_CYCLES    60      /* getf() and fo_select() */
+#define WORD_CYCLES     10      /* copyin() or copyout() of an fd_mask */
+#define BIT_CYCLES      4       /* FD_ISSET() in the user loop */
+#define KEVENT_CYCLES   40      /* copyout() of a struct kevent */
+#define KNOTE_CYCLES    15      /* hash and klist step in kqwakeup() */
+
+/* The host has its own fd_set. */
+#undef NFDBITS
+
+#define NOFILE          30
+#define NFDBITS         32
+#define MAXPROC         8
+#define NFILE           (MAXPROC * NOFILE)
+
+/*
+ * The BSD event interface.
+ */
+struct kevent {
+    unsigned long   ident;
+    short           filter;
+    unsigned short  flags;
+    unsigned        fflags;
+    long            data;
+    void            *udata;
+};
+
+#define EVFILT_READ     (-1)
+#define EV_ADD          0x0001
+#define EV_DELETE       0x0002
+#define EV_CLEAR        0x0020
+
+#define EV_SET(kevp, a, b, c, d, e, f) do {     \
+        struct kevent *__kevp = (kevp);         \
+        __kevp->ident = (a);                    \
+        __kevp->filter = (b);                   \
+        __kevp->flags = (c);                    \
+        __kevp->fflags = (d);                   \
+        __kevp->data = (e);                     \
+        __kevp->udata = (f);                    \
+    } while (0)
+
+enum { SELECT, KQUEUE };
+
+struct knote {
+    struct knote    *kn_link;       /* on the file */
+    struct knote    *kn_next;       /* on the ready list */
+    struct proc     *kn_kq;
+    int             kn_fd;
+    int             kn_flags;
+    int             kn_queued;
+};
+
+struct file {
+    int             f_data;         /* bytes waiting */
+    struct proc     *f_sel;         /* selecting process */
+    int             f_coll;
+    struct knote    *f_klist;
+};
+
+struct proc {
+    struct file     *p_fd [NOFILE];
+    int             p_nfd;
+    int             p_sleeping;
+    int             p_runnable;
+    struct knote    *p_kqhead, **p_kqtail;
+    struct knote    p_knote [NOFILE];
+};
+
+/*
+ * Operations done, for the cost.
+ */
+struct ops {
+    unsigned long   syscalls, switches, fosel, words, bits;
+    unsigned long   kevents, knotes, empty;
+};
+
+static struct file file [NFILE + 1];
+static struct proc proc [MAXPROC];
+static int nproc = 3;
+static struct ops ops;
+static unsigned long delivered;
+static int nerrors;
+
+static void
+expect (int cond, const char *what)
+{
+    if (! cond) {
+        printf ("FAIL: %s\n", what);
+        nerrors++;
+    }
+}
+
+static unsigned
+rnd (unsigned long *seed, unsigned n)
+{
+    *seed = *seed * 1103515245 + 12345;
+    return (*seed >> 16) % n;
+}
+
+static void
+setrun (struct proc *p)
+{
+    if (p->p_sleeping) {
+        p->p_sleeping = 0;
+        p->p_runnable = 1;
+    }
+}
+
+/*
+ * Wake the process selecting on the file, or all of them after a
+ * collision.
+ */
+static void
+selwakeup (struct file *f)
+{
+    int i;
+
+    if (f->f_coll) {
+        f->f_coll = 0;
+        for (i=0; i<nproc; i++)
+            setrun (&proc[i]);
+    } else if (f->f_sel)
+        setrun (f->f_sel);
+    f->f_sel = 0;
+}
+
+static void
+kqenqueue (struct knote *kn)
+{
+    struct proc *p = kn->kn_kq;
+
+    kn->kn_queued = 1;
+    kn->kn_next = 0;
+    *p->p_kqtail = kn;
+    p->p_kqtail = &kn->kn_next;
+}
+
+static void
+kqwakeup (struct file *f)
+{
+    struct knote *kn;
+
+    for (kn=f->f_klist; kn; kn=kn->kn_link) {
+        ops.knotes++;
+        if (! kn->kn_queued)
+            kqenqueue (kn);
+        setrun (kn->kn_kq);
+    }
+}
+
+/*
+ * kevent() with a change list, or waiting for events.
+ */
+static int
+kevent (struct proc *p, const struct kevent *changes, int nchanges,
+    struct kevent *events, int nevents)
+{
+    struct knote *kn, **prev;
+    struct file *f;
+    int i, n;
+
+    ops.syscalls++;
+    for (i=0; i<nchanges; i++) {
+        kn = &p->p_knote[changes[i].ident];
+        f = p->p_fd[changes[i].ident];
+        if (changes[i].flags & EV_ADD) {
+            kn->kn_kq = p;
+            kn->kn_fd = changes[i].ident;
+            kn->kn_flags = changes[i].flags;
+            kn->kn_link = f->f_klist;
+            f->f_klist = kn;
+            if (f->f_data > 0 && ! kn->kn_queued)
+                kqenqueue (kn);
+        }
+    }
+    n = 0;
+    prev = &p->p_kqhead;
+    while ((kn = *prev) && n < nevents) {
+        ops.fosel++;
+        f = p->p_fd[kn->kn_fd];
+        if (f->f_data > 0) {
+            ops.kevents++;
+            EV_SET (&events[n], kn->kn_fd, EVFILT_READ, kn->kn_flags,
+                0, f->f_data, 0);
+            n++;
+            if (! (kn->kn_flags & EV_CLEAR)) {
+                prev = &kn->kn_next;
+                continue;
+            }
+        }
+        kn->kn_queued = 0;
+        *prev = kn->kn_next;
+    }
+    for (p->p_kqtail=&p->p_kqhead; *p->p_kqtail;
+        p->p_kqtail=&(*p->p_kqtail)->kn_next)
+        continue;
+    return n;
+}
+
+/*
+ * select() over the first nfd descriptors, for reading.
+ */
+static int
+select1 (struct proc *p, unsigned *set)
+{
+    unsigned in [NOFILE / NFDBITS + 1];
+    struct file *f;
+    int nwords, fd, n;
+
+    ops.syscalls++;
+    nwords = (p->p_nfd + NFDBITS - 1) / NFDBITS;
+    ops.words += nwords;
+    memcpy (in, set, nwords * sizeof *set);
+    memset (set, 0, nwords * sizeof *set);
+    n = 0;
+    for (fd=0; fd<p->p_nfd; fd++) {
+        if (! (in[fd / NFDBITS] & 1u << fd % NFDBITS))
+            continue;
+        ops.fosel++;
+        f = p->p_fd[fd];
+        if (f->f_data > 0) {
+            set[fd / NFDBITS] |= 1u << fd % NFDBITS;
+            n++;
+        } else if (f->f_sel && f->f_sel != p && f->f_sel->p_sleeping)
+            f->f_coll = 1;
+        else
+            f->f_sel = p;
+    }
+    ops.words += nwords;
+    return n;
+}
+
+static void
+readfd (struct proc *p, int fd)
+{
+    struct file *f = p->p_fd[fd];
+
+    ops.syscalls++;
+    if (f->f_data == 0) {
+        /* Another process took it first. */
+        ops.empty++;
+        return;
+    }
+    delivered += f->f_data;
+    f->f_data = 0;
+}
+
+/*
+ * Run a process from its wakeup until it sleeps again.
+ */
+static void
+run (struct proc *p, int mode)
+{
+    struct kevent ev [NOFILE];
+    unsigned set [NOFILE / NFDBITS + 1];
+    int fd, i, n;
+
+    p->p_runnable = 0;
+    ops.switches++;
+    for (;;) {
+        if (mode == SELECT) {
+            memset (set, 0, sizeof set);
+            for (fd=0; fd<p->p_nfd; fd++)
+                set[fd / NFDBITS] |= 1u << fd % NFDBITS;
+            n = select1 (p, set);
+            if (n == 0)
+                break;
+            for (fd=0; fd<p->p_nfd; fd++) {
+                ops.bits++;
+                if (set[fd / NFDBITS] & 1u << fd % NFDBITS)
+                    readfd (p, fd);
+            }
+        } else {
+            n = kevent (p, 0, 0, ev, NOFILE);
+            if (n == 0)
+                break;
+            for (i=0; i<n; i++)
+                readfd (p, ev[i].ident);
+        }
+    }
+    p->p_sleeping = 1;
+}
+
+/*
+ * Give each process nfd descriptors, the first one shared, and let
+ * them wait.
+ */
+static void
+setup (int nfd, int mode, int flags)
+{
+    struct kevent ch [NOFILE];
+    struct proc *p;
+    int i, fd, nf = 1;
+
+    memset (file, 0, sizeof file);
+    memset (proc, 0, sizeof proc);
+    for (i=0; i<nproc; i++) {
+        p = &proc[i];
+        p->p_nfd = nfd;
+        p->p_kqtail = &p->p_kqhead;
+        p->p_fd[0] = &file[0];
+        for (fd=1; fd<nfd; fd++)
+            p->p_fd[fd] = &file[nf++];
+        if (mode == KQUEUE) {
+            for (fd=0; fd<nfd; fd++)
+                EV_SET (&ch[fd], fd, EVFILT_READ, EV_ADD | flags, 0, 0, 0);
+            kevent (p, ch, nfd, 0, 0);
+        }
+        run (p, mode);
+    }
+    memset (&ops, 0, sizeof ops);
+    delivered = 0;
+}
+
+static double
+simulate (int nfd, int mode, long nevents, unsigned long seed)
+{
+    struct file *f;
+    unsigned long sent = 0;
+    long e;
+    int i, n, nf, busy;
+
+    setup (nfd, mode, 0);
+    nf = 1 + nproc * (nfd - 1);
+    for (e=0; e<nevents; e++) {
+        f = &file[rnd (&seed, nf)];
+        n = 1 + rnd (&seed, 64);
+        f->f_data += n;
+        sent += n;
+        if (mode == SELECT)
+            selwakeup (f);
+        else
+            kqwakeup (f);
+        do {
+            busy = 0;
+            for (i=0; i<nproc; i++) {
+                if (proc[i].p_runnable) {
+                    run (&proc[i], mode);
+                    busy = 1;
+                }
+            }
+        } while (busy);
+    }
+    expect (delivered == sent, "all the data is delivered");
+    for (i=0; i<nf; i++)
+        expect (file[i].f_data == 0, "no data is left behind");
+    return ops.syscalls * (double) SYSCALL_CYCLES +
+        ops.switches * (double) SWITCH_CYCLES +
+        ops.fosel * (double) FOSEL_CYCLES +
+        ops.words * (double) WORD_CYCLES +
+        ops.bits * (double) BIT_CYCLES +
+        ops.kevents * (double) KEVENT_CYCLES +
+        ops.knotes * (double) KNOTE_CYCLES;
+}
+
+/*
+ * A level triggered knote is returned while the file is ready, an
+ * EV_CLEAR knote once per wakeup.
+ */
+static void
+triggers ()
+{
+    struct kevent ch [2], ev [2];
+    struct proc *p = &proc[0];
+    int n;
+
+    nproc = 1;
+    memset (file, 0, sizeof file);
+    memset (proc, 0, sizeof proc);
+    p->p_nfd = 2;
+    p->p_kqtail = &p->p_kqhead;
+    p->p_fd[0] = &file[0];
+    p->p_fd[1] = &file[1];
+    EV_SET (&ch[0], 0, EVFILT_READ, EV_ADD, 0, 0, 0);
+    EV_SET (&ch[1], 1, EVFILT_READ, EV_ADD | EV_CLEAR, 0, 0, 0);
+    kevent (p, ch, 2, 0, 0);
+    expect (kevent (p, 0, 0, ev, 2) == 0, "no events before data");
+
+    file[0].f_data = file[1].f_data = 10;
+    kqwakeup (&file[0]);
+    kqwakeup (&file[1]);
+    n = kevent (p, 0, 0, ev, 2);
+    expect (n == 2 && ev[0].data == 10, "both events are returned");
+    n = kevent (p, 0, 0, ev, 2);
+    expect (n == 1 && ev[0].ident == 0, "only the level event stays");
+    file[0].f_data = 0;
+    expect (kevent (p, 0, 0, ev, 2) == 0, "a drained file is dropped");
+
+    file[1].f_data += 5;
+    kqwakeup (&file[1]);
+    n = kevent (p, 0, 0, ev, 2);
+    expect (n == 1 && ev[0].ident == 1 && ev[0].data == 15,
+        "the edge event comes back on new data");
+}
+
+int
+main (int argc, char **argv)
+{
+    static const int nfds[] = { 4, 8, 16, 30 };
+    unsigned long seed = 1;
+    long nevents = 100000;
+    double c [2], f [2], s [2];
+    int opt, k, mode, procs;
+
+    while ((opt = getopt (argc, argv, "p:n:s:")) != -1) {
+        switch (opt) {
+        case 'p':
+            nproc = strtoul (optarg, 0, 0);
+            break;
+        case 'n':
+            nevents = strtoul (optarg, 0, 0);
+            break;
+        case 's':
+            seed = strtoul (optarg, 0, 0);
+            break;
+        default:
+usage:      fprintf (stderr, "Usage: kqsim [-p procs] [-n events] "
+                "[-s seed]\n");
+            return 1;
+        }
+    }
+    if (nproc < 1 || nproc > MAXPROC || nevents < 1)
+        goto usage;
+    procs = nproc;
+
+    printf ("%d processes, %ld events, cycles per event:\n",
+        procs, nevents);
+    for (k=0; k<4; k++) {
+        for (mode=SELECT; mode<=KQUEUE; mode++) {
+            c[mode] = simulate (nfds[k], mode, nevents, seed) / nevents;
+            f[mode] = (double) ops.fosel / nevents;
+            s[mode] = (double) ops.switches / nevents;
+        }
+        printf ("%2d descriptors: select %6.0f (%5.1f fo_select, "
+            "%.2f switches), kqueue %6.0f (%4.1f, %.2f)\n", nfds[k],
+            c[SELECT], f[SELECT], s[SELECT], c[KQUEUE], f[KQUEUE],
+            s[KQUEUE]);
+    }
+    triggers ();
+    nproc = procs;
+    if (nerrors) {
+        printf ("%d checks failed\n", nerrors);
+        return 1;
+    }
+    printf ("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,542 @@
+/*
+ * Host model of the swap map: the first fit resource map of the
+ * kernel against best fit, replaying a trace of swapouts and
+ * swapins.
+ *
+ * The map is that of the kernel: an array of SMAPSIZ free segments
+ * sorted by address and ended by one of size zero.  mfree() merges
+ * freed units with the neighbouring segments, or inserts a segment,
+ * and discards the units when the array is full.  malloc() takes
+ * units from the start of the first segment large enough.
+ * malloc3() places the data, stack and u area in turn, and gives
+ * everything back when one of them does not fit.  The best fit
+ * malloc() takes the smallest segment large enough, and its
+ * malloc3() places the three segments largest first.
+ *
+ * A swapout allocates the three segments of a process, a swapin
+ * frees them.  The trace comes from a seeded generator, or from a
+ * file of lines "o pid dsize ssize usize" and "i pid", sizes in
+ * blocks.  It can be written to a file, to replay it later or on
+ * the kernel.  Like the kernel, the generator keeps one process in
+ * core and swaps it out to run another: it forks, grows, shrinks
+ * and exits processes, but never asks for more than the swap area
+ * holds in total.  So a failed swapout is always fragmentation.
+ * Both allocators replay the same trace.  A swapout which fails
+ * leaves that process out of the rest of the trace.  After each
+ * operation the model checks the map against a block by block
+ * shadow: segments sorted, merged, and all free blocks in them.  It
+ * reports the failures and the fragmentation seen by the swapouts.
+ *
+ * Usage: mapsim [-n events] [-p procs] [-b blocks] [-m slots]
+ *               [-s seed] [-w trace] [-r trace]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MAXPROC         256
+#define MAXEVENT        1000000
+#define USIZE           3               /* u area, blocks */
+
+struct mapent {
+    size_t  m_size;
+    size_t  m_addr;
+};
+
+struct map {
+    struct mapent   *m_map;
+    struct mapent   *m_limit;           /* last slot */
+    int             bestfit;
+};
+
+struct event {
+    char            op;                 /* 'o' or 'i' */
+    int             pid;
+    size_t          size [3];
+};
+
+struct stats {
+    unsigned long   nout, fail, fragfail, lost;
+    unsigned long   scans, nmalloc;
+    double          nfree, largest;     /* sums at each swapout */
+};
+
+static struct event *trace;
+static int nevent;
+static size_t nblocks = 1024;
+static int nslots = 25;
+static int nerrors;
+
+static int *shadow;                     /* owner of a block, -1 free */
+static size_t where [MAXPROC][3];       /* swap addresses, 0 if in core */
+static size_t sizes [MAXPROC][3];
+static struct stats st;
+
+static unsigned
+rnd (unsigned long *seed, unsigned n)
+{
+    *seed = *seed * 1103515245 + 12345;
+    return (*seed >> 16) % n;
+}
+
+static void
+error (const char *what)
+{
+    if (nerrors++ < 10)
+        printf ("FAIL: %s\n", what);
+}
+
+/*
+ * Allocate size units; first or best fit.
+ */
+static size_t
+malloc_map (struct map *mp, size_t size)
+{
+    struct mapent *bp, *best = 0;
+    size_t addr;
+
+    st.nmalloc++;
+    for (bp = mp->m_map; bp->m_size; ++bp) {
+        st.scans++;
+        if (bp->m_size < size)
+            continue;
+        if (! mp->bestfit) {
+            best = bp;
+            break;
+        }
+        if (! best || bp->m_size < best->m_size)
+            best = bp;
+    }
+    if (! best)
+        return 0;
+    bp = best;
+    addr = bp->m_addr;
+    bp->m_addr += size;
+    if ((bp->m_size -= size) == 0) {
+        do {
+            bp++;
+            (bp-1)->m_addr = bp->m_addr;
+        } while (((bp-1)->m_size = bp->m_size));
+    }
+    return addr;
+}
+
+/*
+ * Free size units at addr; returns the units discarded.
+ */
+static size_t
+mfree (struct map *mp, size_t size, size_t addr)
+{
+    struct mapent *bp, *ep;
+    struct mapent t;
+
+    if (size == 0)
+        return 0;
+    for (bp = mp->m_map; bp->m_size && bp->m_addr <= addr; ++bp)
+        continue;
+    if (bp > mp->m_map && (bp-1)->m_addr + (bp-1)->m_size == addr) {
+        (bp-1)->m_size += size;
+        if (bp->m_size && addr + size == bp->m_addr) {
+            (bp-1)->m_size += bp->m_size;
+            while (bp->m_size) {
+                bp++;
+                (bp-1)->m_addr = bp->m_addr;
+                (bp-1)->m_size = bp->m_size;
+            }
+        }
+        return 0;
+    }
+    if (bp->m_size && addr + size == bp->m_addr) {
+        bp->m_addr -= size;
+        bp->m_size += size;
+        return 0;
+    }
+    for (ep = bp; ep->m_size; ep++)
+        continue;
+    if (ep >= mp->m_limit)
+        return size;
+    t.m_addr = addr;
+    t.m_size = size;
+    for (; bp <= ep; bp++) {
+        struct mapent tmp = *bp;
+
+        *bp = t;
+        t = tmp;
+    }
+    return 0;
+}
+
+/*
+ * Allocate the three segments of a process, or none.
+ */
+static int
+malloc3 (struct map *mp, size_t size[3], size_t addr[3])
+{
+    struct mapent save [MAXPROC + 1];
+    int order [3] = { 0, 1, 2 }, i, j, t;
+
+    memcpy (save, mp->m_map, (mp->m_limit - mp->m_map + 1) * sizeof *save);
+    if (mp->bestfit) {
+        for (i=0; i<2; i++)
+            for (j=i+1; j<3; j++)
+                if (size[order[j]] > size[order[i]]) {
+                    t = order[i];
+                    order[i] = order[j];
+                    order[j] = t;
+                }
+    }
+    for (i=0; i<3; i++) {
+        addr[order[i]] = malloc_map (mp, size[order[i]]);
+        if (addr[order[i]] == 0) {
+            memcpy (mp->m_map, save,
+                (mp->m_limit - mp->m_map + 1) * sizeof *save);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+ * The map must describe exactly the free blocks of the shadow.
+ */
+static void
+check (struct map *mp)
+{
+    struct mapent *bp;
+    size_t a, infree = 0, nfree = 0, prev = 0;
+
+    for (bp = mp->m_map; bp->m_size; bp++) {
+        if (bp >= mp->m_limit) {
+            error ("map overruns its slots");
+            return;
+        }
+        if (bp->m_addr <= prev) {
+            error ("segments sorted and merged");
+            return;
+        }
+        for (a=bp->m_addr; a<bp->m_addr+bp->m_size; a++)
+            if (a > nblocks || shadow[a] != -1) {
+                error ("free segment covers used blocks");
+                return;
+            }
+        prev = bp->m_addr + bp->m_size;
+        infree += bp->m_size;
+    }
+    for (a=1; a<=nblocks; a++)
+        if (shadow[a] == -1)
+            nfree++;
+    if (nfree != infree)
+        error ("every free block in the map");
+}
+
+static void
+mark (size_t addr, size_t size, int owner, int expect)
+{
+    size_t a;
+
+    for (a=addr; a<addr+size; a++) {
+        if (shadow[a] != expect)
+            error ("blocks owned as expected");
+        shadow[a] = owner;
+    }
+}
+
+static void
+replay (int bestfit)
+{
+    struct mapent *slots;
+    struct map m;
+    struct mapent *bp;
+    struct event *e;
+    size_t addr[3], lost, total, largest, avail;
+    int i, k;
+
+    slots = calloc (nslots + 1, sizeof *slots);
+    m.m_map = slots;
+    m.m_limit = &slots[nslots];
+    m.bestfit = bestfit;
+    memset (&st, 0, sizeof st);
+    memset (where, 0, sizeof where);
+    for (i=0; i<=nblocks; i++)
+        shadow[i] = -2;
+    slots[0].m_addr = 1;
+    slots[0].m_size = nblocks;
+    mark (1, nblocks, -1, -2);
+
+    for (i=0; i<nevent; i++) {
+        e = &trace[i];
+        if (e->op == 'o') {
+            avail = largest = k = 0;
+            for (bp = m.m_map; bp->m_size; bp++, k++) {
+                avail += bp->m_size;
+                if (bp->m_size > largest)
+                    largest = bp->m_size;
+            }
+            st.nout++;
+            st.nfree += k;
+            st.largest += avail ? (double) largest / avail : 1;
+            total = e->size[0] + e->size[1] + e->size[2];
+            if (! malloc3 (&m, e->size, addr)) {
+                st.fail++;
+                if (total <= avail)
+                    st.fragfail++;
+                continue;
+            }
+            for (k=0; k<3; k++) {
+                where[e->pid][k] = addr[k];
+                sizes[e->pid][k] = e->size[k];
+                mark (addr[k], e->size[k], e->pid, -1);
+            }
+        } else {
+            if (where[e->pid][0] == 0)
+                continue;
+            for (k=0; k<3; k++) {
+                lost = mfree (&m, sizes[e->pid][k], where[e->pid][k]);
+                mark (where[e->pid][k], sizes[e->pid][k],
+                    lost ? -2 : -1, e->pid);
+                st.lost += lost;
+                where[e->pid][k] = 0;
+            }
+        }
+        check (&m);
+    }
+    free (slots);
+}
+
+/*
+ * Generate a trace: one process in core, the others swapped.
+ */
+static void
+generate (int nproc, int n, unsigned long seed)
+{
+    static size_t dsize [MAXPROC], ssize [MAXPROC];
+    static int alive [MAXPROC], out [MAXPROC];
+    struct event *e;
+    size_t used = 0;
+    int cur = 0, next, i, r, c;
+
+    for (i=0; i<nproc; i++) {
+        dsize[i] = 4 + rnd (&seed, 60);
+        ssize[i] = 2 + rnd (&seed, 7);
+        alive[i] = 1;
+        out[i] = 0;
+    }
+
+    /* All but process 0 start on swap. */
+    nevent = 0;
+    for (i=1; i<nproc; i++) {
+        if (used + dsize[i] + ssize[i] + USIZE > nblocks) {
+            alive[i] = 0;
+            continue;
+        }
+        e = &trace[nevent++];
+        e->op = 'o';
+        e->pid = i;
+        e->size[0] = dsize[i];
+        e->size[1] = ssize[i];
+        e->size[2] = USIZE;
+        used += dsize[i] + ssize[i] + USIZE;
+        out[i] = 1;
+    }
+    while (nevent < n - 2) {
+        if (alive[cur]) {
+            /* The running process changes size. */
+            r = rnd (&seed, 10);
+            if (r < 3)
+                dsize[cur] = 4 + rnd (&seed, 60);
+            else if (r < 4)
+                ssize[cur] = 2 + rnd (&seed, 7);
+
+            /* Sometimes it exits, or forks a child onto swap. */
+            r = rnd (&seed, 20);
+            if (r == 0) {
+                alive[cur] = 0;
+            } else if (r == 1) {
+                for (c=0; c<nproc && alive[c]; c++)
+                    continue;
+                if (c < nproc &&
+                    used + dsize[cur] + ssize[cur] + USIZE <= nblocks) {
+                    e = &trace[nevent++];
+                    e->op = 'o';
+                    e->pid = c;
+                    e->size[0] = dsize[c] = dsize[cur];
+                    e->size[1] = ssize[c] = ssize[cur];
+                    e->size[2] = USIZE;
+                    used += dsize[c] + ssize[c] + USIZE;
+                    alive[c] = out[c] = 1;
+                }
+            }
+        }
+
+        /* Pick another process. */
+        next = -1;
+        for (i=0; i<8 && next < 0; i++) {
+            c = rnd (&seed, nproc);
+            if (c != cur && alive[c] && out[c])
+                next = c;
+        }
+        if (next < 0) {
+            if (! alive[cur]) {
+                /* Nothing left to run: start a new program. */
+                alive[cur] = 1;
+                dsize[cur] = 4 + rnd (&seed, 60);
+                ssize[cur] = 2 + rnd (&seed, 7);
+            }
+            continue;
+        }
+
+        /* Swap the current one out, unless the swap area is full. */
+        if (alive[cur]) {
+            if (used + dsize[cur] + ssize[cur] + USIZE > nblocks)
+                continue;
+            e = &trace[nevent++];
+            e->op = 'o';
+            e->pid = cur;
+            e->size[0] = dsize[cur];
+            e->size[1] = ssize[cur];
+            e->size[2] = USIZE;
+            used += dsize[cur] + ssize[cur] + USIZE;
+            out[cur] = 1;
+        }
+        e = &trace[nevent++];
+        e->op = 'i';
+        e->pid = next;
+        used -= dsize[next] + ssize[next] + USIZE;
+        out[next] = 0;
+        cur = next;
+    }
+}
+
+static int
+readtrace (const char *name)
+{
+    FILE *f = fopen (name, "r");
+    struct event *e;
+    char line [128];
+    unsigned long d, s, u;
+    int pid;
+
+    if (! f) {
+        perror (name);
+        return -1;
+    }
+    nevent = 0;
+    while (nevent < MAXEVENT && fgets (line, sizeof line, f)) {
+        e = &trace[nevent];
+        if (sscanf (line, "o %d %lu %lu %lu", &pid, &d, &s, &u) == 4) {
+            e->op = 'o';
+            e->size[0] = d;
+            e->size[1] = s;
+            e->size[2] = u;
+        } else if (sscanf (line, "i %d", &pid) == 1) {
+            e->op = 'i';
+        } else
+            continue;
+        if (pid < 0 || pid >= MAXPROC || d + s + u > nblocks) {
+            fprintf (stderr, "%s: bad line: %s", name, line);
+            fclose (f);
+            return -1;
+        }
+        e->pid = pid;
+        nevent++;
+    }
+    fclose (f);
+    return 0;
+}
+
+static void
+writetrace (const char *name)
+{
+    FILE *f = fopen (name, "w");
+    struct event *e;
+    int i;
+
+    if (! f) {
+        perror (name);
+        exit (1);
+    }
+    for (i=0; i<nevent; i++) {
+        e = &trace[i];
+        if (e->op == 'o')
+            fprintf (f, "o %d %lu %lu %lu\n", e->pid,
+                (unsigned long) e->size[0], (unsigned long) e->size[1],
+                (unsigned long) e->size[2]);
+        else
+            fprintf (f, "i %d\n", e->pid);
+    }
+    fclose (f);
+}
+
+int
+main (int argc, char **argv)
+{
+    static const char *name[] = { "first fit:", "best fit:" };
+    const char *rfile = 0, *wfile = 0;
+    unsigned long seed = 1;
+    int opt, n = 100000, nproc = 20, k;
+
+    while ((opt = getopt (argc, argv, "n:p:b:m:s:w:r:")) != -1) {
+        switch (opt) {
+        case 'n':
+            n = strtoul (optarg, 0, 0);
+            break;
+        case 'p':
+            nproc = strtoul (optarg, 0, 0);
+            break;
+        case 'b':
+            nblocks = strtoul (optarg, 0, 0);
+            break;
+        case 'm':
+            nslots = strtoul (optarg, 0, 0);
+            break;
+        case 's':
+            seed = strtoul (optarg, 0, 0);
+            break;
+        case 'w':
+            wfile = optarg;
+            break;
+        case 'r':
+            rfile = optarg;
+            break;
+        default:
+usage:      fprintf (stderr, "Usage: mapsim [-n events] [-p procs] "
+                "[-b blocks] [-m slots]\n"
+                "              [-s seed] [-w trace] [-r trace]\n");
+            return 1;
+        }
+    }
+    if (n < 1 || n > MAXEVENT || nproc < 2 || nproc > MAXPROC ||
+        nslots < 2 || nslots > MAXPROC || nblocks < 100)
+        goto usage;
+    trace = calloc (MAXEVENT, sizeof *trace);
+    shadow = calloc (nblocks + 1, sizeof *shadow);
+
+    if (rfile) {
+        if (readtrace (rfile) < 0)
+            return 1;
+    } else {
+        generate (nproc, n, seed);
+    }
+    if (wfile)
+        writetrace (wfile);
+
+    printf ("%d events, %lu blocks of swap, %d map slots:\n",
+        nevent, (unsigned long) nblocks, nslots);
+    for (k=0; k<2; k++) {
+        replay (k);
+        printf ("%-11s %lu of %lu swapouts failed, %lu with enough "
+            "space free; %lu blocks lost\n", name[k], st.fail, st.nout,
+            st.fragfail, st.lost);
+        printf ("            %.1f free segments, largest %.0f%% "
+            "of free space, %.1f segments scanned per malloc\n",
+            st.nfree / st.nout, 100 * st.largest / st.nout,
+            (double) st.scans / st.nmalloc);
+    }
+    if (nerrors) {
+        printf ("%d checks failed\n", nerrors);
+        return 1;
+    }
+    printf ("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,410 @@
+/*
+ * Host model of a shell pipeline: the inode pipe on pipedev against
+ * an in-memory ring.
+ *
+ * The kernel implements a pipe as an inode on pipedev.  A write goes
+ * through rwip(): bmap(), then getblk() for a whole block or bread()
+ * for a partial one, a copy into the buffer, and bdwrite().  The file
+ * grows to MAXPIPSIZ, 4 blocks, before the writer sleeps.  The reader
+ * takes the blocks back with bread(), and when it has caught up with
+ * the writer both offsets go back to 0, so the same 4 blocks are used
+ * again.  They stay in the buffer cache unless other file i/o pushes
+ * them out; a dirty pipe block is then written to the card, and read
+ * back when the reader gets to it.  The SD card driver polls SPI, so
+ * that time is taken from the processor.  With a ring, write() copies
+ * into a PIPSIZ byte buffer and read() copies out of it, each in at
+ * most two spans.  It uses no buffers, but the writer sleeps after
+ * every PIPSIZ bytes instead of after 4 Kbytes, so there are more
+ * context switches.
+ *
+ * The pipeline is cat of a file into a reader, with 1 Kbyte reads
+ * and writes.  Another process reads other files through the same
+ * NBUF buffers, some blocks for each Kbyte through the pipe.  The
+ * reader checks every byte and the end of file.  The model counts
+ * the operations per Kbyte and converts them into processor cycles
+ * with the costs below, assumptions for an 80 MHz PIC32.  Reading
+ * the file which cat copies costs the same with either pipe, and is
+ * left out.
+ *
+ * Usage: pipesim [-n kbytes] [-b ring size]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define SYSCALL_CYCLES  600     /* read() or write() */
+#define SWITCH_CYCLES   500     /* wakeup() and swtch() */
+#define BMAP_CYCLES     100     /* bmap() of a pipe block */
+#define GETBLK_CYCLES   150     /* hash lookup and lru in getblk() */
+#define CALL_CYCLES     20      /* bcopy() or uiomove() call */
+#define BYTE_CYCLES     0.5     /* copy per byte, word moves */
+#define DISK_CYCLES     40000   /* SD block over 20 MHz SPI, polled */
+
+#define NBUF            10
+#define BSIZE           1024
+#define MAXPIPSIZ       (4 * BSIZE)
+#define IOSIZE          1024
+#define MAXRING         4096
+
+#define MIN(a, b)       ((a) < (b) ? (a) : (b))
+
+enum { FILEDEV, PIPEDEV, OTHERDEV };
+enum { INODE, RING };
+
+struct buf {
+    int             b_dev;
+    long            b_blkno;
+    int             b_valid;
+    int             b_dirty;
+    unsigned long   b_lru;
+    unsigned char   b_data [BSIZE];
+};
+
+/*
+ * Either kind of pipe, and the two processes using it.
+ */
+struct pipe {
+    long            size, roff;     /* inode pipe */
+    unsigned        head, tail;     /* ring, free running */
+    int             ringsize;
+    unsigned char   ring [MAXRING];
+    int             rwait, wwait;
+    int             wclosed;
+};
+
+/*
+ * Operations done, for the cost.
+ */
+struct ops {
+    unsigned long   syscalls, switches, bmap, getblk, calls, bytes;
+    unsigned long   pipeio, fileio, otherio;
+};
+
+static struct buf buf [NBUF];
+static unsigned long lru;
+static unsigned char pipedisk [4][BSIZE];
+static struct pipe pp;                  /* the pipe */
+static struct ops ops;
+static int nerrors;
+
+static void
+expect (int cond, const char *what)
+{
+    if (! cond) {
+        printf ("FAIL: %s\n", what);
+        nerrors++;
+    }
+}
+
+static unsigned char
+pattern (int dev, long off)
+{
+    return (off * 7 + (off >> 10) + dev * 101) & 0xff;
+}
+
+static void
+copy (void *to, const void *from, int n)
+{
+    ops.calls++;
+    ops.bytes += n;
+    memcpy (to, from, n);
+}
+
+/*
+ * The buffer cache, with a disk behind it.
+ */
+static void
+diskio (struct buf *bp, int write)
+{
+    int i;
+
+    if (bp->b_dev == PIPEDEV) {
+        ops.pipeio++;
+        if (write)
+            memcpy (pipedisk[bp->b_blkno], bp->b_data, BSIZE);
+        else
+            memcpy (bp->b_data, pipedisk[bp->b_blkno], BSIZE);
+        return;
+    }
+    if (bp->b_dev == FILEDEV)
+        ops.fileio++;
+    else
+        ops.otherio++;
+    for (i=0; i<BSIZE; i++)
+        bp->b_data[i] = pattern (bp->b_dev, bp->b_blkno * BSIZE + i);
+}
+
+static struct buf *
+getblk (int dev, long blkno)
+{
+    struct buf *bp, *old = &buf[0];
+
+    ops.getblk++;
+    for (bp=buf; bp<buf+NBUF; bp++) {
+        if (bp->b_valid && bp->b_dev == dev && bp->b_blkno == blkno) {
+            bp->b_lru = ++lru;
+            return bp;
+        }
+        if (bp->b_lru < old->b_lru)
+            old = bp;
+    }
+    bp = old;
+    if (bp->b_valid && bp->b_dirty)
+        diskio (bp, 1);
+    bp->b_dev = dev;
+    bp->b_blkno = blkno;
+    bp->b_valid = 0;
+    bp->b_dirty = 0;
+    bp->b_lru = ++lru;
+    return bp;
+}
+
+static struct buf *
+bread (int dev, long blkno)
+{
+    struct buf *bp = getblk (dev, blkno);
+
+    if (! bp->b_valid) {
+        diskio (bp, 0);
+        bp->b_valid = 1;
+    }
+    return bp;
+}
+
+/*
+ * Inode pipe: the data goes through rwip() on pipedev.
+ */
+static int
+iwrite (const unsigned char *data, int n)
+{
+    struct buf *bp;
+    int done = 0, on, c;
+
+    while (done < n && pp.size < MAXPIPSIZ) {
+        ops.bmap++;
+        on = pp.size % BSIZE;
+        c = MIN (BSIZE - on, n - done);
+        c = MIN (c, MAXPIPSIZ - pp.size);
+        if (c == BSIZE) {
+            bp = getblk (PIPEDEV, pp.size / BSIZE);
+            bp->b_valid = 1;
+        } else
+            bp = bread (PIPEDEV, pp.size / BSIZE);
+        copy (bp->b_data + on, data + done, c);
+        bp->b_dirty = 1;
+        pp.size += c;
+        done += c;
+    }
+    return done;
+}
+
+static int
+iread (unsigned char *data, int n)
+{
+    struct buf *bp;
+    int done = 0, on, c;
+
+    if (pp.roff == pp.size && pp.size > 0) {
+        pp.size = pp.roff = 0;
+        return 0;
+    }
+    while (done < n && pp.roff < pp.size) {
+        ops.bmap++;
+        on = pp.roff % BSIZE;
+        c = MIN (BSIZE - on, n - done);
+        c = MIN (c, pp.size - pp.roff);
+        bp = bread (PIPEDEV, pp.roff / BSIZE);
+        copy (data + done, bp->b_data + on, c);
+        pp.roff += c;
+        done += c;
+    }
+    return done;
+}
+
+/*
+ * Ring pipe.  A write of at most the ring size is atomic.
+ */
+static int
+rwrite (const unsigned char *data, int n)
+{
+    unsigned space = pp.ringsize - (pp.head - pp.tail);
+    unsigned at = pp.head % pp.ringsize;
+    int c;
+
+    if (n <= pp.ringsize && space < (unsigned) n)
+        return 0;
+    n = MIN ((unsigned) n, space);
+    c = MIN (n, pp.ringsize - at);
+    copy (pp.ring + at, data, c);
+    if (c < n)
+        copy (pp.ring, data + c, n - c);
+    pp.head += n;
+    return n;
+}
+
+static int
+rread (unsigned char *data, int n)
+{
+    unsigned at = pp.tail % pp.ringsize;
+    int c;
+
+    n = MIN ((unsigned) n, pp.head - pp.tail);
+    if (n == 0)
+        return 0;
+    c = MIN (n, pp.ringsize - at);
+    copy (data, pp.ring + at, c);
+    if (c < n)
+        copy (data + c, pp.ring, n - c);
+    pp.tail += n;
+    return n;
+}
+
+static double
+transfer (int mode, long total, int ringsize, int load)
+{
+    unsigned char wbuf [IOSIZE], rbuf [IOSIZE];
+    struct buf *bp;
+    long woff = 0, roff = 0, other = 0;
+    int wpend = 0, wdone = 0, n, i, cur = 0, eof = 0, bad = 0;
+    int running [2] = { 1, 1 };
+
+    memset (buf, 0, sizeof buf);
+    memset (&pp, 0, sizeof pp);
+    memset (&ops, 0, sizeof ops);
+    lru = 0;
+    pp.ringsize = ringsize;
+
+    while (! eof) {
+        if (cur == 0 && running[0]) {
+            /* cat: fill the buffer from the file, write it. */
+            if (wpend == 0) {
+                if (woff >= total) {
+                    pp.wclosed = 1;
+                    pp.rwait = 0;
+                    running[0] = 0;
+                    running[1] = 1;
+                    continue;
+                }
+                ops.syscalls++;
+                bp = bread (FILEDEV, woff / BSIZE);
+                copy (wbuf, bp->b_data, IOSIZE);
+                for (i=0; i<load; i++)
+                    bread (OTHERDEV, other++);
+                wpend = IOSIZE;
+                wdone = 0;
+                ops.syscalls++;
+            }
+            n = (mode == INODE ? iwrite : rwrite) (wbuf + wdone,
+                wpend - wdone);
+            wdone += n;
+            woff += n;
+            if (n > 0 && pp.rwait) {
+                pp.rwait = 0;
+                running[1] = 1;
+            }
+            if (wdone == wpend)
+                wpend = 0;
+            else {
+                pp.wwait = 1;
+                running[0] = 0;
+            }
+        } else if (cur == 1 && running[1]) {
+            /* The reader. */
+            ops.syscalls++;
+            n = (mode == INODE ? iread : rread) (rbuf, IOSIZE);
+            if (n == 0 && mode == INODE && pp.size == 0 &&
+                ! pp.wclosed && pp.wwait) {
+                /* The offsets went back to 0: let the writer on. */
+                pp.wwait = 0;
+                running[0] = 1;
+            }
+            if (n == 0) {
+                if (pp.wclosed && (mode == RING ?
+                    pp.head == pp.tail : pp.roff == pp.size)) {
+                    eof = 1;
+                    continue;
+                }
+                ops.syscalls--;
+                if (mode == INODE && pp.size == 0 && ! pp.wclosed) {
+                    pp.rwait = 1;
+                    running[1] = 0;
+                } else if (mode == RING) {
+                    pp.rwait = 1;
+                    running[1] = 0;
+                }
+                continue;
+            }
+            for (i=0; i<n; i++)
+                if (rbuf[i] != pattern (FILEDEV, roff + i))
+                    bad++;
+            roff += n;
+            if (mode == RING && pp.wwait) {
+                pp.wwait = 0;
+                running[0] = 1;
+            }
+        }
+        if (! running[cur]) {
+            if (! running[! cur]) {
+                printf ("FAIL: both processes asleep\n");
+                nerrors++;
+                break;
+            }
+            cur = ! cur;
+            ops.switches++;
+        }
+    }
+    expect (bad == 0, "the reader gets the file");
+    expect (roff == total, "the reader gets all of it, then end of file");
+    return ops.syscalls * (double) SYSCALL_CYCLES +
+        ops.switches * (double) SWITCH_CYCLES +
+        ops.bmap * (double) BMAP_CYCLES +
+        ops.getblk * (double) GETBLK_CYCLES +
+        ops.calls * (double) CALL_CYCLES +
+        ops.bytes * BYTE_CYCLES +
+        ops.pipeio * (double) DISK_CYCLES;
+}
+
+int
+main (int argc, char **argv)
+{
+    static const int loads[] = { 0, 1, 2, 4, 8 };
+    long total = 1024 * 1024;
+    int opt, ringsize = 512, k, kb;
+    double c;
+
+    while ((opt = getopt (argc, argv, "n:b:")) != -1) {
+        switch (opt) {
+        case 'n':
+            total = strtoul (optarg, 0, 0) * 1024;
+            break;
+        case 'b':
+            ringsize = strtoul (optarg, 0, 0);
+            break;
+        default:
+usage:      fprintf (stderr, "Usage: pipesim [-n kbytes] [-b ring size]\n");
+            return 1;
+        }
+    }
+    if (total < IOSIZE || ringsize < 64 || ringsize > MAXRING)
+        goto usage;
+    kb = total / 1024;
+
+    printf ("%d kbytes through cat | reader, %d byte ring, "
+        "per kbyte:\n", kb, ringsize);
+    for (k=0; k<5; k++) {
+        c = transfer (INODE, total, ringsize, loads[k]);
+        printf ("%d other blocks: inode %6.0f cycles, %4.2f switches, "
+            "%4.2f pipedev i/o;", loads[k], c / kb,
+            (double) ops.switches / kb, (double) ops.pipeio / kb);
+        c = transfer (RING, total, ringsize, loads[k]);
+        printf (" ring %6.0f, %4.2f\n", c / kb,
+            (double) ops.switches / kb);
+    }
+    if (nerrors) {
+        printf ("%d checks failed\n", nerrors);
+        return 1;
+    }
+    printf ("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,356 @@
+/*
+ * Host model of partial swap: writing back only the data chunks a
+ * process changed since its last swapin, and choosing the process
+ * with the fewest changed chunks to swap out.
+ *
+ * The kernel moves the whole image on every swap: the data area,
+ * the stack and the u area.  With partial swap the swap copy of a
+ * process stays allocated after swapin, and a checksum of each
+ * SWCHUNK of the data area is kept.  Swapout writes the chunks whose
+ * checksum changed, and always the stack and the u area; swapin
+ * still reads the whole image, since core was given to others.  The
+ * model runs the same workload three ways: whole images with the
+ * process which ran least recently swapped out, partial swap with
+ * the same choice, and partial swap taking the resident process with
+ * the fewest changed chunks.  Counting those costs a checksum pass
+ * over each candidate, which is reported.
+ *
+ * Processes have 8-64 Kbytes of data area, of which the program text
+ * loaded at exec is a third to two thirds and is never stored to.
+ * They keep most of their stores in a hot region of an eighth of the
+ * rest.  Each run stores a few hundred random bytes, some of them the
+ * value already there.  Core for
+ * user processes is smaller than all of them together.  Every
+ * process keeps the contents it should have, and after each swapout
+ * the swap copy is compared with it, so a change the checksum
+ * missed would be found.  The model also counts the changed chunks
+ * a 16 bit sum of words would have missed.
+ *
+ * Usage: pswapsim [-p procs] [-m core kbytes] [-n switches] [-s seed]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdint.h>
+
+#define SWCHUNK         2048
+#define SSIZE           4096            /* stack */
+#define USIZE           3072
+#define MAXPROC         32
+#define MAXCHUNK        (64 * 1024 / SWCHUNK)
+
+enum { WHOLE, PARTIAL, DIRTY };
+
+struct proc {
+    int             dsize;
+    unsigned char   *core;              /* contents of the data area */
+    unsigned char   *swap;              /* swap copy, or 0 */
+    uint32_t        sum [MAXCHUNK];     /* checksums at swapin */
+    uint16_t        sum16 [MAXCHUNK];
+    int             resident;
+    long            lastrun;
+    int             tsize;              /* text, never stored to */
+    int             hot, nhot;          /* hot region, in bytes */
+    unsigned long   seed;
+};
+
+struct stats {
+    unsigned long   nswitch, nout, nin;
+    double          written, read, summed;
+    unsigned long   missed16;
+};
+
+static struct proc proc [MAXPROC];
+static int nproc = 8;
+static long corelimit = 96 * 1024;
+static long coreused;
+static struct stats st;
+static int nerrors;
+
+static unsigned
+rnd (unsigned long *seed, unsigned n)
+{
+    *seed = *seed * 1103515245 + 12345;
+    return (*seed >> 16) % n;
+}
+
+static long
+imagesize (struct proc *p)
+{
+    return p->dsize + SSIZE + USIZE;
+}
+
+/*
+ * CRC-32 of a chunk, and the 16 bit sum of its words.
+ */
+static uint32_t crctab [256];
+
+static void
+crcinit ()
+{
+    uint32_t c;
+    int i, k;
+
+    for (i=0; i<256; i++) {
+        c = i;
+        for (k=0; k<8; k++)
+            c = (c >> 1) ^ (0xEDB88320 & - (c & 1));
+        crctab[i] = c;
+    }
+}
+
+static uint32_t
+crc32 (const unsigned char *p, int n)
+{
+    uint32_t crc = ~0;
+
+    while (n-- > 0)
+        crc = crctab[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+static uint16_t
+sum16 (const unsigned char *p, int n)
+{
+    uint16_t s = 0;
+    int i;
+
+    for (i=0; i+1<n; i+=2)
+        s += p[i] | p[i+1] << 8;
+    return s;
+}
+
+static int
+nchunks (struct proc *p)
+{
+    return (p->dsize + SWCHUNK - 1) / SWCHUNK;
+}
+
+static int
+chunklen (struct proc *p, int k)
+{
+    int n = p->dsize - k * SWCHUNK;
+
+    return n < SWCHUNK ? n : SWCHUNK;
+}
+
+/*
+ * Changed chunks of a resident process, by checksum.
+ */
+static int
+ndirty (struct proc *p)
+{
+    int k, n = 0;
+
+    if (! p->swap)
+        return nchunks (p);
+    for (k=0; k<nchunks (p); k++) {
+        st.summed += chunklen (p, k);
+        if (crc32 (p->core + k * SWCHUNK, chunklen (p, k)) != p->sum[k])
+            n++;
+    }
+    return n;
+}
+
+static void
+swapout (struct proc *p, int mode)
+{
+    unsigned char *c;
+    int k, len;
+
+    st.nout++;
+    if (mode == WHOLE || ! p->swap) {
+        if (! p->swap)
+            p->swap = malloc (p->dsize);
+        memcpy (p->swap, p->core, p->dsize);
+        st.written += imagesize (p);
+    } else {
+        for (k=0; k<nchunks (p); k++) {
+            c = p->core + k * SWCHUNK;
+            len = chunklen (p, k);
+            st.summed += len;
+            if (crc32 (c, len) == p->sum[k])
+                continue;
+            if (sum16 (c, len) == p->sum16[k])
+                st.missed16++;
+            memcpy (p->swap + k * SWCHUNK, c, len);
+            st.written += len;
+        }
+        st.written += SSIZE + USIZE;
+    }
+    if (memcmp (p->swap, p->core, p->dsize) != 0) {
+        printf ("FAIL: swap copy differs from the process\n");
+        nerrors++;
+    }
+    p->resident = 0;
+    coreused -= imagesize (p);
+}
+
+static void
+swapin (struct proc *p, int mode)
+{
+    int k;
+
+    st.nin++;
+    st.read += imagesize (p);
+    if (mode != WHOLE) {
+        for (k=0; k<nchunks (p); k++) {
+            st.summed += chunklen (p, k);
+            p->sum[k] = crc32 (p->core + k * SWCHUNK, chunklen (p, k));
+            p->sum16[k] = sum16 (p->core + k * SWCHUNK, chunklen (p, k));
+        }
+    } else {
+        /* The swap space is given back at swapin. */
+        free (p->swap);
+        p->swap = 0;
+    }
+    p->resident = 1;
+    coreused += imagesize (p);
+}
+
+/*
+ * Make room for p, then bring it in.
+ */
+static void
+makeroom (struct proc *p, int mode)
+{
+    struct proc *q, *victim;
+    int i, d, best;
+
+    while (coreused + imagesize (p) > corelimit) {
+        victim = 0;
+        best = 0;
+        for (i=0; i<nproc; i++) {
+            q = &proc[i];
+            if (! q->resident || q == p)
+                continue;
+            if (mode == DIRTY) {
+                d = ndirty (q);
+                if (! victim || d < best ||
+                    (d == best && q->lastrun < victim->lastrun)) {
+                    victim = q;
+                    best = d;
+                }
+            } else if (! victim || q->lastrun < victim->lastrun)
+                victim = q;
+        }
+        swapout (victim, mode);
+    }
+    swapin (p, mode);
+}
+
+/*
+ * The process stores into its data area.
+ */
+static void
+run (struct proc *p, long now)
+{
+    int n, i, a;
+
+    p->lastrun = now;
+    n = 100 + rnd (&p->seed, 400);
+    for (i=0; i<n; i++) {
+        if (rnd (&p->seed, 10) < 9)
+            a = p->hot + rnd (&p->seed, p->nhot);
+        else
+            a = p->tsize + rnd (&p->seed, p->dsize - p->tsize);
+        if (rnd (&p->seed, 4) == 0)
+            p->core[a] = p->core[a];        /* same value again */
+        else
+            p->core[a] = rnd (&p->seed, 256);
+    }
+}
+
+static void
+simulate (int mode, long nswitch, unsigned long seed)
+{
+    struct proc *p, *cur = 0;
+    unsigned long wseed = seed;
+    long t;
+    int i;
+
+    memset (&st, 0, sizeof st);
+    coreused = 0;
+    for (i=0; i<nproc; i++) {
+        p = &proc[i];
+        free (p->core);
+        free (p->swap);
+        memset (p, 0, sizeof *p);
+        p->seed = seed + i * 7919;
+        p->dsize = 8192 + rnd (&p->seed, 57) * 1024;
+        p->core = malloc (p->dsize);
+        for (t=0; t<p->dsize; t++)
+            p->core[t] = (t & 3) ? rnd (&p->seed, 16) : 0;
+        p->tsize = p->dsize / 3 + rnd (&p->seed, p->dsize / 3);
+        p->nhot = (p->dsize - p->tsize) / 8;
+        p->hot = p->tsize + rnd (&p->seed, p->dsize - p->tsize - p->nhot);
+    }
+
+    for (t=0; st.nswitch<nswitch; t++) {
+        /* Some processes run more often than others. */
+        do
+            p = &proc[rnd (&wseed, nproc)];
+        while (rnd (&wseed, 3) > (p - proc) % 3);
+        if (p != cur)
+            st.nswitch++;
+        if (! p->resident)
+            makeroom (p, mode);
+        run (p, t);
+        cur = p;
+    }
+}
+
+int
+main (int argc, char **argv)
+{
+    static const char *name[] = {
+        "whole image:", "partial, lru:", "partial, dirty:"
+    };
+    unsigned long seed = 1;
+    long nswitch = 20000;
+    int opt, mode;
+
+    while ((opt = getopt (argc, argv, "p:m:n:s:")) != -1) {
+        switch (opt) {
+        case 'p':
+            nproc = strtoul (optarg, 0, 0);
+            break;
+        case 'm':
+            corelimit = strtoul (optarg, 0, 0) * 1024;
+            break;
+        case 'n':
+            nswitch = strtoul (optarg, 0, 0);
+            break;
+        case 's':
+            seed = strtoul (optarg, 0, 0);
+            break;
+        default:
+usage:      fprintf (stderr, "Usage: pswapsim [-p procs] [-m core kbytes] "
+                "[-n switches] [-s seed]\n");
+            return 1;
+        }
+    }
+    if (nproc < 2 || nproc > MAXPROC || nswitch < 1 ||
+        corelimit < 64 * 1024 + SSIZE + USIZE)
+        goto usage;
+
+    crcinit ();
+    printf ("%d processes, %ld kbytes of core, %ld context switches:\n",
+        nproc, corelimit / 1024, nswitch);
+    for (mode=WHOLE; mode<=DIRTY; mode++) {
+        simulate (mode, nswitch, seed);
+        printf ("%-16s %6.0f bytes written, %6.0f read per switch, "
+            "%.2f swapouts;\n", name[mode], st.written / st.nswitch,
+            st.read / st.nswitch, (double) st.nout / st.nswitch);
+        printf ("                 %6.0f bytes checksummed per switch, "
+            "%lu chunks a 16 bit sum missed\n",
+            st.summed / st.nswitch, st.missed16);
+    }
+    if (nerrors) {
+        printf ("%d checks failed\n", nerrors);
+        return 1;
+    }
+    printf ("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,526 @@
+/*
+ * Host model of the process scheduler: one run queue scanned by
+ * swtch() against run queues indexed by a priority bitmap.
+ *
+ * The kernel keeps runnable processes on the single qs list:
+ * setrq() pushes at the head, swtch() walks the whole list for the
+ * lowest p_pri, and schedcpu() visits every process once a second.
+ * The bitmap scheme keeps NQS lists of PPQ priorities each and a
+ * whichqs word with a bit per non-empty list: setrq() appends to the
+ * list of the priority, swtch() takes the head of the first non-empty
+ * list, and schedcpu() walks only the processes which are runnable or
+ * have slept for at most a second.  It leaves p_cpu of the longer
+ * sleepers alone anyway, and setrun() clears their p_slptime.
+ *
+ * Both schemes run the same process table and the same workload in
+ * simulated clock ticks: hardclock() charges the running process,
+ * roundrobin() asks for a switch every HZ/10 ticks, a woken process
+ * preempts a lower priority one, and schedcpu() decays p_cpu once a
+ * second.  The workload is a trace drawn from a seeded generator:
+ * CPU-bound processes, and interactive ones which run for a few
+ * ticks and sleep at TTIPRI.  The model counts the process entries
+ * each operation touches and converts them into processor time with
+ * the costs below, assumptions for an 80 MHz PIC32.  It checks that
+ * every switch picks a process from the highest non-empty priority
+ * band and that CPU-bound processes share the processor.
+ *
+ * Usage: schedsim [-n nproc] [-i interactive] [-t seconds] [-s seed]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+#define HZ              200
+#define PUSER           50
+#define TTIPRI          28
+#define MAXPROC         64
+
+#define NQS             32              /* run queues */
+#define PPQ             (128 / NQS)     /* priorities per queue */
+#define PQUEUE(pri)     ((pri) < 0 ? 0 : (pri) / PPQ)
+
+#define SSLEEP          1
+#define SRUN            3
+
+#define SWTCH_USEC      12.0    /* save and restore a context */
+#define VISIT_USEC      0.15    /* load, compare, follow p_link */
+#define DECAY_USEC      0.5     /* decay p_cpu, setpri */
+
+/*
+ * The scheduling fields of struct proc, and the workload.
+ */
+struct proc {
+    struct proc     *p_link;        /* run queue */
+    int             p_stat;
+    char            p_pri;
+    unsigned char   p_cpu;
+    char            p_nice;
+    unsigned char   p_slptime;
+    short           p_pid;
+
+    struct proc     *p_actlink;     /* schedcpu list, bitmap scheme */
+    int             p_active;
+
+    int             interactive;
+    int             burst;          /* ticks left before sleeping */
+    long            wake_tick;
+    long            woken;          /* tick of the wakeup, or -1 */
+    unsigned long   ticks;          /* ticks run */
+};
+
+struct stats {
+    unsigned long   nswtch;
+    unsigned long   swtch_visits;
+    unsigned long   swtch_max;
+    unsigned long   rq_visits;      /* setrq, remrq */
+    unsigned long   cpu_visits;     /* schedcpu */
+    unsigned long   nwake;
+    unsigned long   lat [64];       /* wakeup to run, in ticks */
+};
+
+static struct proc proc [MAXPROC];
+static struct proc *curproc;
+static struct stats st;
+static int nproc = 25, ninteractive = 5, bitmap;
+static long now;
+static int runrun, nerrors;
+static unsigned long seed = 1;
+
+/* The single list. */
+static struct proc *qs;
+
+/* The bitmap scheme. */
+static struct proc *bq [NQS], *bqtail [NQS];
+static unsigned long whichqs;
+static struct proc *actlist;
+
+static unsigned
+rnd (unsigned n)
+{
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 16) % n;
+}
+
+static void
+setrq (struct proc *p)
+{
+    int q;
+
+    st.rq_visits++;
+    if (! bitmap) {
+        p->p_link = qs;
+        qs = p;
+        return;
+    }
+    q = PQUEUE (p->p_pri);
+    p->p_link = 0;
+    if (bq[q])
+        bqtail[q]->p_link = p;
+    else
+        bq[q] = p;
+    bqtail[q] = p;
+    whichqs |= 1UL << q;
+}
+
+static void
+remrq (struct proc *p)
+{
+    struct proc **pp, *prev = 0;
+    int q = 0;
+
+    if (bitmap) {
+        q = PQUEUE (p->p_pri);
+        pp = &bq[q];
+    } else {
+        pp = &qs;
+    }
+    for (; *pp; prev = *pp, pp = &(*pp)->p_link) {
+        st.rq_visits++;
+        if (*pp == p)
+            break;
+    }
+    if (! *pp) {
+        printf ("remrq: process %d not on its queue\n", p->p_pid);
+        nerrors++;
+        return;
+    }
+    *pp = p->p_link;
+    if (bitmap) {
+        if (bqtail[q] == p)
+            bqtail[q] = prev;
+        if (! bq[q])
+            whichqs &= ~(1UL << q);
+    }
+}
+
+static int
+on_runq (struct proc *p)
+{
+    return p->p_stat == SRUN && p != curproc;
+}
+
+/*
+ * Set the user priority from p_cpu and p_nice.  A queued process
+ * of the bitmap scheme moves to the list of its new priority.
+ */
+static void
+setpri (struct proc *p)
+{
+    int pri = PUSER + p->p_cpu / 16 + p->p_nice;
+
+    if (pri > 127)
+        pri = 127;
+    if (bitmap && on_runq (p) && PQUEUE (pri) != PQUEUE (p->p_pri)) {
+        remrq (p);
+        p->p_pri = pri;
+        setrq (p);
+        return;
+    }
+    p->p_pri = pri;
+}
+
+/*
+ * Take the next process off the run queue.
+ */
+static struct proc *
+pick ()
+{
+    struct proc *p, **pp, **best = 0;
+    unsigned long visits = 0;
+    int q;
+
+    if (bitmap) {
+        if (! whichqs)
+            return 0;
+        q = ffsl (whichqs) - 1;
+        p = bq[q];
+        bq[q] = p->p_link;
+        if (! bq[q]) {
+            bqtail[q] = 0;
+            whichqs &= ~(1UL << q);
+        }
+        visits = 1;
+    } else {
+        for (pp=&qs; *pp; pp=&(*pp)->p_link) {
+            visits++;
+            if (! best || (*pp)->p_pri < (*best)->p_pri)
+                best = pp;
+        }
+        if (! best)
+            return 0;
+        p = *best;
+        *best = p->p_link;
+    }
+    st.swtch_visits += visits;
+    if (visits > st.swtch_max)
+        st.swtch_max = visits;
+    return p;
+}
+
+/*
+ * Check the choice against every runnable process.
+ */
+static void
+check_pick (struct proc *p)
+{
+    int i, best = 127;
+
+    for (i=0; i<nproc; i++)
+        if (on_runq (&proc[i]) && proc[i].p_pri < best)
+            best = proc[i].p_pri;
+    if (PQUEUE (p->p_pri) > PQUEUE (best)) {
+        printf ("swtch picked priority %d with %d runnable\n",
+            p->p_pri, best);
+        nerrors++;
+    }
+}
+
+static void
+swtch ()
+{
+    struct proc *p;
+
+    if (curproc && curproc->p_stat == SRUN)
+        setrq (curproc);
+    curproc = 0;
+    p = pick ();
+    runrun = 0;
+    st.nswtch++;
+    if (! p)
+        return;
+    check_pick (p);
+    curproc = p;
+    if (p->woken >= 0) {
+        unsigned long t = now - p->woken;
+
+        st.lat[t < 63 ? t : 63]++;
+        p->woken = -1;
+    }
+}
+
+static void
+activate (struct proc *p)
+{
+    if (p->p_active)
+        return;
+    p->p_active = 1;
+    p->p_actlink = actlist;
+    actlist = p;
+}
+
+static void
+decay (struct proc *p)
+{
+    int a = p->p_cpu * 8 / 10 + p->p_nice;
+
+    p->p_cpu = (a < 0) ? 0 : (a > 255) ? 255 : a;
+    if (p->p_pri >= PUSER)
+        setpri (p);
+}
+
+/*
+ * Once a second.
+ */
+static void
+schedcpu ()
+{
+    struct proc *p, **pp;
+    int i;
+
+    if (! bitmap) {
+        for (i=0; i<nproc; i++) {
+            p = &proc[i];
+            st.cpu_visits++;
+            if (p->p_stat == SSLEEP && p->p_slptime != 127)
+                p->p_slptime++;
+            if (p->p_slptime > 1)
+                continue;
+            decay (p);
+        }
+        return;
+    }
+    for (pp=&actlist; (p = *pp); ) {
+        st.cpu_visits++;
+        if (p->p_stat == SSLEEP && ++p->p_slptime > 1) {
+            /* Dropped until it wakes up. */
+            *pp = p->p_actlink;
+            p->p_active = 0;
+            continue;
+        }
+        decay (p);
+        pp = &p->p_actlink;
+    }
+}
+
+static void
+go_sleep (struct proc *p)
+{
+    p->p_stat = SSLEEP;
+    p->p_pri = TTIPRI;
+    p->p_slptime = 0;
+    if (p->interactive == 1)
+        p->wake_tick = now + (10 + rnd (90)) * HZ / 1000;
+    else
+        p->wake_tick = now + (1000 + rnd (9000)) * HZ / 1000;
+    runrun = 1;
+}
+
+static void
+setrun (struct proc *p)
+{
+    p->p_stat = SRUN;
+    p->p_slptime = 0;
+    p->woken = now;
+    p->burst = 1 + rnd (3);
+    st.nwake++;
+    if (bitmap)
+        activate (p);
+    setrq (p);
+    if (! curproc || p->p_pri < curproc->p_pri)
+        runrun = 1;
+}
+
+static void
+reset ()
+{
+    struct proc *p;
+    int i;
+
+    memset (proc, 0, sizeof proc);
+    memset (&st, 0, sizeof st);
+    qs = 0;
+    memset (bq, 0, sizeof bq);
+    memset (bqtail, 0, sizeof bqtail);
+    whichqs = 0;
+    actlist = 0;
+    curproc = 0;
+    runrun = 0;
+    now = 0;
+
+    for (i=0; i<nproc; i++) {
+        p = &proc[i];
+        p->p_pid = i + 1;
+        p->p_pri = PUSER;
+        p->woken = -1;
+        if (i < ninteractive)
+            p->interactive = 1;
+        p->p_stat = SRUN;
+        if (bitmap)
+            activate (p);
+        setrq (p);
+    }
+}
+
+/*
+ * Run the workload for the given number of ticks.
+ */
+static void
+run (long nticks, unsigned long s, int ndaemons)
+{
+    struct proc *p;
+    int i;
+
+    seed = s;
+    reset ();
+    for (i=0; i<ndaemons; i++) {
+        p = &proc[nproc - 1 - i];
+        p->interactive = 2;
+        remrq (p);
+        p->p_stat = SSLEEP;
+        p->wake_tick = rnd (10 * HZ);
+    }
+    swtch ();
+
+    for (now=1; now<nticks; now++) {
+        /* Wakeups: the interrupt returns through swtch() if needed. */
+        for (i=0; i<nproc; i++)
+            if (proc[i].p_stat == SSLEEP && proc[i].wake_tick <= now)
+                setrun (&proc[i]);
+        if (runrun)
+            swtch ();
+
+        /* hardclock */
+        p = curproc;
+        if (p) {
+            p->ticks++;
+            if (p->p_cpu != 255)
+                p->p_cpu++;
+            if (p->p_pri < PUSER || (p->p_cpu & 3) == 0)
+                setpri (p);
+            if (p->interactive && --p->burst <= 0)
+                go_sleep (p);
+        }
+        if (now % (HZ / 10) == 0)
+            runrun = 1;
+        if (now % HZ == 0)
+            schedcpu ();
+        if (runrun || ! curproc)
+            swtch ();
+    }
+}
+
+static void
+report (const char *name, double seconds)
+{
+    unsigned long n = 0, i, p50 = 0, p99 = 0;
+    double swtch_usec, rq_usec, cpu_usec;
+
+    for (i=0; i<64; i++) {
+        n += st.lat[i];
+        if (! p50 && n * 2 >= st.nwake)
+            p50 = i;
+        if (! p99 && n * 100 >= st.nwake * 99)
+            p99 = i;
+    }
+    swtch_usec = SWTCH_USEC + VISIT_USEC * st.swtch_visits / st.nswtch;
+    rq_usec = VISIT_USEC * st.rq_visits / seconds;
+    cpu_usec = DECAY_USEC * st.cpu_visits / seconds;
+    printf ("%-8s swtch %.1f entries (max %lu), %.2f us; "
+        "schedcpu %.0f entries/s; run queue %.2f ms/s\n",
+        name, (double) st.swtch_visits / st.nswtch, st.swtch_max,
+        swtch_usec, st.cpu_visits / seconds,
+        (st.nswtch * (swtch_usec - SWTCH_USEC) + rq_usec + cpu_usec) / 1000);
+    printf ("%-8s %lu switches, %lu wakeups, wakeup to run "
+        "p50 %lu ms, p99 %lu ms\n", "", st.nswtch, st.nwake,
+        p50 * 1000 / HZ, p99 * 1000 / HZ);
+}
+
+/*
+ * CPU-bound processes must get about the same share.
+ */
+static void
+check_share (int first, int last)
+{
+    unsigned long lo = ~0UL, hi = 0;
+    int i;
+
+    for (i=first; i<last; i++) {
+        if (proc[i].ticks < lo)
+            lo = proc[i].ticks;
+        if (proc[i].ticks > hi)
+            hi = proc[i].ticks;
+    }
+    if (last > first && lo < hi * 3 / 4) {
+        printf ("CPU-bound processes got %lu to %lu ticks\n", lo, hi);
+        nerrors++;
+    }
+}
+
+int
+main (int argc, char **argv)
+{
+    double seconds = 60;
+    unsigned long s = 1;
+    int opt, ndaemons;
+
+    while ((opt = getopt (argc, argv, "n:i:t:s:")) != -1) {
+        switch (opt) {
+        case 'n':
+            nproc = strtoul (optarg, 0, 0);
+            break;
+        case 'i':
+            ninteractive = strtoul (optarg, 0, 0);
+            break;
+        case 't':
+            seconds = atof (optarg);
+            break;
+        case 's':
+            s = strtoul (optarg, 0, 0);
+            break;
+        default:
+usage:      fprintf (stderr, "Usage: schedsim [-n nproc] [-i interactive] "
+                "[-t seconds] [-s seed]\n");
+            return 1;
+        }
+    }
+    if (nproc < 1 || nproc > MAXPROC || ninteractive > nproc)
+        goto usage;
+
+    /* All busy: CPU-bound and interactive processes. */
+    printf ("%d processes, %d CPU-bound, %d interactive:\n",
+        nproc, nproc - ninteractive, ninteractive);
+    for (bitmap=0; bitmap<2; bitmap++) {
+        run (seconds * HZ, s, 0);
+        report (bitmap ? "bitmap:" : "list:", seconds);
+        check_share (ninteractive, nproc);
+    }
+
+    /* Mostly sleeping daemons. */
+    ndaemons = nproc - ninteractive - 5;
+    if (ndaemons > 0) {
+        printf ("%d processes, 5 CPU-bound, %d interactive, "
+            "%d daemons:\n", nproc, ninteractive, ndaemons);
+        for (bitmap=0; bitmap<2; bitmap++) {
+            run (seconds * HZ, s, ndaemons);
+            report (bitmap ? "bitmap:" : "list:", seconds);
+            check_share (ninteractive, ninteractive + 5);
+        }
+    }
+    if (nerrors) {
+        printf ("%d errors\n", nerrors);
+        return 1;
+    }
+    return 0;
+}
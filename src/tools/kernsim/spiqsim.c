@@ -0,0 +1,288 @@
+/*
+ * Host model of an asynchronous request queue for the SPI bus.
+ *
+ * The spi_bulk_* routines poll the FIFO: the processor is busy for
+ * the whole time the bytes are on the bus.  With a request queue per
+ * bus, the driver sets up a DMA channel for the request at the head
+ * and returns; the DMA interrupt completes the request (calls its
+ * done() hook, or wakes the sleeper as biodone() does) and starts the
+ * next one.  A request submitted behind a queued one for the same
+ * device and direction is merged with it into one chip select cycle
+ * and one DMA run.
+ *
+ * The model runs a disk and a display sharing a 20 MHz bus in
+ * simulated time and measures how much processor time each scheme
+ * spends on the transfers.  The per-operation costs are assumptions
+ * for an 80 MHz PIC32, given below; the bus time follows from the
+ * clock.  The model checks that every request completes once, with
+ * its bytes, and in submission order per device.
+ *
+ * Usage: spiqsim [-t seconds]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define BUS_KHZ         20000
+#define BYTE_USEC       (8000.0 / BUS_KHZ)
+
+#define POLL_CALL_USEC  1.0     /* select, set up the FIFO loop */
+#define SUBMIT_USEC     1.5     /* fill a request, queue it */
+#define DMA_START_USEC  2.0     /* program the channel, select */
+#define DMA_INTR_USEC   3.0     /* interrupt entry, completion, wakeup */
+
+#define SPIREQ_READ     1
+#define SPIREQ_WRITE    2
+
+/*
+ * A request, as the driver would keep it.
+ */
+struct spireq {
+    struct spireq   *next;      /* bus queue link */
+    struct spireq   *merged;    /* requests riding in this one's cycle */
+    int             dev;        /* device */
+    int             op;         /* SPIREQ_READ or WRITE */
+    unsigned        len;        /* length in bytes */
+    unsigned        seq;        /* submission order per device */
+    int             done;       /* completed */
+};
+
+enum { DISK, DISPLAY, NDEV };
+
+static const char *devname [NDEV] = { "disk", "display" };
+
+/*
+ * One bus.
+ */
+struct bus {
+    struct spireq   *head;      /* active request, then the queue */
+    struct spireq   *tail;
+    double          busy_until; /* end of the running DMA, usec */
+
+    double          cpu;        /* processor time spent, usec */
+    double          wire;       /* time with data on the bus, usec */
+    unsigned long   ncycles;    /* select cycles */
+    unsigned long   nmerged;    /* requests merged */
+};
+
+static struct bus bus;
+static unsigned submitted [NDEV], completed [NDEV];
+static unsigned long nbytes [NDEV], ndone_bytes [NDEV];
+static int nerrors;
+
+static void
+complete (struct spireq *rq)
+{
+    if (rq->done || rq->seq != completed[rq->dev]) {
+        printf ("%s request %u completed out of order\n",
+            devname[rq->dev], rq->seq);
+        nerrors++;
+    }
+    rq->done = 1;
+    completed[rq->dev]++;
+    ndone_bytes[rq->dev] += rq->len;
+}
+
+static unsigned
+run_length (struct spireq *rq)
+{
+    unsigned len = 0;
+
+    for (; rq; rq = rq->merged)
+        len += rq->len;
+    return len;
+}
+
+/*
+ * Start the DMA for the request at the head of the queue.
+ */
+static void
+start (double now)
+{
+    unsigned len = run_length (bus.head);
+
+    bus.cpu += DMA_START_USEC;
+    bus.ncycles++;
+    bus.wire += len * BYTE_USEC;
+    bus.busy_until = now + DMA_START_USEC + len * BYTE_USEC;
+}
+
+/*
+ * The DMA interrupt: complete the head and its merged requests,
+ * start the next one.
+ */
+static void
+dmaintr (double now)
+{
+    struct spireq *rq = bus.head, *m, *next;
+
+    bus.cpu += DMA_INTR_USEC;
+    bus.head = rq->next;
+    if (! bus.head)
+        bus.tail = 0;
+    for (m=rq; m; m=next) {
+        next = m->merged;
+        complete (m);
+        free (m);
+    }
+    if (bus.head)
+        start (now);
+}
+
+static void
+submit (double now, int dev, int op, unsigned len)
+{
+    struct spireq *rq, *t;
+
+    rq = calloc (1, sizeof *rq);
+    rq->dev = dev;
+    rq->op = op;
+    rq->len = len;
+    rq->seq = submitted[dev]++;
+    nbytes[dev] += len;
+    bus.cpu += SUBMIT_USEC;
+
+    /* Merge with the last queued request, unless it is running. */
+    t = bus.tail;
+    if (t && t != bus.head && t->dev == dev && t->op == op) {
+        while (t->merged)
+            t = t->merged;
+        t->merged = rq;
+        bus.nmerged++;
+        return;
+    }
+    if (bus.tail)
+        bus.tail->next = rq;
+    else
+        bus.head = rq;
+    bus.tail = rq;
+    if (bus.head == rq)
+        start (now);
+}
+
+/*
+ * The polled driver: every call selects the chip and
+ * the processor moves the bytes.
+ */
+static double poll_free;
+
+static void
+poll_call (double now, int dev, int op, unsigned len)
+{
+    double begin = (now > poll_free) ? now : poll_free;
+
+    bus.cpu += POLL_CALL_USEC + len * BYTE_USEC;
+    bus.wire += len * BYTE_USEC;
+    bus.ncycles++;
+    poll_free = begin + POLL_CALL_USEC + len * BYTE_USEC;
+    submitted[dev]++;
+    completed[dev]++;
+    nbytes[dev] += len;
+    ndone_bytes[dev] += len;
+}
+
+/*
+ * Workload: the file system reads 8 consecutive 512-byte blocks every
+ * 10 ms and writes one block every 50 ms; the display is refreshed at
+ * 30 frames per second as 16 bands of 320x8 pixels at 2 bits each.
+ */
+struct event {
+    double  when;
+    double  period;
+    int     dev, op;
+    unsigned len, count;
+};
+
+static struct event workload [] = {
+    { 0,     10000, DISK,    SPIREQ_READ,  512, 8 },
+    { 2500,  50000, DISK,    SPIREQ_WRITE, 512, 1 },
+    { 1000,  33333, DISPLAY, SPIREQ_WRITE, 640, 16 },
+};
+
+#define NEVENTS (sizeof workload / sizeof workload[0])
+
+static void
+run (double seconds, int async)
+{
+    struct event ev [NEVENTS];
+    double now, end = seconds * 1e6;
+    unsigned i, k, next;
+
+    memcpy (ev, workload, sizeof ev);
+    memset (&bus, 0, sizeof bus);
+    memset (submitted, 0, sizeof submitted);
+    memset (completed, 0, sizeof completed);
+    memset (nbytes, 0, sizeof nbytes);
+    memset (ndone_bytes, 0, sizeof ndone_bytes);
+    poll_free = 0;
+
+    for (;;) {
+        next = 0;
+        for (i=1; i<NEVENTS; i++)
+            if (ev[i].when < ev[next].when)
+                next = i;
+        now = ev[next].when;
+
+        /* Interrupts which come before the next submission. */
+        while (async && bus.head && bus.busy_until <= now)
+            dmaintr (bus.busy_until);
+        if (now >= end)
+            break;
+
+        for (k=0; k<ev[next].count; k++) {
+            if (async)
+                submit (now, ev[next].dev, ev[next].op, ev[next].len);
+            else
+                poll_call (now, ev[next].dev, ev[next].op, ev[next].len);
+        }
+        ev[next].when += ev[next].period;
+    }
+    while (async && bus.head)
+        dmaintr (bus.busy_until);
+
+    for (i=0; i<NDEV; i++) {
+        if (completed[i] != submitted[i] || ndone_bytes[i] != nbytes[i]) {
+            printf ("%s: %u of %u requests, %lu of %lu bytes done\n",
+                devname[i], completed[i], submitted[i],
+                ndone_bytes[i], nbytes[i]);
+            nerrors++;
+        }
+    }
+}
+
+int
+main (int argc, char **argv)
+{
+    double seconds = 10, polled_cpu = 0;
+    int opt, async;
+
+    while ((opt = getopt (argc, argv, "t:")) != -1) {
+        switch (opt) {
+        case 't':
+            seconds = atof (optarg);
+            break;
+        default:
+            fprintf (stderr, "Usage: spiqsim [-t seconds]\n");
+            return 1;
+        }
+    }
+
+    for (async=0; async<2; async++) {
+        run (seconds, async);
+        if (nerrors)
+            return 1;
+        printf ("%-7s %lu+%lu requests, %lu select cycles, %lu merged, "
+            "bus %.1f%%, cpu %.1f%%\n", async ? "queued:" : "polled:",
+            (unsigned long) submitted[DISK], (unsigned long) submitted[DISPLAY],
+            bus.ncycles, bus.nmerged,
+            100 * bus.wire / (seconds * 1e6),
+            100 * bus.cpu / (seconds * 1e6));
+        if (! async)
+            polled_cpu = bus.cpu;
+    }
+    printf ("released: %.1f%% of the processor time spent on the bus, "
+        "%.0f ms per second\n", 100 * (polled_cpu - bus.cpu) / polled_cpu,
+        (polled_cpu - bus.cpu) / seconds / 1000);
+    return 0;
+}
@@ -0,0 +1,373 @@
+/*
+ * Host model of a scatter-gather transaction for the SPI driver.
+ *
+ * The stock /dev/spi interface takes one ioctl per transfer, and
+ * every SPICTL_IO* call selects the chip, moves the words and
+ * releases the chip again.  Settings of the bus (select pin, rate,
+ * mode) are kept per port, so when two devices share a port each
+ * access needs SETSELPIN and SETRATE first, and a command followed
+ * by data of a different word size must be sent as bytes, because
+ * select cannot be held between two calls.
+ *
+ * The transaction call takes an array of segments (tx and rx
+ * buffers, length, word width, optional clock rate, and whether
+ * select is released after the segment) and runs them all in one
+ * kernel entry, as the driver would on top of spi_bulk_rw() and
+ * spi_bulk_rw_32_be().
+ *
+ * The bus is a loopback: what goes out on MOSI comes back on MISO.
+ * The model checks that every segment receives what it sent, in the
+ * right byte order, that select is asserted and released where the
+ * segments ask for it, and that bad transactions are refused.  Then
+ * it counts kernel entries, select cycles and FIFO words for a
+ * sensor and a flash chip sharing the bus.
+ *
+ * Usage: spisim [-n iterations]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+/*
+ * The interface as it would appear in <sys/spi.h>.
+ */
+struct spi_segment {
+    const void      *tx;        /* data to send, or 0 to send ones */
+    void            *rx;        /* received data, or 0 to discard */
+    unsigned short  len;        /* length in words */
+    unsigned char   width;      /* word size: 8, 16, 32 */
+    unsigned char   flags;      /* see below */
+    unsigned int    rate;       /* clock rate, kHz, or 0 to keep */
+};
+
+#define SPISEG_CSREL        0x01        /* release select after segment */
+#define SPISEG_BE           0x02        /* 32-bit words are big endian */
+
+#define SPI_MAXSEG          16          /* segments per transaction */
+
+/*
+ * Loopback port.
+ */
+struct port {
+    unsigned        selpin;     /* SETSELPIN */
+    unsigned        rate;       /* SETRATE, kHz */
+    int             selected;   /* select asserted */
+
+    unsigned long   nentries;   /* kernel entries */
+    unsigned long   ncycles;    /* select cycles */
+    unsigned long   nwords;     /* words through the FIFO */
+    double          usec;       /* time of the clock on the bus */
+};
+
+static struct port port;
+
+static void
+select_chip (struct port *p)
+{
+    if (! p->selected) {
+        p->selected = 1;
+        p->ncycles++;
+    }
+}
+
+static void
+deselect_chip (struct port *p)
+{
+    p->selected = 0;
+}
+
+/*
+ * Move len words of the given width.  The buffers are in memory
+ * order; 32-bit words go out most significant byte first when
+ * big endian, least significant first otherwise, the way
+ * spi_bulk_rw_32_be() and spi_bulk_rw_32() load the FIFO.
+ */
+static void
+bulk_rw (struct port *p, unsigned width, int be, unsigned len,
+    const unsigned char *tx, unsigned char *rx)
+{
+    unsigned char word [4], wire [4];
+    unsigned i, k, nbytes = width / 8;
+
+    for (i=0; i<len; i++) {
+        if (tx)
+            memcpy (word, tx + i*nbytes, nbytes);
+        else
+            memset (word, 0xff, nbytes);
+
+        /* Bytes in the order they are clocked out. */
+        for (k=0; k<nbytes; k++)
+            wire[k] = (nbytes == 1 || be) ? word[k] : word[nbytes - 1 - k];
+
+        /* Loopback: MISO shifts in what MOSI shifted out. */
+        for (k=0; k<nbytes; k++)
+            word[(nbytes == 1 || be) ? k : nbytes - 1 - k] = wire[k];
+
+        if (rx)
+            memcpy (rx + i*nbytes, word, nbytes);
+        p->nwords++;
+    }
+    p->usec += 1000.0 * len * width / p->rate;
+}
+
+/*
+ * The stock ioctls.
+ */
+static void
+spi_setselpin (struct port *p, unsigned pin)
+{
+    p->nentries++;
+    p->selpin = pin;
+}
+
+static void
+spi_setrate (struct port *p, unsigned khz)
+{
+    p->nentries++;
+    p->rate = khz;
+}
+
+static void
+spi_io8 (struct port *p, unsigned char *data, unsigned n)
+{
+    p->nentries++;
+    select_chip (p);
+    bulk_rw (p, 8, 0, n, data, data);
+    deselect_chip (p);
+}
+
+/*
+ * SPICTL_TRANSACT.  The whole list is checked before the bus
+ * is touched, so a bad segment leaves the device alone.
+ */
+static int
+spi_transact (struct port *p, struct spi_segment *seg, unsigned nseg)
+{
+    unsigned i;
+
+    p->nentries++;
+    if (nseg == 0 || nseg > SPI_MAXSEG)
+        return EINVAL;
+    for (i=0; i<nseg; i++) {
+        if (seg[i].width != 8 && seg[i].width != 16 && seg[i].width != 32)
+            return EINVAL;
+        if (seg[i].len == 0)
+            return EINVAL;
+    }
+    for (i=0; i<nseg; i++) {
+        if (seg[i].rate)
+            p->rate = seg[i].rate;
+        select_chip (p);
+        bulk_rw (p, seg[i].width, seg[i].flags & SPISEG_BE, seg[i].len,
+            seg[i].tx, seg[i].rx);
+        if ((seg[i].flags & SPISEG_CSREL) || i == nseg - 1)
+            deselect_chip (p);
+    }
+    return 0;
+}
+
+static int nfailed;
+
+static void
+expect (int cond, const char *what)
+{
+    if (! cond) {
+        printf ("FAIL: %s\n", what);
+        nfailed++;
+    }
+}
+
+/*
+ * Checks of the transaction on the loopback.
+ */
+static void
+test (void)
+{
+    struct spi_segment seg [SPI_MAXSEG + 1];
+    unsigned char cmd [4] = { 0x0b, 0x12, 0x34, 0x56 };
+    unsigned char out [64], in [64], ones [8];
+    unsigned i;
+
+    for (i=0; i<sizeof out; i++)
+        out[i] = i * 7 + 1;
+
+    /* Mixed widths in one select cycle. */
+    memset (&port, 0, sizeof port);
+    port.rate = 1000;
+    memset (seg, 0, sizeof seg);
+    memset (in, 0, sizeof in);
+    seg[0].tx = cmd;
+    seg[0].rx = in;
+    seg[0].len = 4;
+    seg[0].width = 8;
+    seg[1].tx = out;
+    seg[1].rx = in + 4;
+    seg[1].len = 8;
+    seg[1].width = 32;
+    seg[1].flags = SPISEG_BE;
+    seg[1].rate = 20000;
+    seg[2].tx = out + 32;
+    seg[2].rx = in + 36;
+    seg[2].len = 4;
+    seg[2].width = 16;
+    expect (spi_transact (&port, seg, 3) == 0, "three segments accepted");
+    expect (memcmp (in, cmd, 4) == 0, "8-bit segment loops back");
+    expect (memcmp (in + 4, out, 32) == 0, "32-bit BE segment loops back");
+    expect (memcmp (in + 36, out + 32, 8) == 0, "16-bit segment loops back");
+    expect (port.ncycles == 1, "one select cycle for held segments");
+    expect (! port.selected, "select released after the last segment");
+    expect (port.rate == 20000, "segment rate applied");
+    expect (port.nwords == 16, "words counted at their width");
+
+    /* Release in the middle. */
+    memset (&port, 0, sizeof port);
+    port.rate = 1000;
+    seg[0].flags = SPISEG_CSREL;
+    expect (spi_transact (&port, seg, 3) == 0, "release flag accepted");
+    expect (port.ncycles == 2, "select released and asserted again");
+    seg[0].flags = 0;
+
+    /* No tx buffer sends ones; no rx buffer discards. */
+    memset (in, 0, sizeof in);
+    memset (ones, 0xff, sizeof ones);
+    seg[0].tx = 0;
+    seg[0].rx = in;
+    seg[0].len = 8;
+    seg[0].width = 8;
+    seg[1].rx = 0;
+    expect (spi_transact (&port, seg, 2) == 0, "null buffers accepted");
+    expect (memcmp (in, ones, 8) == 0, "no tx buffer sends ones");
+
+    /* Bad transactions leave the bus alone. */
+    memset (&port, 0, sizeof port);
+    port.rate = 1000;
+    seg[0].tx = cmd;
+    seg[0].len = 4;
+    seg[1].width = 12;
+    expect (spi_transact (&port, seg, 2) == EINVAL, "bad width refused");
+    seg[1].width = 32;
+    seg[1].len = 0;
+    expect (spi_transact (&port, seg, 2) == EINVAL, "empty segment refused");
+    seg[1].len = 8;
+    expect (spi_transact (&port, seg, 0) == EINVAL, "empty list refused");
+    expect (spi_transact (&port, seg, SPI_MAXSEG + 1) == EINVAL,
+        "too many segments refused");
+    expect (port.nwords == 0 && port.ncycles == 0, "bus untouched on error");
+}
+
+/*
+ * Workload: a sensor at 1 MHz read as a command byte and six data
+ * bytes, and a page of 256 bytes read from a flash chip at 20 MHz
+ * with a four byte command.  Both are on the same port.
+ */
+#define SENSOR_PIN  1
+#define FLASH_PIN   2
+#define PAGE        256
+
+static void
+bench_ioctl (unsigned iterations)
+{
+    unsigned char buf [4 + PAGE];
+    unsigned n;
+
+    for (n=0; n<iterations; n++) {
+        spi_setselpin (&port, SENSOR_PIN);
+        spi_setrate (&port, 1000);
+        memset (buf, 0, 7);
+        buf[0] = 0x80 | 0x28;
+        spi_io8 (&port, buf, 7);
+
+        spi_setselpin (&port, FLASH_PIN);
+        spi_setrate (&port, 20000);
+        memset (buf, 0, sizeof buf);
+        buf[0] = 0x03;
+        buf[2] = n;
+        spi_io8 (&port, buf, sizeof buf);
+    }
+}
+
+static void
+bench_transact (unsigned iterations)
+{
+    struct spi_segment seg [2];
+    unsigned char cmd [4], data [PAGE];
+    unsigned n;
+
+    memset (seg, 0, sizeof seg);
+    for (n=0; n<iterations; n++) {
+        spi_setselpin (&port, SENSOR_PIN);
+        cmd[0] = 0x80 | 0x28;
+        seg[0].tx = cmd;
+        seg[0].len = 1;
+        seg[0].width = 8;
+        seg[0].rate = 1000;
+        seg[1].tx = 0;
+        seg[1].rx = data;
+        seg[1].len = 6;
+        seg[1].width = 8;
+        seg[1].flags = 0;
+        spi_transact (&port, seg, 2);
+
+        spi_setselpin (&port, FLASH_PIN);
+        cmd[0] = 0x03;
+        cmd[1] = 0;
+        cmd[2] = n;
+        cmd[3] = 0;
+        seg[0].len = 4;
+        seg[0].rate = 20000;
+        seg[1].len = PAGE / 4;
+        seg[1].width = 32;
+        seg[1].flags = SPISEG_BE;
+        spi_transact (&port, seg, 2);
+    }
+}
+
+int
+main (int argc, char **argv)
+{
+    unsigned long entries, words;
+    unsigned iterations = 10000;
+    int opt, pass;
+
+    while ((opt = getopt (argc, argv, "n:")) != -1) {
+        switch (opt) {
+        case 'n':
+            iterations = strtoul (optarg, 0, 0);
+            break;
+        default:
+            fprintf (stderr, "Usage: spisim [-n iterations]\n");
+            return 1;
+        }
+    }
+
+    test ();
+    if (nfailed) {
+        printf ("%d checks failed\n", nfailed);
+        return 1;
+    }
+    printf ("loopback checks passed\n");
+
+    entries = words = 0;
+    for (pass=0; pass<2; pass++) {
+        memset (&port, 0, sizeof port);
+        port.rate = 1000;
+        if (pass == 0)
+            bench_ioctl (iterations);
+        else
+            bench_transact (iterations);
+        printf ("%-9s %lu kernel entries, %lu select cycles, %lu FIFO words, "
+            "%.0f ms on the bus\n", pass ? "transact:" : "ioctl:",
+            port.nentries, port.ncycles, port.nwords, port.usec / 1000);
+        if (pass == 0) {
+            entries = port.nentries;
+            words = port.nwords;
+        }
+    }
+    printf ("saved:    %.1f%% of the kernel entries, "
+        "%.1f%% of the FIFO words\n",
+        100.0 - 100.0 * port.nentries / entries,
+        100.0 - 100.0 * port.nwords / words);
+    return 0;
+}
@@ -0,0 +1,373 @@
+/*
+ * Host model of the clock: the periodic HZ tick against a tickless
+ * idle mode with one-shot core timer deadlines.
+ *
+ * The kernel takes a clock interrupt every 1/HZ second, busy or idle:
+ * hardclock() advances ticks, charges the running process, runs the
+ * due callouts, and every second schedcpu() and the load average.
+ * A driver which needs a delay shorter than a tick has timeout(),
+ * which runs on the next tick, up to 5 ms late.  In the tickless
+ * mode the tick runs only while a process is running.  When the
+ * processor goes idle, the core timer compare register is set for
+ * the first callout due, and when it wakes, the skipped ticks are
+ * accounted for at once: ticks advances, schedcpu() runs for every
+ * second passed and the load average takes a zero sample for every
+ * sample time passed, since nothing ran.  Drivers get one-shot timers
+ * with the resolution of the core timer, which also wake the idle
+ * processor, and are only delayed by a clock interrupt in progress.
+ *
+ * Both modes run the same workload, drawn from a seeded generator:
+ * daemons which sleep for 1-30 s, interactive processes which sleep
+ * for 50-500 ms, each running 0.2-4 ms when woken, and drivers which
+ * wait for a delay of 0.1-1 ms after activity every 20-100 ms.  The
+ * model checks that both modes end with the same ticks, number of
+ * schedcpu() runs, p_cpu of every process and load average, and that
+ * every process ran at the same time in both.  It counts the clock
+ * interrupts, those which woke an idle processor and the time spent
+ * in them, and the lateness of the driver timers, with the costs
+ * below, assumptions for an 80 MHz PIC32.
+ *
+ * Usage: ticksim [-p procs] [-d drivers] [-t seconds] [-s seed]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+
+#define HZ              200
+#define TICK            (1000000 / HZ)  /* usec per tick */
+#define LOADTICKS       (5 * HZ)        /* load average sample */
+#define MAXPROC         64
+#define MAXDRV          8
+
+#define ENTRY_USEC      1       /* interrupt entry and exit */
+#define HARDCLOCK_USEC  4       /* ticks, time of day, statistics */
+#define CALLOUT_USEC    2       /* run one callout, wakeup() */
+#define SCHEDCPU_USEC   10      /* schedcpu(), plus one per process */
+#define HRTIMER_USEC    3       /* driver routine, program compare */
+
+enum { PERIODIC, TICKLESS };
+
+struct proc {
+    int             daemon;
+    unsigned char   p_cpu;
+    long            due;            /* tick of the timeout */
+    long            start, end;     /* last run, usec */
+    unsigned long   seed;
+    unsigned long   runsum;         /* of the start times */
+};
+
+struct driver {
+    long            due;            /* usec */
+    unsigned long   seed;
+};
+
+struct result {
+    unsigned long   intr;           /* clock interrupts */
+    unsigned long   idlewake;       /* from an idle processor */
+    unsigned long   busy_usec;      /* in clock interrupts */
+    long            ticks;
+    unsigned long   nschedcpu;
+    double          loadav;
+    unsigned long   cpusum, runsum;
+    unsigned long   nlate;
+    double          late_sum, late_max;
+    double          *late;
+};
+
+static struct proc proc [MAXPROC];
+static struct driver drv [MAXDRV];
+static int nproc = 12, ndrv = 2;
+static long nticks;
+static long *tickend;               /* end of the clock handler of tick k */
+static struct result *res;
+static long ticks;
+static int nerrors;
+
+static unsigned
+rnd (unsigned long *seed, unsigned n)
+{
+    *seed = *seed * 1103515245 + 12345;
+    return (*seed >> 16) % n;
+}
+
+static void
+expect (int cond, const char *what)
+{
+    if (! cond) {
+        printf ("FAIL: %s\n", what);
+        nerrors++;
+    }
+}
+
+/*
+ * Is a process running or waiting to run at time t?
+ */
+static int
+nrunnable (long t)
+{
+    int i, n = 0;
+
+    for (i=0; i<nproc; i++)
+        if (proc[i].start <= t && t < proc[i].end)
+            n++;
+        else if (proc[i].start > t)
+            n++;
+    return n;
+}
+
+static long busy_until;
+
+/*
+ * A timeout ran out: the process runs after those queued before it,
+ * then sleeps again.
+ */
+static void
+wake (struct proc *p, long now)
+{
+    long burst = 200 + rnd (&p->seed, 3800);
+
+    p->start = busy_until > now ? busy_until : now;
+    p->end = p->start + burst;
+    busy_until = p->end;
+    p->runsum += p->start;
+    if (p->daemon)
+        p->due = p->end / TICK + HZ + rnd (&p->seed, 29 * HZ);
+    else
+        p->due = p->end / TICK + HZ/20 + rnd (&p->seed, HZ/2 - HZ/20);
+}
+
+static void
+schedcpu ()
+{
+    int i;
+
+    for (i=0; i<nproc; i++)
+        proc[i].p_cpu = proc[i].p_cpu * 2 / 3;
+    res->nschedcpu++;
+}
+
+static void
+loadsample (int n)
+{
+    static const double decay = 0.9200444146293232;    /* exp(-5/60) */
+
+    res->loadav = res->loadav * decay + n * (1 - decay);
+}
+
+/*
+ * Account for ticks skipped while idle, up to and including tick k.
+ */
+static void
+clkskipped (long k)
+{
+    while (ticks < k) {
+        ticks++;
+        if (ticks % HZ == 0)
+            schedcpu ();
+        if (ticks % LOADTICKS == 0)
+            loadsample (0);
+    }
+}
+
+/*
+ * The clock interrupt of tick k.  Returns its duration.
+ */
+static long
+hardclock (long k)
+{
+    long now = k * TICK, cost = ENTRY_USEC + HARDCLOCK_USEC;
+    int i;
+
+    ticks = k;
+    for (i=0; i<nproc; i++)
+        if (proc[i].start <= now && now < proc[i].end)
+            proc[i].p_cpu++;
+    for (i=0; i<nproc; i++)
+        if (proc[i].due == k) {
+            wake (&proc[i], now);
+            cost += CALLOUT_USEC;
+        }
+    if (k % HZ == 0) {
+        schedcpu ();
+        cost += SCHEDCPU_USEC + nproc;
+    }
+    if (k % LOADTICKS == 0)
+        loadsample (nrunnable (now));
+    return cost;
+}
+
+static void
+late (double usec)
+{
+    res->late[res->nlate++] = usec;
+    res->late_sum += usec;
+    if (usec > res->late_max)
+        res->late_max = usec;
+}
+
+/*
+ * Driver timers.  With the periodic clock a delay is a timeout(),
+ * run after hardclock() on the first tick at or after the due time;
+ * tickless, the compare interrupt comes at the due time unless the
+ * clock handler is running.
+ */
+static void
+drivers (int mode)
+{
+    struct driver *d;
+    long fire, k, end = nticks * TICK;
+    int i;
+
+    for (i=0; i<ndrv; i++) {
+        d = &drv[i];
+        d->seed = 7000 + i * 7919;
+        d->due = 20000 + rnd (&d->seed, 80000);
+        while (d->due < end) {
+            if (mode == PERIODIC) {
+                k = (d->due + TICK - 1) / TICK;
+                fire = k * TICK + ENTRY_USEC + HARDCLOCK_USEC;
+            } else {
+                k = d->due / TICK;
+                fire = d->due;
+                if (k < nticks && tickend[k] > fire)
+                    fire = tickend[k];
+                fire += ENTRY_USEC;
+                res->intr++;
+                res->busy_usec += ENTRY_USEC + HRTIMER_USEC;
+                if (nrunnable (d->due) == 0)
+                    res->idlewake++;
+            }
+            late (fire - d->due);
+
+            /* Next activity, and the delay it needs. */
+            d->due = fire + HRTIMER_USEC + 20000 + rnd (&d->seed, 80000);
+            d->due += 100 + rnd (&d->seed, 900);
+        }
+    }
+}
+
+static void
+run (int mode, unsigned long seed, struct result *r)
+{
+    long k, now;
+    int i, busy, due;
+
+    memset (r, 0, sizeof *r);
+    r->late = malloc (sizeof (double) *
+        (ndrv * (nticks * TICK / 20000 + 1) + 1));
+    res = r;
+    ticks = 0;
+    busy_until = 0;
+    for (i=0; i<nproc; i++) {
+        memset (&proc[i], 0, sizeof proc[i]);
+        proc[i].seed = seed + i * 7919;
+        proc[i].daemon = i % 3 != 0;
+        proc[i].due = 1 + rnd (&proc[i].seed, 2 * HZ);
+    }
+
+    for (k=1; k<=nticks; k++) {
+        now = k * TICK;
+        busy = nrunnable (now) > 0;
+        due = 0;
+        for (i=0; i<nproc; i++)
+            if (proc[i].due == k)
+                due = 1;
+        tickend[k] = 0;
+        if (mode == TICKLESS && ! busy && ! due)
+            continue;
+
+        if (mode == TICKLESS)
+            clkskipped (k - 1);
+        tickend[k] = now + hardclock (k);
+        r->intr++;
+        r->busy_usec += tickend[k] - now;
+        if (! busy)
+            r->idlewake++;
+    }
+    if (mode == TICKLESS)
+        clkskipped (nticks);
+    drivers (mode);
+
+    r->ticks = ticks;
+    for (i=0; i<nproc; i++) {
+        r->cpusum = r->cpusum * 31 + proc[i].p_cpu;
+        r->runsum = r->runsum * 31 + proc[i].runsum;
+    }
+}
+
+static int
+compare (const void *a, const void *b)
+{
+    double x = *(const double*) a, y = *(const double*) b;
+
+    return (x > y) - (x < y);
+}
+
+static void
+report (const char *name, struct result *r, double seconds)
+{
+    qsort (r->late, r->nlate, sizeof r->late[0], compare);
+    printf ("%-9s %6.1f clock interrupts/s, %6.1f from idle, "
+        "%.2f ms/s in them\n", name, r->intr / seconds,
+        r->idlewake / seconds, r->busy_usec / seconds / 1000);
+    printf ("          driver delays late by %.1f us mean, "
+        "%.1f us p99, %.1f us max\n", r->late_sum / r->nlate,
+        r->late[r->nlate * 99 / 100], r->late_max);
+}
+
+int
+main (int argc, char **argv)
+{
+    static struct result r [2];
+    unsigned long seed = 1;
+    double seconds = 600;
+    int opt;
+
+    while ((opt = getopt (argc, argv, "p:d:t:s:")) != -1) {
+        switch (opt) {
+        case 'p':
+            nproc = strtoul (optarg, 0, 0);
+            break;
+        case 'd':
+            ndrv = strtoul (optarg, 0, 0);
+            break;
+        case 't':
+            seconds = atof (optarg);
+            break;
+        case 's':
+            seed = strtoul (optarg, 0, 0);
+            break;
+        default:
+usage:      fprintf (stderr, "Usage: ticksim [-p procs] [-d drivers] "
+                "[-t seconds] [-s seed]\n");
+            return 1;
+        }
+    }
+    if (nproc < 1 || nproc > MAXPROC || ndrv < 1 || ndrv > MAXDRV ||
+        seconds < 1)
+        goto usage;
+    nticks = seconds * HZ;
+    tickend = calloc (nticks + 1, sizeof *tickend);
+
+    run (PERIODIC, seed, &r[0]);
+    run (TICKLESS, seed, &r[1]);
+
+    printf ("%d processes, %d drivers, %.0f seconds at HZ = %d:\n",
+        nproc, ndrv, seconds, HZ);
+    report ("periodic:", &r[0], seconds);
+    report ("tickless:", &r[1], seconds);
+
+    expect (r[0].ticks == r[1].ticks, "same ticks");
+    expect (r[0].nschedcpu == r[1].nschedcpu, "same schedcpu() runs");
+    expect (r[0].cpusum == r[1].cpusum, "same p_cpu");
+    expect (fabs (r[0].loadav - r[1].loadav) < 1e-12, "same load average");
+    expect (r[0].runsum == r[1].runsum, "processes ran at the same time");
+    if (nerrors) {
+        printf ("%d checks failed\n", nerrors);
+        return 1;
+    }
+    printf ("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,439 @@
+/*
+ * Host model of a raw tty file transfer: the line discipline path
+ * against a fast path which moves whole uio segments between the
+ * user buffer and the driver.
+ *
+ * In RAW mode the kernel still handles every character on its own.
+ * write() copies the user data to the output clist, where b_to_q()
+ * calls putc() for each character.  The transmit interrupt takes
+ * characters one at a time with getc() and stores each in the UART
+ * FIFO or the USB endpoint buffer.  The receive interrupt calls
+ * ttyinput() for each character, which puts it on the raw queue, and
+ * read() gives it to the user with getc() and ureadc().  putc() and
+ * getc() each mask interrupts.  In the fast path, for RAW without
+ * ECHO, write() copies the uio segment into a transmit ring and
+ * read() copies from a receive ring, with at most two memcpy() calls
+ * each.  The interrupt handlers move the FIFO or the endpoint buffer
+ * to and from the rings the same way.  The rings have a single
+ * producer and a single consumer, so no interrupt masking is needed.
+ *
+ * The device echoes the data: what it sends comes back on its
+ * receive side, through an 8 character UART FIFO or through 64 byte
+ * full speed USB packets.  Every byte read is checked.  The model
+ * counts the operations per byte and converts them into processor
+ * cycles with the costs below, assumptions for an 80 MHz PIC32.  From
+ * that it gives the sustained rate of each link: the link speed, or
+ * less when the processor cannot keep up with both directions.
+ *
+ * Usage: ttysim [-n kbytes] [-w write size]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdint.h>
+
+/* The kernel names clash with stdio. */
+#undef getc
+#undef putc
+#define getc            cgetc
+#define putc            cputc
+
+#define CPU_HZ          80000000.0
+#define INTR_CYCLES     80      /* interrupt entry and exit */
+#define SPL_CYCLES      12      /* spltty() and splx() */
+#define CHAR_CYCLES     25      /* putc() or getc(), less the spl */
+#define INPUT_CYCLES    40      /* ttyinput() in RAW mode, less putc() */
+#define UREADC_CYCLES   30      /* ureadc() */
+#define REG_CYCLES      6       /* FIFO register or endpoint buffer */
+#define CALL_CYCLES     20      /* memcpy() or uiomove() call */
+#define BYTE_CYCLES     0.5     /* memcpy() per byte, word moves */
+#define SYSCALL_CYCLES  600     /* read() or write() */
+
+#define CBLOCK          32
+#define CROUND          (CBLOCK - 1)
+#define NCLIST          32
+#define CBSIZE          (CBLOCK - sizeof (struct cblock *))
+#define QLIMIT          (NCLIST / 2 * CBSIZE)
+#define OBUFSIZ         100
+#define RINGSIZE        512
+#define FIFOSIZE        8
+#define PKTSIZE         64
+
+#define MIN(a, b)       ((a) < (b) ? (a) : (b))
+
+struct cblock {
+    struct cblock   *c_next;
+    char            c_info [CBLOCK - sizeof (struct cblock *)];
+};
+
+struct clist {
+    int             c_cc;
+    char            *c_cf;
+    char            *c_cl;
+};
+
+struct ring {
+    unsigned        head, tail;
+    char            buf [RINGSIZE];
+};
+
+/*
+ * Operations done, for the cost.
+ */
+struct ops {
+    unsigned long   intr, spl, chars, input, ureadc, reg;
+    unsigned long   calls, bytes, syscalls;
+};
+
+static struct cblock cfree [NCLIST] __attribute__ ((aligned (CBLOCK)));
+static struct cblock *cfreelist;
+static int cfreecount;
+static struct ops ops;
+static int nerrors;
+
+static void
+expect (int cond, const char *what)
+{
+    if (! cond) {
+        printf ("FAIL: %s\n", what);
+        nerrors++;
+    }
+}
+
+static void
+cinit ()
+{
+    int i;
+
+    cfreelist = 0;
+    for (i=0; i<NCLIST; i++) {
+        cfree[i].c_next = cfreelist;
+        cfreelist = &cfree[i];
+    }
+    cfreecount = NCLIST * CBSIZE;
+}
+
+static void
+cbfree (struct cblock *bp)
+{
+    bp->c_next = cfreelist;
+    cfreelist = bp;
+    cfreecount += CBSIZE;
+}
+
+static struct cblock *
+cballoc ()
+{
+    struct cblock *bp = cfreelist;
+
+    if (bp) {
+        cfreelist = bp->c_next;
+        cfreecount -= CBSIZE;
+        bp->c_next = 0;
+    }
+    return bp;
+}
+
+static int
+getc (struct clist *p)
+{
+    struct cblock *bp;
+    int c;
+
+    ops.spl++;
+    ops.chars++;
+    if (p->c_cc <= 0) {
+        p->c_cc = 0;
+        p->c_cf = p->c_cl = 0;
+        return -1;
+    }
+    c = *p->c_cf++ & 0377;
+    if (--p->c_cc <= 0) {
+        bp = (struct cblock*) ((uintptr_t) (p->c_cf - 1) & ~CROUND);
+        p->c_cf = p->c_cl = 0;
+        cbfree (bp);
+    } else if (((uintptr_t) p->c_cf & CROUND) == 0) {
+        bp = (struct cblock*) p->c_cf - 1;
+        p->c_cf = bp->c_next->c_info;
+        cbfree (bp);
+    }
+    return c;
+}
+
+static int
+putc (int c, struct clist *p)
+{
+    struct cblock *bp;
+    char *cp;
+
+    ops.spl++;
+    ops.chars++;
+    if ((cp = p->c_cl) == 0) {
+        if ((bp = cballoc ()) == 0)
+            return -1;
+        p->c_cf = cp = bp->c_info;
+    } else if (((uintptr_t) cp & CROUND) == 0) {
+        bp = (struct cblock*) cp - 1;
+        if ((bp->c_next = cballoc ()) == 0)
+            return -1;
+        cp = bp->c_next->c_info;
+    }
+    *cp++ = c;
+    p->c_cc++;
+    p->c_cl = cp;
+    return 0;
+}
+
+static void
+copy (char *to, const char *from, int n)
+{
+    memcpy (to, from, n);
+    ops.calls++;
+    ops.bytes += n;
+}
+
+/*
+ * Ring of the fast path, in at most two spans.
+ */
+static int
+ring_put (struct ring *r, const char *cp, int n)
+{
+    int i = r->head % RINGSIZE, nc;
+
+    n = MIN (n, RINGSIZE - (int) (r->head - r->tail));
+    nc = MIN (n, RINGSIZE - i);
+    copy (r->buf + i, cp, nc);
+    if (n > nc)
+        copy (r->buf, cp + nc, n - nc);
+    r->head += n;
+    return n;
+}
+
+static int
+ring_get (struct ring *r, char *cp, int n)
+{
+    int i = r->tail % RINGSIZE, nc;
+
+    n = MIN (n, (int) (r->head - r->tail));
+    nc = MIN (n, RINGSIZE - i);
+    copy (cp, r->buf + i, nc);
+    if (n > nc)
+        copy (cp + nc, r->buf, n - nc);
+    r->tail += n;
+    return n;
+}
+
+enum { DISC, FAST };
+enum { UART, USB };
+
+static struct clist outq, rawq;
+static struct ring txring, rxring;
+static char wire [PKTSIZE];         /* FIFO or endpoint buffer */
+static int wirelen;
+
+/*
+ * write() of one uio segment; returns the bytes taken.
+ */
+static int
+tty_write (int mode, const char *ubuf, int n)
+{
+    char obuf [OBUFSIZ];
+    int done = 0, cc, i;
+
+    ops.syscalls++;
+    if (mode == FAST)
+        return ring_put (&txring, ubuf, n);
+    while (done < n && outq.c_cc < QLIMIT) {
+        cc = MIN (n - done, OBUFSIZ);
+        cc = MIN (cc, QLIMIT - outq.c_cc);
+        copy (obuf, ubuf + done, cc);               /* uiomove() */
+        for (i=0; i<cc; i++)
+            if (putc (obuf[i] & 0377, &outq) < 0)
+                break;
+        done += i;
+        if (i < cc)
+            break;
+    }
+    return done;
+}
+
+/*
+ * read() into the user buffer; returns the bytes given.
+ */
+static int
+tty_read (int mode, char *ubuf, int n)
+{
+    int i, c;
+
+    ops.syscalls++;
+    if (mode == FAST)
+        return ring_get (&rxring, ubuf, n);
+    for (i=0; i<n && (c = getc (&rawq)) >= 0; i++) {
+        ubuf[i] = c;
+        ops.ureadc++;
+    }
+    return i;
+}
+
+/*
+ * Transmit interrupt: fill the FIFO or the endpoint buffer.
+ */
+static void
+tx_intr (int mode, int size)
+{
+    int c;
+
+    ops.intr++;
+    if (mode == FAST) {
+        wirelen = ring_get (&txring, wire, size);
+        ops.reg += wirelen;
+        return;
+    }
+    for (wirelen=0; wirelen<size && (c = getc (&outq)) >= 0; wirelen++) {
+        wire[wirelen] = c;
+        ops.reg++;
+    }
+}
+
+/*
+ * Receive interrupt: empty the FIFO or the endpoint buffer.
+ * Returns the characters taken.
+ */
+static int
+rx_intr (int mode)
+{
+    int n, room;
+
+    ops.intr++;
+    if (mode == FAST) {
+        n = ring_put (&rxring, wire, wirelen);
+        ops.reg += n;
+    } else {
+        room = QLIMIT - rawq.c_cc;
+        for (n=0; n<wirelen && n<room; n++) {
+            ops.reg++;
+            ops.input++;
+            if (putc (wire[n] & 0377, &rawq) < 0)
+                break;
+        }
+    }
+    memmove (wire, wire + n, wirelen - n);
+    wirelen -= n;
+    return n;
+}
+
+static char
+pattern (unsigned long i)
+{
+    return (i * 131 + (i >> 8)) & 0xFF;
+}
+
+/*
+ * Echo total bytes and return the processor cycles per byte.
+ */
+static double
+transfer (int mode, int link, unsigned long total, int wsize)
+{
+    static char ubuf [65536], rbuf [65536];
+    unsigned long sent = 0, got = 0, i;
+    int n, size = link == UART ? FIFOSIZE : PKTSIZE, bad = 0;
+    double cycles;
+
+    cinit ();
+    memset (&outq, 0, sizeof outq);
+    memset (&rawq, 0, sizeof rawq);
+    memset (&txring, 0, sizeof txring);
+    memset (&rxring, 0, sizeof rxring);
+    memset (&ops, 0, sizeof ops);
+    wirelen = 0;
+
+    while (got < total) {
+        if (sent < total) {
+            n = MIN (wsize, total - sent);
+            for (i=0; i<n; i++)
+                ubuf[i] = pattern (sent + i);
+            sent += tty_write (mode, ubuf, n);
+        }
+        for (;;) {
+            if (wirelen == 0)
+                tx_intr (mode, size);
+            if (wirelen == 0 || rx_intr (mode) == 0)
+                break;
+        }
+        n = tty_read (mode, rbuf, wsize);
+        for (i=0; i<n; i++)
+            if (rbuf[i] != pattern (got + i))
+                bad = 1;
+        got += n;
+    }
+    expect (! bad, "data echoed intact");
+    expect (cfreecount == NCLIST * CBSIZE, "cblocks freed");
+
+    cycles = ops.intr * INTR_CYCLES + ops.spl * SPL_CYCLES +
+        ops.chars * CHAR_CYCLES + ops.input * INPUT_CYCLES +
+        ops.ureadc * UREADC_CYCLES + ops.reg * REG_CYCLES +
+        ops.calls * CALL_CYCLES + ops.bytes * BYTE_CYCLES +
+        ops.syscalls * SYSCALL_CYCLES;
+    return cycles / total;
+}
+
+int
+main (int argc, char **argv)
+{
+    static const struct {
+        const char  *name;
+        int         link;
+        double      rate;           /* bytes per second */
+    } links [] = {
+        { "UART 115200:",   UART,   11520 },
+        { "UART 921600:",   UART,   92160 },
+        { "UART 3000000:",  UART,   300000 },
+        { "USB full speed:", USB,   1216000 },  /* 19 packets a frame */
+    };
+    static const char *name[] = { "line discipline", "fast path" };
+    unsigned long total = 1024 * 1024;
+    double cpb [2][2], cap, rate;
+    int opt, wsize = 1024, mode, k;
+
+    while ((opt = getopt (argc, argv, "n:w:")) != -1) {
+        switch (opt) {
+        case 'n':
+            total = strtoul (optarg, 0, 0) * 1024;
+            break;
+        case 'w':
+            wsize = strtoul (optarg, 0, 0);
+            break;
+        default:
+usage:      fprintf (stderr, "Usage: ttysim [-n kbytes] [-w write size]\n");
+            return 1;
+        }
+    }
+    if (total == 0 || wsize < 1 || wsize > 65536)
+        goto usage;
+
+    printf ("%lu kbytes echoed, %d byte reads and writes:\n",
+        total >> 10, wsize);
+    for (mode=DISC; mode<=FAST; mode++) {
+        cpb[mode][UART] = transfer (mode, UART, total, wsize);
+        cpb[mode][USB] = transfer (mode, USB, total, wsize);
+        printf ("%-16s %6.1f cycles per byte with the UART, "
+            "%6.1f with USB\n", name[mode], cpb[mode][UART], cpb[mode][USB]);
+    }
+    for (k=0; k<4; k++) {
+        printf ("%-16s", links[k].name);
+        for (mode=DISC; mode<=FAST; mode++) {
+            cap = CPU_HZ / cpb[mode][links[k].link];
+            rate = MIN (links[k].rate, cap);
+            printf (" %s %7.1f kbytes/s (%3.0f%% cpu)%s",
+                mode == DISC ? "disc" : "fast", rate / 1000,
+                100 * rate / cap, mode == DISC ? "," : "\n");
+        }
+    }
+    if (nerrors) {
+        printf ("%d checks failed\n", nerrors);
+        return 1;
+    }
+    printf ("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,454 @@
+/*
+ * Host model of compressed swap: process images LZ compressed on
+ * swapout and expanded on swapin.
+ *
+ * The tree has no linked programs, so the images are built from the
+ * MIPS object code of the SDK libraries: the archives given on the
+ * command line are read, and each program takes text, data and bss
+ * from a seeded choice of their members until it reaches its size.
+ * The rest of its data area is heap: left zero, or filled with data
+ * sections of other members, as a heap in use would be.  Then come
+ * a stack whose top 1 Kbyte holds frames of return addresses into
+ * the text and small numbers, and the u area of USIZE bytes.  The
+ * code is not relocated, so its address fields are zero, which
+ * favours the compressor a little.  A process has at most 96 Kbytes
+ * of data, DATA_SIZE less the kernel.
+ *
+ * The compressor is an LZ77 with a hash of three bytes and a window
+ * of 8 Kbytes, in the LZF format.  Each chunk of the image is
+ * compressed on its own, so swapin can expand a chunk as soon as it
+ * is read, and a chunk which does not shrink is stored as it is.
+ * The packed image is rounded up to DEV_BSIZE blocks.  Every image
+ * is expanded again and compared.  The model reports the blocks
+ * written, and the compression and expansion times on the build
+ * machine.
+ *
+ * Usage: zswapsim [-c chunk] [-s seed] archive...
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <time.h>
+
+#define DEV_BSIZE       1024
+#define USIZE           3072
+#define MAXDATA         (96 * 1024)
+#define STACK           (8 * 1024)
+#define MAXIMAGE        (MAXDATA + STACK + USIZE)
+#define MAXMEMB         2048
+
+#define HLOG            12
+#define MAXOFF          8192
+#define MAXLIT          32
+#define MAXREF          (255 + 7)       /* match length - 2 */
+
+/*
+ * Sections of an archive member.
+ */
+struct member {
+    unsigned char   *text, *data;
+    unsigned        ntext, ndata, nbss;
+};
+
+static struct member memb [MAXMEMB];
+static int nmemb;
+static int nerrors;
+
+static unsigned
+rnd (unsigned long *seed, unsigned n)
+{
+    *seed = *seed * 1103515245 + 12345;
+    return (*seed >> 16) % n;
+}
+
+static unsigned
+get16 (const unsigned char *p)
+{
+    return p[0] | p[1] << 8;
+}
+
+static unsigned
+get32 (const unsigned char *p)
+{
+    return p[0] | p[1] << 8 | p[2] << 16 | (unsigned) p[3] << 24;
+}
+
+static unsigned char *
+grow (unsigned char *buf, unsigned *len, const unsigned char *p, unsigned n)
+{
+    buf = realloc (buf, *len + n);
+    memcpy (buf + *len, p, n);
+    *len += n;
+    return buf;
+}
+
+/*
+ * Take the allocated sections of an ELF relocatable object.
+ */
+static void
+elf (const unsigned char *p, unsigned size)
+{
+    struct member *m = &memb[nmemb];
+    const unsigned char *sh;
+    unsigned shoff, shentsize, shnum, i, type, flags, off, n;
+
+    if (size < 52 || memcmp (p, "\177ELF", 4) != 0 || p[4] != 1 ||
+        p[5] != 1 || nmemb >= MAXMEMB)
+        return;
+    shoff = get32 (p + 0x20);
+    shentsize = get16 (p + 0x2e);
+    shnum = get16 (p + 0x30);
+    memset (m, 0, sizeof *m);
+    for (i=0; i<shnum; i++) {
+        sh = p + shoff + i * shentsize;
+        if (sh + 40 > p + size)
+            return;
+        type = get32 (sh + 4);
+        flags = get32 (sh + 8);
+        off = get32 (sh + 16);
+        n = get32 (sh + 20);
+        if (! (flags & 2))                  /* SHF_ALLOC */
+            continue;
+        if (type == 8) {                    /* SHT_NOBITS */
+            m->nbss += n;
+            continue;
+        }
+        if (type != 1 || off + n > size)    /* SHT_PROGBITS */
+            continue;
+        if (flags & 4)                      /* SHF_EXECINSTR */
+            m->text = grow (m->text, &m->ntext, p + off, n);
+        else
+            m->data = grow (m->data, &m->ndata, p + off, n);
+    }
+    if (m->ntext + m->ndata > 0)
+        nmemb++;
+}
+
+/*
+ * Read the members of an ar archive.
+ */
+static int
+archive (const char *name)
+{
+    FILE *f = fopen (name, "rb");
+    unsigned char hdr [60], *buf;
+    unsigned size;
+
+    if (! f) {
+        perror (name);
+        return -1;
+    }
+    if (fread (hdr, 1, 8, f) != 8 || memcmp (hdr, "!<arch>\n", 8) != 0) {
+        fprintf (stderr, "%s: not an archive\n", name);
+        fclose (f);
+        return -1;
+    }
+    while (fread (hdr, 1, 60, f) == 60) {
+        size = strtoul ((char*) hdr + 48, 0, 10);
+        buf = malloc (size + 1);
+        if (fread (buf, 1, size, f) != size) {
+            free (buf);
+            break;
+        }
+        if (hdr[0] != '/')
+            elf (buf, size);
+        free (buf);
+        if (size & 1)
+            getc (f);
+    }
+    fclose (f);
+    return 0;
+}
+
+/*
+ * LZF compression of n bytes.  Returns the packed length,
+ * or 0 when it would not be shorter than the input.
+ */
+static unsigned
+lz_pack (const unsigned char *in, unsigned n, unsigned char *out)
+{
+    static const unsigned char *htab [1 << HLOG];
+    const unsigned char *ip = in, *end = in + n, *ref;
+    unsigned char *op = out, *oend = out + n;
+    unsigned lit = 0, h, off, len, maxlen;
+
+    memset (htab, 0, sizeof htab);
+    op++;                                   /* literal run length */
+    while (ip + 2 < end) {
+        h = (ip[0] << 16 | ip[1] << 8 | ip[2]) * 2654435761u >> (32 - HLOG);
+        ref = htab[h];
+        htab[h] = ip;
+        if (ref && (off = ip - ref - 1) < MAXOFF &&
+            ref[0] == ip[0] && ref[1] == ip[1] && ref[2] == ip[2]) {
+            maxlen = end - ip - 2;
+            if (maxlen > MAXREF)
+                maxlen = MAXREF;
+            for (len = 1; len < maxlen && ref[len+2] == ip[len+2]; len++)
+                continue;
+            if (op + 3 + 1 >= oend)
+                return 0;
+            op[- (int) lit - 1] = lit - 1;
+            if (lit == 0)
+                op--;
+            if (len < 7)
+                *op++ = (off >> 8) + (len << 5);
+            else {
+                *op++ = (off >> 8) + (7 << 5);
+                *op++ = len - 7;
+            }
+            *op++ = off;
+            op++;
+            lit = 0;
+            ip += len + 2;
+            continue;
+        }
+        if (op >= oend)
+            return 0;
+        *op++ = *ip++;
+        if (++lit == MAXLIT) {
+            op[- (int) lit - 1] = lit - 1;
+            lit = 0;
+            op++;
+        }
+    }
+    while (ip < end) {
+        if (op >= oend)
+            return 0;
+        *op++ = *ip++;
+        if (++lit == MAXLIT) {
+            op[- (int) lit - 1] = lit - 1;
+            lit = 0;
+            op++;
+        }
+    }
+    op[- (int) lit - 1] = lit - 1;
+    if (lit == 0)
+        op--;
+    return op - out < n ? op - out : 0;
+}
+
+/*
+ * Expand a chunk; returns the length produced.
+ */
+static unsigned
+lz_unpack (const unsigned char *in, unsigned n, unsigned char *out,
+    unsigned max)
+{
+    const unsigned char *ip = in, *end = in + n, *ref;
+    unsigned char *op = out, *oend = out + max;
+    unsigned ctrl, len;
+
+    while (ip < end) {
+        ctrl = *ip++;
+        if (ctrl < 32) {
+            len = ctrl + 1;
+            if (op + len > oend || ip + len > end)
+                return 0;
+            memcpy (op, ip, len);
+            op += len;
+            ip += len;
+            continue;
+        }
+        len = ctrl >> 5;
+        if (len == 7)
+            len += *ip++;
+        len += 2;
+        ref = op - ((ctrl & 0x1f) << 8) - *ip++ - 1;
+        if (ref < out || op + len > oend)
+            return 0;
+        while (len--)
+            *op++ = *ref++;
+    }
+    return op - out;
+}
+
+/*
+ * Build the image of a program of dsize bytes of data.
+ */
+static unsigned
+build (unsigned char *img, unsigned dsize, int heapfill, unsigned long *seed)
+{
+    struct member *m;
+    unsigned text = 0, len = 0, i, n, top;
+    uint32_t w;
+
+    memset (img, 0, MAXIMAGE);
+
+    /* Text, data and bss of members, until half the data area. */
+    while (len < dsize / 2) {
+        m = &memb[rnd (seed, nmemb)];
+        if (len + m->ntext + m->ndata + m->nbss > dsize)
+            break;
+        memcpy (img + len, m->text, m->ntext);
+        len += m->ntext;
+        text = len;
+        memcpy (img + len, m->data, m->ndata);
+        len += m->ndata + m->nbss;
+    }
+
+    /* The heap. */
+    while (heapfill && len < dsize) {
+        m = &memb[rnd (seed, nmemb)];
+        n = m->ndata < dsize - len ? m->ndata : dsize - len;
+        memcpy (img + len, m->data, n);
+        len += n + rnd (seed, 64);
+    }
+
+    /* Stack frames at the top of the stack. */
+    top = dsize + STACK;
+    for (i=top-1024; i<top; i+=4) {
+        switch (rnd (seed, 4)) {
+        case 0:
+            w = 0x7f008000 + (text ? rnd (seed, text) & ~3 : 0);
+            break;
+        case 1:
+            w = rnd (seed, 256);
+            break;
+        case 2:
+            w = 0x7f008000 + dsize + STACK - rnd (seed, 1024);
+            break;
+        default:
+            w = 0;
+            break;
+        }
+        memcpy (img + i, &w, 4);
+    }
+
+    /* The u area: registers, limits, file table, the rest zero. */
+    for (i=0; i<600; i+=4) {
+        w = rnd (seed, 2) ? 0x7f008000 + rnd (seed, dsize) : rnd (seed, 64);
+        memcpy (img + top + i, &w, 4);
+    }
+    return top + USIZE;
+}
+
+static double
+seconds (struct timespec *t0, struct timespec *t1)
+{
+    return (t1->tv_sec - t0->tv_sec) + (t1->tv_nsec - t0->tv_nsec) / 1e9;
+}
+
+/*
+ * Pack an image chunk by chunk, expand and compare.  Returns
+ * the blocks written; the times are added up.
+ */
+static unsigned
+swap (const unsigned char *img, unsigned n, unsigned chunk,
+    unsigned *nraw, double *tout, double *tin)
+{
+    static unsigned char packed [2 * MAXIMAGE], back [MAXIMAGE];
+    static unsigned len [MAXIMAGE / 256 + 1];
+    struct timespec t0, t1;
+    unsigned i, k, c, p, total = 0, nchunk = (n + chunk - 1) / chunk;
+
+    clock_gettime (CLOCK_MONOTONIC, &t0);
+    for (k=0; k<nchunk; k++) {
+        i = k * chunk;
+        c = n - i < chunk ? n - i : chunk;
+        p = lz_pack (img + i, c, packed + total + 2);
+        if (p == 0) {
+            memcpy (packed + total + 2, img + i, c);
+            p = c;
+            (*nraw)++;
+        }
+        len[k] = p;
+        packed[total] = p;
+        packed[total+1] = p >> 8;
+        total += 2 + p;
+    }
+    clock_gettime (CLOCK_MONOTONIC, &t1);
+    *tout += seconds (&t0, &t1);
+
+    clock_gettime (CLOCK_MONOTONIC, &t0);
+    for (k=0, p=0; k<nchunk; k++) {
+        i = k * chunk;
+        c = n - i < chunk ? n - i : chunk;
+        if (len[k] == c)
+            memcpy (back + i, packed + p + 2, c);
+        else if (lz_unpack (packed + p + 2, len[k], back + i, c) != c) {
+            nerrors++;
+            break;
+        }
+        p += 2 + len[k];
+    }
+    clock_gettime (CLOCK_MONOTONIC, &t1);
+    *tin += seconds (&t0, &t1);
+
+    if (memcmp (img, back, n) != 0) {
+        printf ("FAIL: image expanded as it was\n");
+        nerrors++;
+    }
+    return (total + DEV_BSIZE - 1) / DEV_BSIZE;
+}
+
+int
+main (int argc, char **argv)
+{
+    static const unsigned sizes [] = { 16, 32, 48, 64, 80, 96 };
+    static unsigned char img [MAXIMAGE];
+    unsigned long seed = 1, rawblk, packblk, alltext;
+    unsigned chunk = DEV_BSIZE, n, nb, nraw, junk, k;
+    double tout, tin, bytes;
+    int opt, heap, rep;
+
+    while ((opt = getopt (argc, argv, "c:s:")) != -1) {
+        switch (opt) {
+        case 'c':
+            chunk = strtoul (optarg, 0, 0);
+            break;
+        case 's':
+            seed = strtoul (optarg, 0, 0);
+            break;
+        default:
+usage:      fprintf (stderr, "Usage: zswapsim [-c chunk] [-s seed] "
+                "archive...\n");
+            return 1;
+        }
+    }
+    if (optind >= argc || chunk < 256 || chunk > 32768)
+        goto usage;
+    for (; optind < argc; optind++)
+        if (archive (argv[optind]) < 0)
+            return 1;
+    if (nmemb == 0) {
+        fprintf (stderr, "zswapsim: no objects found\n");
+        return 1;
+    }
+    alltext = 0;
+    for (k=0; k<nmemb; k++)
+        alltext += memb[k].ntext + memb[k].ndata;
+    printf ("%d objects, %lu kbytes of code and data, %u byte chunks:\n",
+        nmemb, alltext >> 10, chunk);
+
+    for (heap=0; heap<2; heap++) {
+        printf ("heap %s:\n", heap ? "in use" : "untouched");
+        rawblk = packblk = 0;
+        tout = tin = bytes = 0;
+        nraw = 0;
+        for (k=0; k<sizeof sizes / sizeof sizes[0]; k++) {
+            n = build (img, sizes[k] * 1024, heap, &seed);
+            nb = 0;
+            for (rep=0; rep<20; rep++)
+                nb = swap (img, n, chunk, rep ? &junk : &nraw,
+                    &tout, &tin);
+            printf ("  %2u kbyte data: %3u blocks -> %3u, %.2f:1\n",
+                sizes[k], (n + DEV_BSIZE - 1) / DEV_BSIZE, nb,
+                (double) n / DEV_BSIZE / nb);
+            rawblk += (n + DEV_BSIZE - 1) / DEV_BSIZE;
+            packblk += nb;
+            bytes += 20.0 * n;
+        }
+        printf ("  total %lu blocks -> %lu, %.2f:1, %u chunks stored as "
+            "they were;\n  %.1f Mbytes/s packing, %.1f Mbytes/s "
+            "expanding\n", rawblk, packblk, (double) rawblk / packblk,
+            nraw, bytes / tout / 1e6, bytes / tin / 1e6);
+    }
+    if (nerrors) {
+        printf ("%d checks failed\n", nerrors);
+        return 1;
+    }
+    printf ("all checks passed\n");
+    return 0;
+}
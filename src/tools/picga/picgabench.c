@@ -0,0 +1,193 @@
+/*
+ * Measure the bytes the picgaq library saves on the wire.
+ *
+ * A dashboard is redrawn frame after frame the way a simple program
+ * does it: colour and cursor set before every primitive.  The same
+ * command sequence is sent once with one picga_command() per call,
+ * as the kernel interface does, and once through picgaq into a file
+ * standing in for /dev/picga.  Both streams are rendered by the
+ * simulator and the images must be identical.
+ *
+ * Usage: picgabench [-f frames] [-o image.ppm]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <picgaq.h>
+#include "picgasim.h"
+
+static struct picgasim direct_sim, queued_sim;
+static struct picgaq q;
+static int use_queue;
+static unsigned long direct_bytes, direct_writes;
+static unsigned seed;
+
+static void
+emit (unsigned cmd, unsigned len, const void *data)
+{
+    unsigned char buf [2 + 255];
+
+    if (use_queue) {
+        if (picgaq_command (&q, cmd, len, data) < 0) {
+            perror ("picgaq_command");
+            exit (1);
+        }
+        return;
+    }
+    buf[0] = cmd;
+    buf[1] = len;
+    memcpy (buf + 2, data, len);
+    picgasim_feed (&direct_sim, buf, 2 + len);
+    direct_bytes += 2 + len;
+    direct_writes++;
+}
+
+static void
+color (unsigned cmd, unsigned value)
+{
+    struct intval v;
+
+    v.value = value;
+    emit (cmd, sizeof v, &v);
+}
+
+static void
+rect (unsigned x1, unsigned y1, unsigned x2, unsigned y2, int fill)
+{
+    struct rectangle r;
+
+    memset (&r, 0, sizeof r);
+    r.x1 = x1;
+    r.y1 = y1;
+    r.x2 = x2;
+    r.y2 = y2;
+    r.fill = fill;
+    emit (SPI_RECTANGLE, sizeof r, &r);
+}
+
+static void
+label (unsigned x, unsigned y, const char *text)
+{
+    struct coord2 c;
+
+    color (SPI_FGCOLOR, 0xff);
+    color (SPI_BGCOLOR, 0x00);
+    c.x = x;
+    c.y = y;
+    emit (SPI_LOCATE, sizeof c, &c);
+    emit (SPI_PRINT, strlen (text), text);
+}
+
+static void
+frame (unsigned n)
+{
+    struct coord2 p;
+    struct circle c;
+    char text [32];
+    unsigned i, value;
+
+    /* Four bar gauges with a label each. */
+    for (i=0; i<4; i++) {
+        seed = seed * 1103515245 + 12345;
+        value = (seed >> 16) % 100;
+
+        color (SPI_COLOR, 0xff);
+        rect (10 + i*75, 20, 70 + i*75, 121, 0);
+        color (SPI_COLOR, value > 80 ? 0xe0 : 0x1c);
+        rect (11 + i*75, 120 - value, 69 + i*75, 120, 1);
+        color (SPI_COLOR, 0x00);
+        rect (11 + i*75, 21, 69 + i*75, 119 - value, 1);
+
+        sprintf (text, "T%u=%3u", i + 1, value);
+        label (10 + i*75, 128, text);
+    }
+
+    /* Trend line, one point per sample. */
+    for (i=0; i<64; i++) {
+        color (SPI_COLOR, 0xfc);
+        p.x = 10 + i*4;
+        p.y = 200 - (n*7 + i*i) % 50;
+        emit (SPI_PLOT, sizeof p, &p);
+    }
+
+    /* Status lamp. */
+    memset (&c, 0, sizeof c);
+    c.x = 300;
+    c.y = 200;
+    c.radius = 12;
+    c.fill = 1;
+    color (SPI_COLOR, (n & 1) ? 0x1c : 0xe0);
+    emit (SPI_CIRCLE, sizeof c, &c);
+}
+
+int
+main (int argc, char **argv)
+{
+    char path[] = "/tmp/picgaXXXXXX";
+    unsigned char buf [4096];
+    unsigned frames = 100, i;
+    const char *image = 0;
+    unsigned long ndiff;
+    FILE *f;
+    int fd, n;
+
+    while ((n = getopt (argc, argv, "f:o:")) != -1) {
+        switch (n) {
+        case 'f':
+            frames = strtoul (optarg, 0, 0);
+            break;
+        case 'o':
+            image = optarg;
+            break;
+        default:
+            fprintf (stderr, "Usage: picgabench [-f frames] [-o image.ppm]\n");
+            return 1;
+        }
+    }
+
+    picgasim_init (&direct_sim);
+    picgasim_init (&queued_sim);
+
+    fd = mkstemp (path);
+    if (fd < 0 || picgaq_open (&q, path) < 0) {
+        perror (path);
+        return 1;
+    }
+    close (fd);
+
+    for (use_queue=0; use_queue<2; use_queue++) {
+        seed = 1;
+        emit (SPI_CLS, 0, 0);
+        for (i=0; i<frames; i++)
+            frame (i);
+    }
+    picgaq_close (&q);
+
+    /* Render what reached the device file. */
+    f = fopen (path, "rb");
+    while ((n = fread (buf, 1, sizeof buf, f)) > 0)
+        picgasim_feed (&queued_sim, buf, n);
+    fclose (f);
+    unlink (path);
+
+    ndiff = picgasim_compare (&direct_sim, &queued_sim);
+    printf ("frames %u, commands %lu\n", frames, direct_sim.ncmds);
+    printf ("direct:  %lu bytes in %lu writes\n", direct_bytes, direct_writes);
+    printf ("queued:  %lu bytes in %u writes, %lu commands\n",
+        q.nsent, q.nwrites, queued_sim.ncmds);
+    printf ("saved:   %.1f%% of the bytes, %.1f writes per burst\n",
+        100.0 * (direct_bytes - q.nsent) / direct_bytes,
+        (double) direct_writes / q.nwrites);
+    printf ("image:   %lu pixels differ\n", ndiff);
+
+    if (image) {
+        f = fopen (image, "wb");
+        if (! f || picgasim_write_ppm (&queued_sim, f) < 0) {
+            perror (image);
+            return 1;
+        }
+        fclose (f);
+    }
+    return ndiff != 0;
+}
@@ -0,0 +1,319 @@
+/*
+ * Host simulator of the PICGA graphics coprocessor.
+ */
+#include <string.h>
+#include <sys/picga.h>
+#include "picgasim.h"
+
+void
+picgasim_init (struct picgasim *s)
+{
+    memset (s, 0, sizeof *s);
+    s->color = 0xff;
+    s->fg = 0xff;
+}
+
+static void
+plot (struct picgasim *s, int x, int y, unsigned color)
+{
+    if (x >= 0 && x < PICGASIM_WIDTH && y >= 0 && y < PICGASIM_HEIGHT)
+        s->fb[y][x] = color;
+}
+
+static void
+hline (struct picgasim *s, int x1, int x2, int y, unsigned dither)
+{
+    int x, t;
+
+    if (x1 > x2) {
+        t = x1;
+        x1 = x2;
+        x2 = t;
+    }
+    for (x=x1; x<=x2; x++)
+        if (dither == 0 || (x + y) % (dither + 1) == 0)
+            plot (s, x, y, s->color);
+}
+
+static void
+draw (struct picgasim *s, int x1, int y1, int x2, int y2)
+{
+    int dx = (x2 > x1) ? x2 - x1 : x1 - x2;
+    int dy = (y2 > y1) ? y1 - y2 : y2 - y1;
+    int sx = (x1 < x2) ? 1 : -1;
+    int sy = (y1 < y2) ? 1 : -1;
+    int err = dx + dy, e2;
+
+    for (;;) {
+        plot (s, x1, y1, s->color);
+        if (x1 == x2 && y1 == y2)
+            break;
+        e2 = 2 * err;
+        if (e2 >= dy) {
+            err += dy;
+            x1 += sx;
+        }
+        if (e2 <= dx) {
+            err += dx;
+            y1 += sy;
+        }
+    }
+}
+
+static void
+rectangle (struct picgasim *s, const struct rectangle *r)
+{
+    int y, y1 = r->y1, y2 = r->y2;
+
+    if (! r->fill) {
+        draw (s, r->x1, r->y1, r->x2, r->y1);
+        draw (s, r->x2, r->y1, r->x2, r->y2);
+        draw (s, r->x2, r->y2, r->x1, r->y2);
+        draw (s, r->x1, r->y2, r->x1, r->y1);
+        return;
+    }
+    if (y1 > y2) {
+        y = y1;
+        y1 = y2;
+        y2 = y;
+    }
+    for (y=y1; y<=y2; y++)
+        hline (s, r->x1, r->x2, y, r->dither);
+}
+
+static void
+circle (struct picgasim *s, const struct circle *c)
+{
+    int x = c->radius, y = 0, err = 1 - x;
+    int cx = c->x, cy = c->y;
+
+    while (x >= y) {
+        if (c->fill) {
+            hline (s, cx - x, cx + x, cy + y, 0);
+            hline (s, cx - x, cx + x, cy - y, 0);
+            hline (s, cx - y, cx + y, cy + x, 0);
+            hline (s, cx - y, cx + y, cy - x, 0);
+        } else {
+            plot (s, cx + x, cy + y, s->color);
+            plot (s, cx - x, cy + y, s->color);
+            plot (s, cx + x, cy - y, s->color);
+            plot (s, cx - x, cy - y, s->color);
+            plot (s, cx + y, cy + x, s->color);
+            plot (s, cx - y, cy + x, s->color);
+            plot (s, cx + y, cy - x, s->color);
+            plot (s, cx - y, cy - x, s->color);
+        }
+        y++;
+        if (err < 0) {
+            err += 2*y + 1;
+        } else {
+            x--;
+            err += 2*(y - x) + 1;
+        }
+    }
+}
+
+/*
+ * Draw a character cell at the cursor and advance it.
+ * The glyph is a pattern of the character code and the font.
+ */
+static void
+putch (struct picgasim *s, unsigned c)
+{
+    unsigned row, col, bits;
+
+    for (row=0; row<PICGASIM_CELL; row++) {
+        bits = (c * 0x9d + row * 0x3b + s->font * 0x55) & 0xff;
+        if (c == ' ')
+            bits = 0;
+        for (col=0; col<PICGASIM_CELL; col++)
+            plot (s, s->cx + col, s->cy + row,
+                  (bits >> col & 1) ? s->fg : s->bg);
+    }
+    s->cx += PICGASIM_CELL;
+    if (s->cx + PICGASIM_CELL > PICGASIM_WIDTH) {
+        s->cx = 0;
+        s->cy += PICGASIM_CELL;
+    }
+}
+
+static void
+scroll (struct picgasim *s, unsigned dir)
+{
+    int n = PICGASIM_CELL, y;
+
+    switch (dir) {
+    case UP:
+        memmove (s->fb[0], s->fb[n], (PICGASIM_HEIGHT - n) * PICGASIM_WIDTH);
+        memset (s->fb[PICGASIM_HEIGHT - n], s->bg, n * PICGASIM_WIDTH);
+        break;
+    case DOWN:
+        memmove (s->fb[n], s->fb[0], (PICGASIM_HEIGHT - n) * PICGASIM_WIDTH);
+        memset (s->fb[0], s->bg, n * PICGASIM_WIDTH);
+        break;
+    case LEFT:
+        for (y=0; y<PICGASIM_HEIGHT; y++) {
+            memmove (s->fb[y], s->fb[y] + n, PICGASIM_WIDTH - n);
+            memset (s->fb[y] + PICGASIM_WIDTH - n, s->bg, n);
+        }
+        break;
+    case RIGHT:
+        for (y=0; y<PICGASIM_HEIGHT; y++) {
+            memmove (s->fb[y] + n, s->fb[y], PICGASIM_WIDTH - n);
+            memset (s->fb[y], s->bg, n);
+        }
+        break;
+    }
+}
+
+/*
+ * Copy a fixed-size payload, or count it as bad.
+ */
+static int
+payload (struct picgasim *s, const unsigned char *p, unsigned len,
+         void *dst, unsigned size)
+{
+    if (len < size) {
+        s->nbad++;
+        return 0;
+    }
+    memcpy (dst, p, size);
+    return 1;
+}
+
+static void
+execute (struct picgasim *s, unsigned cmd, const unsigned char *p, unsigned len)
+{
+    struct coord2 c2;
+    struct coord4 c4;
+    struct rectangle r;
+    struct circle c;
+    struct intval v;
+    unsigned i;
+
+    s->ncmds++;
+    switch (cmd) {
+    case SPI_IDLE:
+        break;
+    case SPI_CLS:
+        memset (s->fb, s->bg, sizeof s->fb);
+        s->cx = 0;
+        s->cy = 0;
+        break;
+    case SPI_SCROLL:
+        if (len > 0)
+            scroll (s, p[0]);
+        break;
+    case SPI_PLOT:
+        if (payload (s, p, len, &c2, sizeof c2))
+            plot (s, c2.x, c2.y, s->color);
+        break;
+    case SPI_DRAW:
+        if (payload (s, p, len, &c4, sizeof c4))
+            draw (s, c4.x1, c4.y1, c4.x2, c4.y2);
+        break;
+    case SPI_COLOR:
+        if (payload (s, p, len, &v, sizeof v))
+            s->color = v.value & 0xff;
+        break;
+    case SPI_RECTANGLE:
+        if (payload (s, p, len, &r, sizeof r))
+            rectangle (s, &r);
+        break;
+    case SPI_CIRCLE:
+        if (payload (s, p, len, &c, sizeof c))
+            circle (s, &c);
+        break;
+    case SPI_LOCATE:
+        if (payload (s, p, len, &c2, sizeof c2)) {
+            s->cx = c2.x;
+            s->cy = c2.y;
+        }
+        break;
+    case SPI_FONT:
+        if (len > 0)
+            s->font = p[0];
+        break;
+    case SPI_FGCOLOR:
+        if (payload (s, p, len, &v, sizeof v))
+            s->fg = v.value & 0xff;
+        break;
+    case SPI_BGCOLOR:
+        if (payload (s, p, len, &v, sizeof v))
+            s->bg = v.value & 0xff;
+        break;
+    case SPI_PRINTAT:
+    case SPI_PUTCHAR:
+        if (! payload (s, p, len, &c2, sizeof c2))
+            break;
+        s->cx = c2.x;
+        s->cy = c2.y;
+        p += sizeof c2;
+        len -= sizeof c2;
+        /* fall through */
+    case SPI_PRINT:
+    case SPI_PUTCH:
+        for (i=0; i<len; i++)
+            putch (s, p[i]);
+        break;
+    default:
+        s->nunknown++;
+        break;
+    }
+}
+
+void
+picgasim_feed (struct picgasim *s, const unsigned char *buf, unsigned len)
+{
+    unsigned need, n;
+
+    s->nbytes += len;
+    while (len > 0) {
+        need = (s->clen < 2) ? 2 : 2 + s->cmd[1];
+        n = need - s->clen;
+        if (n > len)
+            n = len;
+        memcpy (s->cmd + s->clen, buf, n);
+        s->clen += n;
+        buf += n;
+        len -= n;
+
+        if (s->clen >= 2 && s->clen == 2u + s->cmd[1]) {
+            execute (s, s->cmd[0], s->cmd + 2, s->cmd[1]);
+            s->clen = 0;
+        }
+    }
+}
+
+int
+picgasim_write_ppm (struct picgasim *s, FILE *f)
+{
+    unsigned x, y, c;
+    unsigned char rgb[3];
+
+    fprintf (f, "P6\n%d %d\n255\n", PICGASIM_WIDTH, PICGASIM_HEIGHT);
+    for (y=0; y<PICGASIM_HEIGHT; y++) {
+        for (x=0; x<PICGASIM_WIDTH; x++) {
+            c = s->fb[y][x];
+            rgb[0] = (c >> 5) * 255 / 7;
+            rgb[1] = (c >> 2 & 7) * 255 / 7;
+            rgb[2] = (c & 3) * 255 / 3;
+            if (fwrite (rgb, 3, 1, f) != 1)
+                return -1;
+        }
+    }
+    return 0;
+}
+
+unsigned long
+picgasim_compare (struct picgasim *a, struct picgasim *b)
+{
+    unsigned long ndiff = 0;
+    unsigned x, y;
+
+    for (y=0; y<PICGASIM_HEIGHT; y++)
+        for (x=0; x<PICGASIM_WIDTH; x++)
+            if (a->fb[y][x] != b->fb[y][x])
+                ndiff++;
+    return ndiff;
+}
@@ -0,0 +1,70 @@
+/*
+ * Host simulator of the PICGA graphics coprocessor.
+ *
+ * Interprets the command stream written to /dev/picga, as produced
+ * by picga_command() or the picgaq library: one byte of command code,
+ * one byte of payload length, then the payload.  Drawing goes to a
+ * frame buffer of 8-bit colours, which can be saved as a PPM image
+ * (colours are taken as RGB 3-3-2) and compared with another run.
+ *
+ * The simulator follows the payload layouts of <sys/picga.h>.  Where
+ * the header leaves the coprocessor behaviour open, it assumes:
+ *  - coordinates are in pixels, the text cursor too;
+ *  - SPI_PRINTAT and SPI_PUTCHAR carry a struct coord2 followed
+ *    by the text;
+ *  - a character cell is 8x8 pixels; glyphs are not the real fonts
+ *    but a fixed pattern derived from the character code, which is
+ *    enough to compare two renderings;
+ *  - a non-zero dither fills one pixel in every dither+1 along
+ *    the diagonals;
+ *  - SPI_SCROLL takes a direction and scrolls by one cell.
+ * SPI_CLUT, the copper commands and SPI_COPY are counted but
+ * not rendered.
+ */
+#ifndef PICGASIM_H_INCLUDED
+#define PICGASIM_H_INCLUDED
+
+#include <stdio.h>
+
+#define PICGASIM_WIDTH  320
+#define PICGASIM_HEIGHT 240
+#define PICGASIM_CELL   8
+
+struct picgasim {
+    unsigned char   fb [PICGASIM_HEIGHT] [PICGASIM_WIDTH];
+    unsigned        color;          /* SPI_COLOR */
+    unsigned        fg, bg;         /* SPI_FGCOLOR, SPI_BGCOLOR */
+    unsigned        font;
+    int             cx, cy;         /* text cursor */
+
+    /* Partial command carried over between feeds. */
+    unsigned char   cmd [2 + 255];
+    unsigned        clen;
+
+    /* Statistics. */
+    unsigned long   nbytes;         /* bytes received */
+    unsigned long   ncmds;          /* commands executed */
+    unsigned long   nunknown;       /* commands not rendered */
+    unsigned long   nbad;           /* payloads of a wrong size */
+};
+
+void picgasim_init (struct picgasim *s);
+
+/*
+ * Process a piece of the command stream.  Commands may be split
+ * across calls.
+ */
+void picgasim_feed (struct picgasim *s, const unsigned char *buf, unsigned len);
+
+/*
+ * Write the frame buffer as a binary PPM image.
+ * Returns 0 on success, -1 on error.
+ */
+int picgasim_write_ppm (struct picgasim *s, FILE *f);
+
+/*
+ * Count the pixels which differ between two frame buffers.
+ */
+unsigned long picgasim_compare (struct picgasim *a, struct picgasim *b);
+
+#endif
@@ -0,0 +1,204 @@
+/*
+ * Check the W5100 burst layer against the simulator and measure
+ * its cost on the SPI bus.
+ *
+ * First a transfer of two frames in one chip select cycle is sent
+ * straight to the port, to show what the chip makes of it.  Then a
+ * TCP socket is opened through the burst layer, and a stream of
+ * data is sent and received through TX and RX memory in chunks of
+ * various sizes.  Everything the peer gets, and everything the
+ * program reads, is compared with what was sent.
+ *
+ * Usage: burstbench [-n kbytes]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/spi.h>
+#include "w5100burst.h"
+#include "w5100sim.h"
+
+static int nfailed;
+
+static void
+expect (int cond, const char *what)
+{
+    if (! cond) {
+        printf ("FAIL: %s\n", what);
+        nfailed++;
+    }
+}
+
+static uint8_t
+pattern (unsigned long i)
+{
+    return (i * 131 + (i >> 8)) & 0xFF;
+}
+
+/*
+ * Two register reads packed in one chip select cycle.
+ */
+static void
+packed_cycle ()
+{
+    uint8_t frame [8] = { 0x0F, 0x00, 0x1A, 0xFF, 0x0F, 0x00, 0x1B, 0xFF };
+    int fd;
+
+    fd = open (W5100_SPI_DEVICE, O_RDWR);
+    ioctl (fd, SPICTL_IO8(8), frame);
+    printf ("packed:   RMSR %#x, TMSR %#x, %lu violation\n",
+        frame[3], frame[7], w5100sim_stats.violations);
+    expect (w5100sim_stats.violations == 1, "packed cycle flagged");
+    expect (frame[3] == 0x55 && frame[7] != 0x55,
+        "second frame of a packed cycle is lost");
+    close (fd);
+}
+
+/*
+ * Send total bytes from socket 0 and check what the peer got.
+ */
+static unsigned long
+send_stream (unsigned long total)
+{
+    static const unsigned sizes [] = { 1, 17, 64, 200, 1460, 2048 };
+    uint8_t buf [2048], got [2048];
+    unsigned long sent = 0, checked = 0;
+    unsigned k = 0, n, free, i, m;
+
+    while (sent < total) {
+        n = sizes[k++ % 6];
+        if (n > total - sent)
+            n = total - sent;
+        free = w5100_burst_tx_free (0);
+        if (n > free)
+            n = free;
+        for (i=0; i<n; i++)
+            buf[i] = pattern (sent + i);
+        w5100_burst_send_chunk (0, buf, n);
+        w5100_burst_cmd (0, Sock_SEND);
+        sent += n;
+
+        while ((m = w5100sim_peer_recv (0, got, sizeof got)) > 0) {
+            for (i=0; i<m; i++, checked++)
+                if (got[i] != pattern (checked)) {
+                    expect (0, "peer got what was sent");
+                    return checked;
+                }
+        }
+    }
+    return checked;
+}
+
+/*
+ * The peer sends total bytes; read them through RX memory.
+ */
+static unsigned long
+recv_stream (unsigned long total)
+{
+    static const unsigned sizes [] = { 2048, 3, 100, 1460, 511 };
+    uint8_t buf [2048];
+    unsigned long queued = 0, got = 0;
+    unsigned k = 0, n, i, avail;
+
+    while (got < total) {
+        /* Peer: fill RX memory in segments. */
+        while (queued < total) {
+            n = sizes[k++ % 5];
+            if (n > total - queued)
+                n = total - queued;
+            for (i=0; i<n; i++)
+                buf[i] = pattern (queued + i);
+            n = w5100sim_peer_send (0, buf, n);
+            if (n == 0)
+                break;
+            queued += n;
+        }
+
+        avail = w5100_burst_rx_size (0);
+        if (avail > sizeof buf)
+            avail = sizeof buf;
+        w5100_burst_recv_chunk (0, buf, avail);
+        w5100_burst_cmd (0, Sock_RECV);
+        for (i=0; i<avail; i++, got++)
+            if (buf[i] != pattern (got)) {
+                expect (0, "program read what the peer sent");
+                return got;
+            }
+    }
+    return got;
+}
+
+static struct w5100sim_stats mark;
+
+static void
+report (const char *name, unsigned long payload)
+{
+    unsigned long cycles = w5100sim_stats.cycles - mark.cycles;
+    unsigned long bytes = w5100sim_stats.bytes - mark.bytes;
+
+    printf ("%-9s %lu bytes, %lu chip select cycles, %lu SPI bytes, "
+        "%.2f SPI bytes per byte\n", name, payload, cycles, bytes,
+        (double) bytes / payload);
+    mark = w5100sim_stats;
+}
+
+int
+main (int argc, char **argv)
+{
+    unsigned long total = 256 * 1024, n;
+    int opt;
+
+    while ((opt = getopt (argc, argv, "n:")) != -1) {
+        switch (opt) {
+        case 'n':
+            total = strtoul (optarg, 0, 0) * 1024;
+            break;
+        default:
+            fprintf (stderr, "Usage: burstbench [-n kbytes]\n");
+            return 1;
+        }
+    }
+
+    w5100sim_reset ();
+    packed_cycle ();
+
+    w5100sim_reset ();
+    if (w5100_burst_init () < 0) {
+        perror (W5100_SPI_DEVICE);
+        return 1;
+    }
+    expect (w5100_rsize[0] == 2048 && w5100_ssize[3] == 2048,
+        "layout read from RMSR and TMSR");
+
+    /* One socket with all the memory. */
+    w5100_burst_write (0x001A, (const uint8_t*) "\x03\x03", 2);
+    expect (w5100_rsize[0] == 8192 && w5100_ssize[1] == 0,
+        "layout follows a write of RMSR and TMSR");
+    w5100b_writeSnMR (0, SnMR_TCP);
+    w5100_burst_cmd (0, Sock_OPEN);
+    w5100_burst_cmd (0, Sock_CONNECT);
+    expect (w5100b_readSnSR (0) == SnSR_ESTABLISHED, "socket connected");
+    printf ("setup:    %lu chip select cycles, %lu cache hits\n",
+        w5100sim_stats.cycles, w5100_burst_stats.cache_hits);
+    mark = w5100sim_stats;
+
+    n = send_stream (total);
+    expect (n == total, "whole stream sent");
+    report ("send:", total);
+
+    n = recv_stream (total);
+    expect (n == total, "whole stream received");
+    report ("receive:", total);
+
+    expect (w5100_burst_stats.transfers == w5100_burst_stats.frames,
+        "one ioctl per frame");
+    expect (w5100sim_stats.violations == 0, "no chip select violations");
+    if (nfailed) {
+        printf ("%d checks failed\n", nfailed);
+        return 1;
+    }
+    printf ("all checks passed\n");
+    return 0;
+}
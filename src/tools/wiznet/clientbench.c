@@ -0,0 +1,213 @@
+/*
+ * Compare the buffered client stream with the stock client
+ * routines on the W5100 simulator.
+ *
+ * A small HTTP exchange is repeated over one connection: the peer
+ * sends a request of header lines, which the program reads a byte
+ * at a time up to the empty line; the program answers with header
+ * lines written by puts and a body written a byte at a time.  The
+ * same exchange runs through client_*() and through bclient_*(),
+ * and the peer checks every byte of the responses.
+ *
+ * Usage: clientbench [-n exchanges]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "w5100burst.h"
+#include "w5100sim.h"
+#include "bclient.h"
+
+#define BODY    256
+
+static const char request[] =
+    "GET /status HTTP/1.1\r\n"
+    "Host: 192.168.1.20\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:128.0)\r\n"
+    "Accept: text/html,application/xhtml+xml,*/*;q=0.8\r\n"
+    "Accept-Language: en-US,en;q=0.5\r\n"
+    "Accept-Encoding: gzip, deflate\r\n"
+    "Connection: keep-alive\r\n"
+    "Cache-Control: max-age=0\r\n"
+    "\r\n";
+
+static const char *header[] = {
+    "HTTP/1.1 200 OK\r\n",
+    "Content-Type: text/plain\r\n",
+    "Content-Length: 256\r\n",
+    "Connection: keep-alive\r\n",
+    "\r\n",
+};
+
+#define NHEADER (sizeof header / sizeof header[0])
+
+static int nfailed;
+
+/*
+ * What the peer must get for one response.
+ */
+static unsigned
+response (char *buf)
+{
+    unsigned i, n = 0;
+
+    for (i=0; i<NHEADER; i++) {
+        strcpy (buf + n, header[i]);
+        n += strlen (header[i]);
+    }
+    for (i=0; i<BODY; i++)
+        buf[n++] = (i % 64 == 63) ? '\n' : 'a' + i % 26;
+    return n;
+}
+
+/*
+ * Peer side: check the response.
+ */
+static void
+peer (unsigned sock, const char *expect, unsigned len)
+{
+    char got [2048];
+    unsigned n;
+
+    n = w5100sim_peer_recv (sock, (uint8_t*) got, sizeof got);
+    if (n != len || memcmp (got, expect, len) != 0) {
+        printf ("FAIL: response of %u bytes, expected %u\n", n, len);
+        nfailed++;
+    }
+}
+
+/*
+ * Read a request up to the empty line.  Returns the number of lines.
+ */
+static unsigned
+read_stock (client_t *c)
+{
+    unsigned lines = 0, col = 0;
+    int ch;
+
+    for (;;) {
+        ch = client_getc (c);
+        if (ch < 0)
+            continue;
+        if (ch == '\n') {
+            if (col == 1)
+                return lines;
+            lines++;
+            col = 0;
+        } else {
+            col++;
+        }
+    }
+}
+
+static unsigned
+read_buffered (bclient_t *b)
+{
+    unsigned lines = 0, col = 0;
+    int ch;
+
+    for (;;) {
+        ch = bclient_getc (b);
+        if (ch < 0)
+            continue;
+        if (ch == '\n') {
+            if (col == 1)
+                return lines;
+            lines++;
+            col = 0;
+        } else {
+            col++;
+        }
+    }
+}
+
+static void
+report (const char *name, unsigned long bytes)
+{
+    printf ("%-9s %lu chip select cycles, %lu SENDs, %lu RECVs, "
+        "%.1f cycles per byte\n", name, w5100sim_stats.cycles,
+        w5100sim_stats.sends, w5100sim_stats.recvs,
+        (double) w5100sim_stats.cycles / bytes);
+}
+
+int
+main (int argc, char **argv)
+{
+    static uint8_t ip[4] = { 192, 168, 1, 10 };
+    static char expect [2048];
+    client_t c;
+    bclient_t b;
+    unsigned nexchanges = 100, i, k, len;
+    unsigned long bytes, stock_cycles;
+    int opt;
+
+    while ((opt = getopt (argc, argv, "n:")) != -1) {
+        switch (opt) {
+        case 'n':
+            nexchanges = strtoul (optarg, 0, 0);
+            break;
+        default:
+            fprintf (stderr, "Usage: clientbench [-n exchanges]\n");
+            return 1;
+        }
+    }
+    len = response (expect);
+    bytes = (unsigned long) nexchanges * (sizeof request - 1 + len);
+
+    /* Stock client routines. */
+    w5100sim_reset ();
+    w5100_init ();
+    client_init (&c, ip, 80);
+    if (! client_connect (&c)) {
+        printf ("stock: connect failed\n");
+        return 1;
+    }
+    memset (&w5100sim_stats, 0, sizeof w5100sim_stats);
+    for (i=0; i<nexchanges; i++) {
+        w5100sim_peer_send (c.sock, (const uint8_t*) request,
+            sizeof request - 1);
+        if (read_stock (&c) != 8)
+            nfailed++;
+        for (k=0; k<NHEADER; k++)
+            client_puts (&c, header[k]);
+        for (k=0; k<BODY; k++)
+            client_putc (&c, (k % 64 == 63) ? '\n' : 'a' + k % 26);
+        peer (c.sock, expect, len);
+    }
+    report ("stock:", bytes);
+    stock_cycles = w5100sim_stats.cycles;
+
+    /* Buffered client. */
+    w5100sim_reset ();
+    w5100_init ();
+    w5100_burst_init ();
+    bclient_init (&b, ip, 80);
+    if (! bclient_connect (&b)) {
+        printf ("bclient: connect failed\n");
+        return 1;
+    }
+    memset (&w5100sim_stats, 0, sizeof w5100sim_stats);
+    for (i=0; i<nexchanges; i++) {
+        w5100sim_peer_send (b.c.sock, (const uint8_t*) request,
+            sizeof request - 1);
+        if (read_buffered (&b) != 8)
+            nfailed++;
+        for (k=0; k<NHEADER; k++)
+            bclient_puts (&b, header[k]);
+        for (k=0; k<BODY; k++)
+            bclient_putc (&b, (k % 64 == 63) ? '\n' : 'a' + k % 26);
+        bclient_flush (&b);
+        peer (b.c.sock, expect, len);
+    }
+    report ("bclient:", bytes);
+
+    printf ("saved:    %.1f%% of the chip select cycles, %u exchanges of "
+        "%lu bytes\n", 100.0 - 100.0 * w5100sim_stats.cycles / stock_cycles,
+        nexchanges, bytes / nexchanges);
+    if (w5100sim_stats.violations || nfailed) {
+        printf ("%d checks failed\n", nfailed);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,304 @@
+/*
+ * Check wz_wait() against the simulator and measure how long it
+ * takes to wake up.
+ *
+ * The /INT line of the model is captured on a pipe, as an edge
+ * capture driver would do.  A peer thread sends a request 50 ms
+ * after the program starts to wait; the thread only touches the
+ * model while the program sleeps in select() or usleep().  Cases:
+ *
+ *  - a wait with no timeout after the acknowledge of the previous
+ *    request, whose release of /INT is a captured edge with no event;
+ *  - a wait after a SEND whose SEND_OK the client has not consumed
+ *    yet, which must not hold /INT low, and the next SEND, which
+ *    must still find its SEND_OK;
+ *  - a wait with a timeout and nothing to come;
+ *  - the same waits without the pipe, polling.
+ *
+ * Then four server sockets are connected and the peer sends requests
+ * to them at random, with a random number of idle passes of the
+ * server loop before each.  The loop is run with wz_poll(), and with
+ * the calls of server_available() in libwiznet: server_accept() and
+ * client_status() and client_available() on each socket.  Both read
+ * the request with bclient_read(), and each request must be found
+ * once, on its socket.  The chip select cycles of idle passes and of
+ * passes which find a request are counted, and converted into time
+ * at W5100_SPI_KHZ: 32 clocks per frame.
+ *
+ * Usage: eventbench [-n requests]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <wiznet/socket.h>
+#include "w5100burst.h"
+#include "w5100sim.h"
+#include "bclient.h"
+#include "wzevent.h"
+
+#define DELAY_MS    50
+#define NSERVER     4           /* server sockets */
+#define PORT        80
+
+static const char request[] = "GET / HTTP/1.1\r\n\r\n";
+static const char reply[] = "HTTP/1.1 204 No Content\r\n\r\n";
+
+static int nfailed;
+static unsigned peer_sock;
+
+static void
+expect (int cond, const char *what)
+{
+    if (! cond) {
+        printf ("FAIL: %s\n", what);
+        nfailed++;
+    }
+}
+
+static double
+now_ms ()
+{
+    struct timeval tv;
+
+    gettimeofday (&tv, 0);
+    return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+static void *
+peer (void *arg)
+{
+    usleep (DELAY_MS * 1000);
+    w5100sim_peer_send (peer_sock, (const uint8_t*) request,
+        sizeof request - 1);
+    return 0;
+}
+
+/*
+ * Wait with the peer sending a request after DELAY_MS,
+ * then read the request.  Returns the time of the wait in ms.
+ */
+static double
+wait_request (bclient_t *b, int intfd, struct timeval *timeout,
+    const char *name)
+{
+    struct wz_event ev [MAX_SOCK_NUM];
+    char buf [64];
+    pthread_t tid;
+    double t0, ms;
+    int n;
+
+    pthread_create (&tid, 0, peer, 0);
+    t0 = now_ms ();
+    n = wz_wait (ev, intfd, timeout);
+    ms = now_ms () - t0;
+    pthread_join (tid, 0);
+
+    printf ("%-22s %d event, woke after %.1f ms\n", name, n, ms);
+    expect (n == 1 && (ev[0].events & WZ_READABLE), name);
+    expect (ms >= DELAY_MS - 1 && ms < DELAY_MS + 100, "woken by the request");
+    n = bclient_read (b, (uint8_t*) buf, sizeof buf);
+    expect (n == sizeof request - 1, "request read");
+    return ms;
+}
+
+static void
+send_reply (bclient_t *b)
+{
+    bclient_write (b, (const uint8_t*) reply, sizeof reply - 1);
+    expect (bclient_flush (b) == 0, "reply sent");
+}
+
+static void
+run (bclient_t *b, int intfd, const char *how)
+{
+    struct wz_event ev [MAX_SOCK_NUM];
+    struct timeval tv;
+    char name [32], got [256];
+    double t0, ms;
+    unsigned n;
+    int r;
+
+    /* Acknowledged edge, no timeout. */
+    sprintf (name, "%s, no timeout:", how);
+    wait_request (b, intfd, 0, name);
+
+    /* SEND_OK pending in the chip. */
+    send_reply (b);
+    tv.tv_sec = 2;
+    tv.tv_usec = 0;
+    sprintf (name, "%s, after SEND:", how);
+    wait_request (b, intfd, &tv, name);
+    send_reply (b);
+    n = w5100sim_peer_recv (peer_sock, (uint8_t*) got, sizeof got);
+    expect (n == 2 * (sizeof reply - 1), "both replies reached the peer");
+
+    /* Nothing comes. */
+    tv.tv_sec = 0;
+    tv.tv_usec = 100000;
+    t0 = now_ms ();
+    r = wz_wait (ev, intfd, &tv);
+    ms = now_ms () - t0;
+    printf ("%s, timeout 100 ms:  %d events, returned after %.1f ms\n",
+        how, r, ms);
+    expect (r == 0, "timeout returns 0");
+    expect (ms >= 99 && ms < 150, "timeout honoured");
+}
+
+/*
+ * One pass of the server loop with wz_poll().
+ * Returns the socket with a request, or -1.
+ */
+static int
+pass_events (bclient_t *b)
+{
+    struct wz_event ev [MAX_SOCK_NUM];
+    char buf [64];
+    int i, n, found = -1;
+
+    n = wz_poll (ev);
+    for (i=0; i<n; i++) {
+        if (! (ev[i].events & WZ_READABLE))
+            continue;
+        expect (bclient_read (&b[ev[i].sock], (uint8_t*) buf, sizeof buf) ==
+            sizeof request - 1, "request read");
+        expect (found < 0, "one request per pass");
+        found = ev[i].sock;
+    }
+    return found;
+}
+
+/*
+ * One pass with the calls of server_available(): server_accept()
+ * reads the status of each socket, twice when it is not listening,
+ * and server_init() looks for a closed socket to listen on; then
+ * each socket has its status and received size read.
+ */
+static int
+pass_stock (bclient_t *b)
+{
+    char buf [64];
+    unsigned sock, s;
+    int found = -1;
+
+    for (sock=0; sock<NSERVER; sock++)
+        if (client_status (&b[sock].c) != SnSR_LISTEN)
+            client_status (&b[sock].c);
+    for (sock=0; sock<NSERVER; sock++)
+        if (client_status (&b[sock].c) == SnSR_CLOSED)
+            break;
+    for (sock=0; sock<NSERVER; sock++) {
+        s = client_status (&b[sock].c);
+        if ((s == SnSR_ESTABLISHED || s == SnSR_CLOSE_WAIT) &&
+            client_available (&b[sock].c)) {
+            expect (bclient_read (&b[sock], (uint8_t*) buf, sizeof buf) ==
+                sizeof request - 1, "request read");
+            expect (found < 0, "one request per pass");
+            found = sock;
+        }
+    }
+    return found;
+}
+
+/*
+ * Requests to NSERVER connected sockets, found by one kind of pass.
+ */
+static void
+serve (const char *name, int (*pass) (bclient_t*), unsigned nreq)
+{
+    static bclient_t b [NSERVER];
+    unsigned long seed = 1, cycles, idle_cycles, req_cycles, nidle;
+    unsigned i, k, sock;
+    double us;
+
+    w5100sim_reset ();
+    w5100_init ();
+    w5100_burst_init ();
+    for (sock=0; sock<NSERVER; sock++) {
+        socket_init (sock, SnMR_TCP, PORT, 0);
+        socket_listen (sock);
+        _socket_port[sock] = PORT;
+        w5100_cache_invalidate (sock);
+        expect (w5100sim_peer_connect (sock) == 0, "peer connected");
+        bclient_init_sock (&b[sock], sock);
+        wz_watch (sock, pass == pass_events ? WZ_READABLE | WZ_CLOSED : 0);
+    }
+    expect (pass (b) < 0, "nothing before the first request");
+
+    idle_cycles = req_cycles = nidle = 0;
+    for (i=0; i<nreq; i++) {
+        seed = seed * 1103515245 + 12345;
+        sock = (seed >> 16) % NSERVER;
+        for (k=(seed >> 20) % 16; k>0; k--) {
+            cycles = w5100sim_stats.cycles;
+            expect (pass (b) < 0, "no request in an idle pass");
+            idle_cycles += w5100sim_stats.cycles - cycles;
+            nidle++;
+        }
+        w5100sim_peer_send (sock, (const uint8_t*) request,
+            sizeof request - 1);
+        cycles = w5100sim_stats.cycles;
+        expect (pass (b) == sock, "request found on its socket");
+        req_cycles += w5100sim_stats.cycles - cycles;
+    }
+
+    /* A frame is 32 SPI clocks. */
+    us = 32 * 1000.0 / W5100_SPI_KHZ;
+    printf ("%-8s %5.1f frames per idle pass (%5.1f us), "
+        "%5.1f per request (%5.1f us)\n", name,
+        (double) idle_cycles / nidle, us * idle_cycles / nidle,
+        (double) req_cycles / nreq, us * req_cycles / nreq);
+    expect (w5100sim_stats.violations == 0, "no chip select violations");
+}
+
+int
+main (int argc, char **argv)
+{
+    static uint8_t ip[4] = { 192, 168, 1, 10 };
+    bclient_t b;
+    unsigned nreq = 1000;
+    int intfd, opt;
+
+    while ((opt = getopt (argc, argv, "n:")) != -1) {
+        switch (opt) {
+        case 'n':
+            nreq = strtoul (optarg, 0, 0);
+            break;
+        default:
+            fprintf (stderr, "Usage: eventbench [-n requests]\n");
+            return 1;
+        }
+    }
+
+    /* A lost SEND_OK would hang the client for ever. */
+    alarm (20);
+
+    w5100sim_reset ();
+    intfd = w5100sim_intfd ();
+    w5100_init ();
+    w5100_burst_init ();
+    bclient_init (&b, ip, 80);
+    if (intfd < 0 || ! bclient_connect (&b)) {
+        printf ("setup failed\n");
+        return 1;
+    }
+    peer_sock = b.c.sock;
+    wz_watch (peer_sock, WZ_READABLE | WZ_CLOSED);
+
+    run (&b, intfd, "edges");
+    run (&b, -1, "polled");
+    expect (w5100sim_stats.violations == 0, "no chip select violations");
+    alarm (0);
+
+    printf ("%d sockets, %u requests:\n", NSERVER, nreq);
+    serve ("wz_poll:", pass_events, nreq);
+    serve ("stock:", pass_stock, nreq);
+    if (nfailed) {
+        printf ("%d checks failed\n", nfailed);
+        return 1;
+    }
+    printf ("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,14 @@
+/*
+ * Host emulation of <wiznet/ethernet.h>.
+ *
+ * The host network stack is already configured, so the
+ * addresses from the environment are not needed here.
+ */
+#include <wiznet/ethernet.h>
+#include "hostsock.h"
+
+void
+ethernet_init ()
+{
+    w5100_init ();
+}
@@ -0,0 +1,62 @@
+/*
+ * Host emulation of the wiznet library on BSD sockets.
+ *
+ * The files in this directory implement the interfaces of
+ * <wiznet/socket.h>, client.h, server.h, udp.h and ethernet.h
+ * on top of the sockets of the build machine, with the same four
+ * socket slots, the same status codes and the same buffer limits
+ * as the W5100 (2 kbytes each, or as split by RMSR and TMSR), so
+ * that network code can be run and profiled off the device.
+ * Register reads through the inline accessors of <wiznet/w5100.h>
+ * (SnSR, SnIR, SnRX_RSR, SnTX_FSR and so on) return the state of
+ * the emulated socket.
+ *
+ * Build with the host compiler, searching the SDK headers after
+ * the system ones, for example:
+ *
+ *      H=$SDK/tools/wiznet/host
+ *      cc -idirafter $SDK/api/include app.c $H/w5100.c $H/socket.c \
+ *          $H/ethernet.c $H/client.c $H/server.c $H/udp.c
+ */
+#ifndef HOSTSOCK_H_INCLUDED
+#define HOSTSOCK_H_INCLUDED
+
+#include <wiznet/socket.h>
+
+struct hostsock {
+    int         fd;             /* data socket, or -1 */
+    int         lfd;            /* listening socket, or -1 */
+    unsigned    mode;           /* SnMR_TCP or SnMR_UDP */
+    unsigned    status;         /* SnSR_* */
+    unsigned    port;           /* local port */
+    unsigned    ir;             /* pending SnIR bits */
+    uint8_t     dip [4];        /* peer address */
+    unsigned    dport;          /* peer port */
+};
+
+extern struct hostsock hostsock [MAX_SOCK_NUM];
+
+/*
+ * Update the state of the socket from the host side and return SnSR.
+ */
+unsigned hostsock_status (unsigned sock);
+
+/*
+ * Bytes ready to read, as SnRX_RSR would report, and free space
+ * in the transmit buffer, as SnTX_FSR would.
+ */
+unsigned hostsock_rxsize (unsigned sock);
+unsigned hostsock_txfree (unsigned sock);
+
+/*
+ * Buffer sizes of the socket, as split by RMSR and TMSR.
+ */
+unsigned hostsock_rxbuf (unsigned sock);
+unsigned hostsock_txbuf (unsigned sock);
+
+/*
+ * Close all sockets and clear the register file.
+ */
+void hostsock_reset (void);
+
+#endif
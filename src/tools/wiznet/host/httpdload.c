@@ -0,0 +1,297 @@
+/*
+ * Load test of the httpd engine on the host backend.
+ *
+ * A child process runs httpd on the emulated sockets, serving a
+ * 2 Mbyte file from a scratch document root and answering
+ * /hello from a handler.  Download clients fetch the file over and
+ * over on keep-alive connections, and one client sends small
+ * requests on its own connection and times each reply.  Every reply
+ * is checked for its length, and the small ones for their body.
+ *
+ * -s sets the time slice of the server in microseconds, to measure
+ * what a longer slice gives the downloads and costs the small
+ * requests.
+ *
+ * The port must be free: when something already answers on it,
+ * the test stops, since the figures would be those of that server.
+ *
+ * Usage: httpdload [-d downloads] [-s slice] [-t seconds] [-p port]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include "httpd.h"
+
+#define FILESIZE    (2L * 1024 * 1024)
+#define MAXREQ      1000000
+
+static unsigned port = 8080;
+static unsigned long slice = WZS_SLICE_USEC;
+static char docroot [] = "/tmp/httpdloadXXXXXX";
+static char buf [65536];
+
+static double
+now ()
+{
+    struct timeval tv;
+
+    gettimeofday (&tv, 0);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static int
+hello (struct httpd_conn *c)
+{
+    if (strcmp (c->path, "/hello") != 0)
+        return 0;
+    httpd_response (c, 200, "text/plain", 6);
+    client_write (&c->c, (const uint8_t*) "hello\n", 6);
+    return 1;
+}
+
+static void
+serve ()
+{
+    static struct httpd h;
+
+    signal (SIGPIPE, SIG_IGN);
+    w5100_init ();
+    httpd_init (&h, port, docroot, hello);
+    h.srv.slice = slice;
+    for (;;)
+        httpd_poll (&h);
+}
+
+static int
+dial ()
+{
+    struct sockaddr_in sa;
+    int fd, on = 1;
+
+    fd = socket (AF_INET, SOCK_STREAM, 0);
+    setsockopt (fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof on);
+    memset (&sa, 0, sizeof sa);
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons (port);
+    sa.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+    if (connect (fd, (struct sockaddr*) &sa, sizeof sa) < 0) {
+        close (fd);
+        return -1;
+    }
+    return fd;
+}
+
+/*
+ * One request on a keep-alive connection.  Returns the length
+ * of the body, -1 when the reply is short or not 200.
+ */
+static long
+get (int fd, const char *path, const char *body)
+{
+    char req [128];
+    char *end, *p;
+    long have, len, got;
+    int n;
+
+    n = sprintf (req, "GET %s HTTP/1.1\r\nHost: localhost\r\n\r\n", path);
+    if (write (fd, req, n) != n)
+        return -1;
+
+    have = 0;
+    for (;;) {
+        n = read (fd, buf + have, sizeof buf - have - 1);
+        if (n <= 0)
+            return -1;
+        have += n;
+        buf[have] = 0;
+        end = strstr (buf, "\r\n\r\n");
+        if (end)
+            break;
+    }
+    p = strstr (buf, "Content-Length:");
+    if (strncmp (buf, "HTTP/1.1 200 ", 13) != 0 || ! p)
+        return -1;
+    len = atol (p + 15);
+    end += 4;
+    got = have - (end - buf);
+
+    /* A small body is kept and compared. */
+    while (body && got < len && have < sizeof buf) {
+        n = read (fd, buf + have, sizeof buf - have);
+        if (n <= 0)
+            return -1;
+        have += n;
+        got += n;
+    }
+    if (body && (got != len || memcmp (end, body, len) != 0))
+        return -1;
+    while (got < len) {
+        n = read (fd, buf, sizeof buf);
+        if (n <= 0)
+            return -1;
+        got += n;
+    }
+    return got == len ? len : -1;
+}
+
+/*
+ * Fetch the file until the deadline; report the bytes on the pipe.
+ */
+static void
+download (double deadline, int out)
+{
+    long total = 0, n;
+    int fd;
+
+    fd = dial ();
+    while (fd >= 0 && now () < deadline) {
+        n = get (fd, "/big.bin", 0);
+        if (n != FILESIZE) {
+            total = -1;
+            break;
+        }
+        total += n;
+    }
+    write (out, &total, sizeof total);
+    _exit (0);
+}
+
+static int
+compare (const void *a, const void *b)
+{
+    double x = *(const double*) a, y = *(const double*) b;
+
+    return (x > y) - (x < y);
+}
+
+static void
+make_docroot ()
+{
+    long i;
+    int fd;
+
+    if (! mkdtemp (docroot)) {
+        perror (docroot);
+        exit (1);
+    }
+    sprintf (buf, "%s/big.bin", docroot);
+    fd = open (buf, O_WRONLY | O_CREAT, 0644);
+    for (i=0; i<sizeof buf; i++)
+        buf[i] = 'a' + i % 26;
+    for (i=0; i<FILESIZE; i+=sizeof buf)
+        write (fd, buf, sizeof buf);
+    close (fd);
+}
+
+static void
+remove_docroot ()
+{
+    sprintf (buf, "%s/big.bin", docroot);
+    unlink (buf);
+    rmdir (docroot);
+}
+
+int
+main (int argc, char **argv)
+{
+    static double lat [MAXREQ];
+    unsigned ndown = 2, i;
+    double seconds = 3, start, deadline, t;
+    long bytes, total;
+    int opt, fd, pfd[2], failed = 0, n;
+    pid_t server;
+
+    while ((opt = getopt (argc, argv, "d:s:t:p:")) != -1) {
+        switch (opt) {
+        case 'd':
+            ndown = strtoul (optarg, 0, 0);
+            break;
+        case 's':
+            slice = strtoul (optarg, 0, 0);
+            break;
+        case 't':
+            seconds = atof (optarg);
+            break;
+        case 'p':
+            port = strtoul (optarg, 0, 0);
+            break;
+        default:
+usage:      fprintf (stderr, "Usage: httpdload [-d downloads] [-s slice] "
+                "[-t seconds] [-p port]\n");
+            return 1;
+        }
+    }
+    if (ndown > MAX_SOCK_NUM - 1)
+        goto usage;
+
+    fd = dial ();
+    if (fd >= 0) {
+        fprintf (stderr, "httpdload: port %u is in use\n", port);
+        return 1;
+    }
+    make_docroot ();
+    server = fork ();
+    if (server == 0)
+        serve ();
+    for (i=0; i<100 && (fd = dial ()) < 0; i++)
+        usleep (10000);
+    if (fd < 0) {
+        fprintf (stderr, "httpdload: server did not start\n");
+        kill (server, SIGTERM);
+        remove_docroot ();
+        return 1;
+    }
+
+    start = now ();
+    deadline = start + seconds;
+    pipe (pfd);
+    for (i=0; i<ndown; i++)
+        if (fork () == 0)
+            download (deadline, pfd[1]);
+    usleep (100000);
+
+    n = 0;
+    while (n < MAXREQ && (t = now ()) < deadline) {
+        if (get (fd, "/hello", "hello\n") != 6) {
+            failed++;
+            break;
+        }
+        lat[n++] = now () - t;
+    }
+    close (fd);
+
+    total = 0;
+    for (i=0; i<ndown; i++) {
+        read (pfd[0], &bytes, sizeof bytes);
+        if (bytes < 0)
+            failed++;
+        else
+            total += bytes;
+        wait (0);
+    }
+    kill (server, SIGTERM);
+    waitpid (server, 0, 0);
+    remove_docroot ();
+
+    if (failed || n == 0) {
+        printf ("FAIL: bad or missing replies\n");
+        return 1;
+    }
+    qsort (lat, n, sizeof lat[0], compare);
+    printf ("slice %lu us, downloads %u: %.0f req/s, p50 %.2f ms, "
+        "p99 %.2f ms", slice, ndown, n / (seconds - 0.1), lat[n/2] * 1e3,
+        lat[n*99/100] * 1e3);
+    if (ndown)
+        printf (", %.1f Mbytes/s per download", total / seconds / ndown / 1e6);
+    printf ("\n");
+    return 0;
+}
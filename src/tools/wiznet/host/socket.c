@@ -0,0 +1,421 @@
+/*
+ * Host emulation of <wiznet/socket.h> on BSD sockets.
+ */
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "hostsock.h"
+
+struct hostsock hostsock [MAX_SOCK_NUM];
+
+unsigned _socket_port [MAX_SOCK_NUM];
+
+static unsigned local_port;
+
+static void
+set_nonblock (int fd)
+{
+    fcntl (fd, F_SETFL, fcntl (fd, F_GETFL) | O_NONBLOCK);
+}
+
+/*
+ * The chip puts every SEND on the wire at once: no Nagle delay.
+ */
+static void
+set_nodelay (int fd)
+{
+    int opt = 1;
+
+    setsockopt (fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof opt);
+}
+
+static void
+make_addr (struct sockaddr_in *sa, const uint8_t *addr, unsigned port)
+{
+    memset (sa, 0, sizeof *sa);
+    sa->sin_family = AF_INET;
+    sa->sin_port = htons (port);
+    memcpy (&sa->sin_addr, addr, 4);
+}
+
+static void
+save_peer (struct hostsock *s, const struct sockaddr_in *sa)
+{
+    memcpy (s->dip, &sa->sin_addr, 4);
+    s->dport = ntohs (sa->sin_port);
+}
+
+static void
+close_fds (struct hostsock *s)
+{
+    if (s->fd >= 0)
+        close (s->fd);
+    if (s->lfd >= 0)
+        close (s->lfd);
+    s->fd = -1;
+    s->lfd = -1;
+}
+
+void
+hostsock_reset ()
+{
+    static int initialized;
+    unsigned sock;
+
+    for (sock=0; sock<MAX_SOCK_NUM; sock++) {
+        if (initialized)
+            close_fds (&hostsock[sock]);
+        memset (&hostsock[sock], 0, sizeof hostsock[sock]);
+        hostsock[sock].fd = -1;
+        hostsock[sock].lfd = -1;
+        hostsock[sock].status = SnSR_CLOSED;
+        _socket_port[sock] = 0;
+    }
+    initialized = 1;
+}
+
+unsigned
+hostsock_status (unsigned sock)
+{
+    struct hostsock *s = &hostsock[sock];
+    struct sockaddr_in sa;
+    socklen_t len = sizeof sa;
+    int fd, err;
+    char c;
+
+    switch (s->status) {
+    case SnSR_LISTEN:
+        /* Like the chip, the listening socket becomes the connection. */
+        fd = accept (s->lfd, (struct sockaddr*) &sa, &len);
+        if (fd < 0)
+            break;
+        close (s->lfd);
+        s->lfd = -1;
+        s->fd = fd;
+        set_nonblock (fd);
+        set_nodelay (fd);
+        save_peer (s, &sa);
+        s->status = SnSR_ESTABLISHED;
+        s->ir |= SnIR_CON;
+        break;
+
+    case SnSR_SYNSENT:
+        len = sizeof err;
+        if (getsockopt (s->fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0 ||
+            err != 0) {
+            close_fds (s);
+            s->status = SnSR_CLOSED;
+            s->ir |= SnIR_TIMEOUT;
+            break;
+        }
+        if (getpeername (s->fd, (struct sockaddr*) &sa, &len) < 0)
+            break;
+        s->status = SnSR_ESTABLISHED;
+        s->ir |= SnIR_CON;
+        break;
+
+    case SnSR_ESTABLISHED:
+    case SnSR_FIN_WAIT:
+        err = recv (s->fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+        if (err > 0)
+            s->ir |= SnIR_RECV;
+        if (err > 0 || (err < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)))
+            break;
+        if (s->status == SnSR_FIN_WAIT || err < 0) {
+            close_fds (s);
+            s->status = SnSR_CLOSED;
+        } else {
+            s->status = SnSR_CLOSE_WAIT;
+        }
+        s->ir |= SnIR_DISCON;
+        break;
+    }
+    return s->status;
+}
+
+unsigned
+hostsock_rxsize (unsigned sock)
+{
+    struct hostsock *s = &hostsock[sock];
+    unsigned size = hostsock_rxbuf (sock);
+    int n = 0;
+
+    if (s->fd < 0 || ioctl (s->fd, FIONREAD, &n) < 0 || n <= 0)
+        return 0;
+    if (s->mode == SnMR_UDP)
+        n += 8;                 /* the chip counts its packet header */
+    return (n > size) ? size : n;
+}
+
+unsigned
+hostsock_txfree (unsigned sock)
+{
+    struct hostsock *s = &hostsock[sock];
+    unsigned size = hostsock_txbuf (sock);
+    int n = 0;
+
+    if (s->fd < 0)
+        return 0;
+    if (ioctl (s->fd, TIOCOUTQ, &n) < 0 || n < 0)
+        n = 0;
+    return (n >= size) ? 0 : size - n;
+}
+
+/*
+ * Opens a socket(TCP or UDP mode)
+ */
+unsigned
+socket_init (unsigned sock, unsigned protocol, unsigned port, unsigned flag)
+{
+    struct hostsock *s = &hostsock[sock];
+    struct sockaddr_in sa;
+    int fd, opt, size;
+
+    if (protocol != SnMR_TCP && protocol != SnMR_UDP)
+        return 0;
+    socket_close (sock);
+
+    fd = socket (AF_INET, (protocol == SnMR_TCP) ? SOCK_STREAM : SOCK_DGRAM,
+        0);
+    if (fd < 0)
+        return 0;
+    opt = 1;
+    setsockopt (fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof opt);
+#ifdef SO_REUSEPORT
+    setsockopt (fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof opt);
+#endif
+    size = hostsock_rxbuf (sock);
+    setsockopt (fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof size);
+    size = hostsock_txbuf (sock);
+    setsockopt (fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof size);
+
+    if (port == 0) {
+        local_port++;
+        if (local_port < 1024)
+            local_port = 1024;
+        port = local_port;
+    }
+    memset (&sa, 0, sizeof sa);
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons (port);
+    sa.sin_addr.s_addr = htonl (INADDR_ANY);
+    if (bind (fd, (struct sockaddr*) &sa, sizeof sa) < 0) {
+        close (fd);
+        return 0;
+    }
+    set_nonblock (fd);
+    if (protocol == SnMR_TCP)
+        set_nodelay (fd);
+
+    s->fd = fd;
+    s->mode = protocol;
+    s->port = port;
+    s->ir = 0;
+    s->status = (protocol == SnMR_TCP) ? SnSR_INIT : SnSR_UDP;
+    _socket_port[sock] = port;
+    return 1;
+}
+
+/*
+ * Close socket
+ */
+void
+socket_close (unsigned sock)
+{
+    struct hostsock *s = &hostsock[sock];
+
+    close_fds (s);
+    s->status = SnSR_CLOSED;
+    s->ir = 0;
+}
+
+/*
+ * Establish TCP connection (Passive connection)
+ */
+unsigned
+socket_listen (unsigned sock)
+{
+    struct hostsock *s = &hostsock[sock];
+    unsigned i;
+
+    if (s->status != SnSR_INIT)
+        return 0;
+
+    /*
+     * Sockets listening on the same port share one host socket,
+     * so that a connection waits for any of them, as with the chip.
+     */
+    for (i=0; i<MAX_SOCK_NUM; i++) {
+        if (i != sock && hostsock[i].status == SnSR_LISTEN &&
+            hostsock[i].port == s->port && hostsock[i].lfd >= 0) {
+            close (s->fd);
+            s->fd = -1;
+            s->lfd = dup (hostsock[i].lfd);
+            s->status = SnSR_LISTEN;
+            return 1;
+        }
+    }
+    if (listen (s->fd, MAX_SOCK_NUM) < 0)
+        return 0;
+    s->lfd = s->fd;
+    s->fd = -1;
+    s->status = SnSR_LISTEN;
+    return 1;
+}
+
+/*
+ * Establish TCP connection (Active connection)
+ */
+unsigned
+socket_connect (unsigned sock, uint8_t *addr, unsigned port)
+{
+    struct hostsock *s = &hostsock[sock];
+    struct sockaddr_in sa;
+
+    if (s->status != SnSR_INIT || port == 0)
+        return 0;
+    make_addr (&sa, addr, port);
+    if (connect (s->fd, (struct sockaddr*) &sa, sizeof sa) < 0 &&
+        errno != EINPROGRESS)
+        return 0;
+    save_peer (s, &sa);
+    s->status = SnSR_SYNSENT;
+    return 1;
+}
+
+/*
+ * disconnect the connection
+ */
+void
+socket_disconnect (unsigned sock)
+{
+    struct hostsock *s = &hostsock[sock];
+
+    if (s->fd < 0)
+        return;
+    shutdown (s->fd, SHUT_WR);
+    s->status = (s->status == SnSR_CLOSE_WAIT) ? SnSR_CLOSED : SnSR_FIN_WAIT;
+    if (s->status == SnSR_CLOSED)
+        close_fds (s);
+}
+
+/*
+ * Send data (TCP)
+ */
+unsigned
+socket_send (unsigned sock, const uint8_t *buf, unsigned len)
+{
+    struct hostsock *s = &hostsock[sock];
+    unsigned done = 0;
+    int n;
+
+    if (len > hostsock_txbuf (sock))
+        len = hostsock_txbuf (sock);
+
+    while (done < len) {
+        n = send (s->fd, buf + done, len - done, MSG_NOSIGNAL);
+        if (n > 0) {
+            done += n;
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            if (hostsock_status (sock) != SnSR_ESTABLISHED &&
+                s->status != SnSR_CLOSE_WAIT)
+                return 0;
+            continue;
+        }
+        socket_close (sock);
+        return 0;
+    }
+    s->ir |= SnIR_SEND_OK;
+    return len;
+}
+
+/*
+ * Receive data (TCP)
+ */
+unsigned
+socket_recv (unsigned sock, uint8_t *buf, unsigned len)
+{
+    struct hostsock *s = &hostsock[sock];
+    int n;
+
+    if (s->fd < 0 || len == 0)
+        return 0;
+    if (len > hostsock_rxbuf (sock))
+        len = hostsock_rxbuf (sock);
+    n = recv (s->fd, buf, len, MSG_DONTWAIT);
+    if (n > 0)
+        return n;
+    if (n == 0 && s->status == SnSR_ESTABLISHED) {
+        s->status = SnSR_CLOSE_WAIT;
+        s->ir |= SnIR_DISCON;
+    }
+    return 0;
+}
+
+unsigned
+socket_peek (unsigned sock)
+{
+    struct hostsock *s = &hostsock[sock];
+    uint8_t b = 0;
+
+    if (s->fd >= 0)
+        recv (s->fd, &b, 1, MSG_PEEK | MSG_DONTWAIT);
+    return b;
+}
+
+/*
+ * Send data (UDP)
+ */
+unsigned
+socket_sendto (unsigned sock, const uint8_t *buf, unsigned len, uint8_t *addr, unsigned port)
+{
+    struct hostsock *s = &hostsock[sock];
+    struct sockaddr_in sa;
+
+    if (len > hostsock_txbuf (sock))
+        len = hostsock_txbuf (sock);
+    if (s->fd < 0 || port == 0 ||
+        (addr[0] == 0 && addr[1] == 0 && addr[2] == 0 && addr[3] == 0))
+        return 0;
+    make_addr (&sa, addr, port);
+    if (sendto (s->fd, buf, len, 0, (struct sockaddr*) &sa, sizeof sa) < 0)
+        return 0;
+    s->ir |= SnIR_SEND_OK;
+    return len;
+}
+
+/*
+ * Receive data (UDP)
+ */
+unsigned
+socket_recvfrom (unsigned sock, uint8_t *buf, unsigned len, uint8_t *addr, unsigned *port)
+{
+    struct hostsock *s = &hostsock[sock];
+    struct sockaddr_in sa;
+    socklen_t salen = sizeof sa;
+    int n;
+
+    if (s->fd < 0 || len == 0)
+        return 0;
+    n = recvfrom (s->fd, buf, len, MSG_DONTWAIT, (struct sockaddr*) &sa,
+        &salen);
+    if (n <= 0)
+        return 0;
+    memcpy (addr, &sa.sin_addr, 4);
+    *port = ntohs (sa.sin_port);
+    return n;
+}
+
+unsigned
+socket_igmpsend (unsigned sock, const uint8_t *buf, unsigned len)
+{
+    /* Raw IGMP is not available to ordinary host processes. */
+    return 0;
+}
@@ -0,0 +1,65 @@
+/*
+ * Host emulation of <wiznet/udp.h>.
+ */
+#include <string.h>
+#include <wiznet/ethernet.h>
+#include <wiznet/udp.h>
+#include "hostsock.h"
+
+int
+udp_init (udp_t *u, unsigned port)
+{
+    unsigned i, s;
+
+    u->sock = MAX_SOCK_NUM;
+    for (i=0; i<MAX_SOCK_NUM; i++) {
+        s = w5100_readSnSR (i);
+        if (s == SnSR_CLOSED || s == SnSR_FIN_WAIT) {
+            u->sock = i;
+            break;
+        }
+    }
+    if (u->sock == MAX_SOCK_NUM)
+        return 0;
+
+    u->port = port;
+    socket_init (u->sock, SnMR_UDP, port, 0);
+    return 1;
+}
+
+unsigned
+udp_available (udp_t *u)
+{
+    return w5100_getRXReceivedSize (u->sock);
+}
+
+void
+udp_stop (udp_t *u)
+{
+    if (u->sock == MAX_SOCK_NUM)
+        return;
+
+    socket_close (u->sock);
+    _socket_port [u->sock] = 0;
+    u->sock = MAX_SOCK_NUM;
+}
+
+unsigned
+udp_send_packet (udp_t *u, const uint8_t *data, unsigned len,
+                 uint8_t *ip, unsigned port)
+{
+    return socket_sendto (u->sock, data, len, ip, port);
+}
+
+unsigned
+udp_send_string (udp_t *u, const char *data, uint8_t *ip, unsigned port)
+{
+    return udp_send_packet (u, (const uint8_t*) data, strlen (data), ip, port);
+}
+
+int
+udp_read_packet (udp_t *u, uint8_t *buf, unsigned len, uint8_t *ip,
+                 unsigned *port)
+{
+    return socket_recvfrom (u->sock, buf, len, ip, port);
+}
@@ -0,0 +1,213 @@
+/*
+ * Host emulation of the W5100 register file.
+ *
+ * Common registers are kept in memory.  Socket registers
+ * reflect the state of the host socket behind each slot.
+ */
+#include <string.h>
+#include <sys/socket.h>
+#include "hostsock.h"
+
+static uint8_t common [0x30];
+
+void
+w5100_init ()
+{
+    hostsock_reset ();
+    memset (common, 0, sizeof common);
+    common[0x17] = 2000 >> 8;           /* RTR: 200 msec */
+    common[0x18] = 2000 & 0xFF;
+    common[0x19] = 8;                   /* RCR */
+    common[0x1A] = 0x55;                /* RMSR: 2 kbytes per socket */
+    common[0x1B] = 0x55;                /* TMSR */
+}
+
+/*
+ * Memory is given to the sockets in order, 1 to 8 kbytes each,
+ * until the 8 kbytes are used up.
+ */
+static unsigned
+buf_size (unsigned msr, unsigned sock)
+{
+    unsigned i, size, used;
+
+    used = 0;
+    for (i=0; ; i++) {
+        size = 1024 << ((msr >> (i*2)) & 3);
+        if (used + size > 8192)
+            return 0;
+        if (i == sock)
+            return size;
+        used += size;
+    }
+}
+
+unsigned
+hostsock_rxbuf (unsigned sock)
+{
+    return buf_size (common[0x1A], sock);
+}
+
+unsigned
+hostsock_txbuf (unsigned sock)
+{
+    return buf_size (common[0x1B], sock);
+}
+
+static unsigned
+read_socket_reg (unsigned sock, unsigned reg)
+{
+    struct hostsock *s = &hostsock[sock];
+    unsigned val;
+
+    switch (reg) {
+    case 0x00:                          /* SnMR */
+        return s->mode;
+    case 0x02:                          /* SnIR */
+        hostsock_status (sock);
+        return s->ir;
+    case 0x03:                          /* SnSR */
+        return hostsock_status (sock);
+    case 0x04: case 0x05:               /* SnPORT */
+        val = s->port;
+        break;
+    case 0x0C: case 0x0D: case 0x0E: case 0x0F:
+        return s->dip [reg - 0x0C];     /* SnDIPR */
+    case 0x10: case 0x11:               /* SnDPORT */
+        val = s->dport;
+        break;
+    case 0x12: case 0x13:               /* SnMSSR */
+        val = 1460;
+        break;
+    case 0x20: case 0x21:               /* SnTX_FSR */
+        val = hostsock_txfree (sock);
+        break;
+    case 0x26: case 0x27:               /* SnRX_RSR */
+        val = hostsock_rxsize (sock);
+        break;
+    default:
+        return 0;
+    }
+    return (reg & 1) ? (val & 0xFF) : (val >> 8);
+}
+
+unsigned
+w5100_read_byte (unsigned addr)
+{
+    unsigned sock, ir;
+
+    if (addr == 0x15) {
+        /* IR: one bit per socket with pending interrupts. */
+        ir = 0;
+        for (sock=0; sock<MAX_SOCK_NUM; sock++)
+            if (read_socket_reg (sock, 0x02))
+                ir |= 1 << sock;
+        return ir;
+    }
+    if (addr < sizeof common)
+        return common [addr];
+    if (addr >= CH_BASE && addr < CH_BASE + MAX_SOCK_NUM * CH_SIZE)
+        return read_socket_reg ((addr - CH_BASE) / CH_SIZE, addr & 0xFF);
+    return 0;
+}
+
+unsigned
+w5100_write_byte (unsigned addr, int byte)
+{
+    unsigned sock;
+
+    if (addr < sizeof common) {
+        common [addr] = byte;
+        return 1;
+    }
+    if (addr >= CH_BASE && addr < CH_BASE + MAX_SOCK_NUM * CH_SIZE) {
+        sock = (addr - CH_BASE) / CH_SIZE;
+        switch (addr & 0xFF) {
+        case 0x01:                      /* SnCR */
+            w5100_socket_cmd (sock, byte);
+            break;
+        case 0x02:                      /* SnIR: write 1 to clear */
+            hostsock[sock].ir &= ~byte;
+            break;
+        }
+    }
+    return 1;
+}
+
+unsigned
+w5100_write (unsigned addr, const uint8_t *buf, unsigned len)
+{
+    unsigned i;
+
+    for (i=0; i<len; i++)
+        w5100_write_byte (addr + i, buf[i]);
+    return len;
+}
+
+unsigned
+w5100_read (unsigned addr, uint8_t *buf, unsigned len)
+{
+    unsigned i;
+
+    for (i=0; i<len; i++)
+        buf[i] = w5100_read_byte (addr + i);
+    return len;
+}
+
+/*
+ * Socket memory is not addressable on the host: data is
+ * always taken from the head of the receive queue.
+ */
+void
+w5100_read_data (unsigned sock, unsigned src, uint8_t *dst, unsigned len)
+{
+    if (hostsock[sock].fd >= 0)
+        recv (hostsock[sock].fd, dst, len, MSG_PEEK | MSG_DONTWAIT);
+}
+
+void
+w5100_send_chunk (unsigned sock, const uint8_t *data, unsigned len)
+{
+    socket_send (sock, data, len);
+}
+
+void
+w5100_recv_chunk (unsigned sock, uint8_t *data, unsigned len)
+{
+    socket_recv (sock, data, len);
+}
+
+unsigned
+w5100_recv_peek (unsigned sock)
+{
+    return socket_peek (sock);
+}
+
+void
+w5100_socket_cmd (unsigned sock, int cmd)
+{
+    switch (cmd) {
+    case Sock_LISTEN:
+        socket_listen (sock);
+        break;
+    case Sock_DISCON:
+        socket_disconnect (sock);
+        break;
+    case Sock_CLOSE:
+        socket_close (sock);
+        break;
+    }
+    /* OPEN, CONNECT, SEND and RECV are done by the socket_*() calls. */
+}
+
+unsigned
+w5100_getTXFreeSize (unsigned sock)
+{
+    return hostsock_txfree (sock);
+}
+
+unsigned
+w5100_getRXReceivedSize (unsigned sock)
+{
+    return hostsock_rxsize (sock);
+}
@@ -0,0 +1,20 @@
+/*
+ * <sys/spi.h> for host builds.
+ *
+ * The SDK header encodes the transfer ioctls with _ION(), which
+ * the <sys/ioctl.h> of the build machine does not define.  Define
+ * it as the SDK does, then take the SDK header.
+ */
+#include <sys/ioctl.h>
+
+#ifndef IOCPARM_MASK
+#define IOCPARM_MASK    0xff
+#endif
+#ifndef IOC_INOUT
+#define IOC_INOUT       0xc0000000
+#endif
+#ifndef _ION
+#define _ION(x,y,n)     (IOC_INOUT | (((n)&IOCPARM_MASK)<<16) | ((x)<<8) | y)
+#endif
+
+#include_next <sys/spi.h>
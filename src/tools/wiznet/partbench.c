@@ -0,0 +1,195 @@
+/*
+ * Check the socket memory split against the simulator and count
+ * the SEND commands of a bulk upload.
+ *
+ * Socket 0 sends a stream, writing as much as its TX memory takes
+ * before each SEND and waiting for SEND_OK, first with the layout
+ * of w5100_init() and then after wz_part_apply() with socket 0
+ * declared bulk and the other three idle.  The peer checks every
+ * byte.  The model acknowledges data at once, so this counts the
+ * commands and the SPI traffic per byte, not the throughput of a
+ * real link, which a larger window would also raise.
+ *
+ * Then bclient writes a full segment, BCLIENT_TXSIZE bytes, on
+ * socket 2, which the split left with 1 kbyte of TX memory: once
+ * with the segment size bclient reads from the chip, and once with
+ * the larger one it would have kept from before the split.  Each
+ * must reach the peer in SENDs which fit the socket, instead of
+ * waiting forever for free space.
+ *
+ * Usage: partbench [-n kbytes]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include "w5100burst.h"
+#include "w5100sim.h"
+#include "wzpart.h"
+#include "bclient.h"
+
+static int nfailed;
+
+static void
+expect (int cond, const char *what)
+{
+    if (! cond) {
+        printf ("FAIL: %s\n", what);
+        nfailed++;
+    }
+}
+
+static uint8_t
+pattern (unsigned long i)
+{
+    return (i * 131 + (i >> 8)) & 0xFF;
+}
+
+static void
+open_socket (unsigned sock)
+{
+    w5100b_writeSnMR (sock, SnMR_TCP);
+    w5100_burst_cmd (sock, Sock_OPEN);
+    w5100_burst_cmd (sock, Sock_CONNECT);
+    expect (w5100b_readSnSR (sock) == SnSR_ESTABLISHED, "socket connected");
+}
+
+static void
+timeout (int sig)
+{
+    static const char msg[] = "FAIL: bclient_write() did not return\n";
+
+    write (1, msg, sizeof msg - 1);
+    _exit (1);
+}
+
+/*
+ * Send total bytes from socket 0 and check what the peer got.
+ */
+static void
+upload (const char *name, unsigned long total)
+{
+    static uint8_t buf [8192], got [8192];
+    unsigned long sent = 0, checked = 0, sends, cycles;
+    unsigned n, i, m;
+
+    sends = w5100sim_stats.sends;
+    cycles = w5100sim_stats.cycles;
+    while (sent < total) {
+        n = w5100_burst_tx_free (0);
+        if (n > total - sent)
+            n = total - sent;
+        for (i=0; i<n; i++)
+            buf[i] = pattern (sent + i);
+        w5100_burst_send_chunk (0, buf, n);
+        w5100_burst_cmd (0, Sock_SEND);
+        if (! w5100_burst_wait_send (0, SnIR_SEND_OK)) {
+            expect (0, "SEND_OK");
+            return;
+        }
+        sent += n;
+
+        while ((m = w5100sim_peer_recv (0, got, sizeof got)) > 0)
+            for (i=0; i<m; i++, checked++)
+                if (got[i] != pattern (checked)) {
+                    expect (0, "peer got what was sent");
+                    return;
+                }
+    }
+    expect (checked == total, "whole stream sent");
+    sends = w5100sim_stats.sends - sends;
+    cycles = w5100sim_stats.cycles - cycles;
+    printf ("%-8s TX %u bytes, %lu SENDs, %.2f chip select cycles "
+        "per byte\n", name, w5100_ssize[0], sends, (double) cycles / total);
+}
+
+/*
+ * Write one segment through bclient on a socket with little TX
+ * memory, with the given segment size or the one from the chip.
+ */
+static void
+segment (const char *name, unsigned sock, unsigned mss)
+{
+    static bclient_t b;
+    static uint8_t buf [BCLIENT_TXSIZE], got [BCLIENT_TXSIZE + 1];
+    unsigned long sends;
+    unsigned i, n;
+
+    open_socket (sock);
+    bclient_init_sock (&b, sock);
+    expect (b.mss <= w5100_ssize[sock], "segment fits TX memory");
+    if (mss)
+        b.mss = mss;
+    for (i=0; i<BCLIENT_TXSIZE; i++)
+        buf[i] = pattern (i);
+
+    sends = w5100sim_stats.sends;
+    fflush (stdout);
+    alarm (5);
+    bclient_write (&b, buf, BCLIENT_TXSIZE);
+    bclient_flush (&b);
+    alarm (0);
+    sends = w5100sim_stats.sends - sends;
+
+    n = w5100sim_peer_recv (sock, got, sizeof got);
+    expect (n == BCLIENT_TXSIZE && memcmp (got, buf, n) == 0,
+        "peer got the segment");
+    printf ("%-8s TX %u bytes, mss %u, %u bytes in %lu SENDs\n", name,
+        w5100_ssize[sock], b.mss, n, sends);
+    bclient_stop (&b);
+}
+
+int
+main (int argc, char **argv)
+{
+    unsigned long total = 64 * 1024;
+    int opt;
+
+    while ((opt = getopt (argc, argv, "n:")) != -1) {
+        switch (opt) {
+        case 'n':
+            total = strtoul (optarg, 0, 0) * 1024;
+            break;
+        default:
+            fprintf (stderr, "Usage: partbench [-n kbytes]\n");
+            return 1;
+        }
+    }
+
+    w5100sim_reset ();
+    w5100_init ();
+    if (w5100_burst_init () < 0) {
+        perror (W5100_SPI_DEVICE);
+        return 1;
+    }
+    open_socket (0);
+    upload ("default:", total);
+
+    /* Sockets must be closed before their memory moves. */
+    wz_part_declare (0, WZ_PART_IDLE, WZ_PART_BULK);
+    wz_part_declare (1, WZ_PART_IDLE, WZ_PART_IDLE);
+    wz_part_declare (2, WZ_PART_IDLE, WZ_PART_IDLE);
+    wz_part_declare (3, WZ_PART_IDLE, WZ_PART_IDLE);
+    expect (wz_part_apply () == -1, "no split while socket 0 is open");
+    w5100_burst_cmd (0, Sock_CLOSE);
+    expect (wz_part_apply () == 1, "split applied");
+    expect (wz_part_apply () == 0, "split already in effect");
+    expect (w5100_ssize[0] > 2048, "bulk socket got more TX memory");
+
+    open_socket (0);
+    upload ("bulk:", total);
+
+    signal (SIGALRM, timeout);
+    expect (w5100_ssize[2] == 1024, "idle socket got 1 kbyte of TX memory");
+    segment ("idle:", 2, 0);
+    segment ("old mss:", 2, BCLIENT_TXSIZE);
+
+    expect (w5100sim_stats.violations == 0, "no chip select violations");
+    if (nfailed) {
+        printf ("%d checks failed\n", nfailed);
+        return 1;
+    }
+    printf ("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,223 @@
+/*
+ * Send a file on socket 0 with wz_sendfile() and with a loop of
+ * read() and client_write(), and compare the SPI traffic per byte.
+ *
+ * The file is written to a scratch path with a known pattern, and
+ * the peer checks every byte it gets.  Then wz_sendfile() is asked
+ * for more than the file holds, which must return the length of the
+ * file, and is given a descriptor open only for writing, which must
+ * return -1 with the errno of read() instead of a short count.
+ *
+ * The model takes at most 64 kbytes for the peer between checks,
+ * so the file is no larger.
+ *
+ * Usage: sendbench [-n kbytes]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "w5100burst.h"
+#include "w5100sim.h"
+#include "wzsendfile.h"
+#include <wiznet/client.h>
+
+#define BLOCK       1024        /* read() size of the stock loop */
+
+static int nfailed;
+static char path [] = "/tmp/sendbenchXXXXXX";
+static uint8_t got [64 * 1024 + 1];
+
+static void
+expect (int cond, const char *what)
+{
+    if (! cond) {
+        printf ("FAIL: %s\n", what);
+        nfailed++;
+    }
+}
+
+static uint8_t
+pattern (unsigned long i)
+{
+    return (i * 131 + (i >> 8)) & 0xFF;
+}
+
+static void
+open_socket (unsigned sock)
+{
+    w5100b_writeSnMR (sock, SnMR_TCP);
+    w5100_burst_cmd (sock, Sock_OPEN);
+    w5100_burst_cmd (sock, Sock_CONNECT);
+    expect (w5100b_readSnSR (sock) == SnSR_ESTABLISHED, "socket connected");
+}
+
+static void
+timeout (int sig)
+{
+    static const char msg[] = "FAIL: the transfer did not return\n";
+
+    write (1, msg, sizeof msg - 1);
+    unlink (path);
+    _exit (1);
+}
+
+static int
+make_file (unsigned long total)
+{
+    uint8_t buf [BLOCK];
+    unsigned long i;
+    int fd;
+
+    fd = mkstemp (path);
+    if (fd < 0) {
+        perror (path);
+        exit (1);
+    }
+    for (i=0; i<total; i++) {
+        buf[i % BLOCK] = pattern (i);
+        if (i % BLOCK == BLOCK - 1 || i == total - 1)
+            write (fd, buf, i % BLOCK + 1);
+    }
+    return fd;
+}
+
+/*
+ * Check what the peer got for a file of total bytes.
+ */
+static void
+check_peer (const char *name, unsigned long total)
+{
+    unsigned long i;
+    unsigned n;
+
+    n = w5100sim_peer_recv (0, got, sizeof got);
+    for (i=0; i<n && got[i] == pattern (i); i++)
+        continue;
+    if (n != total || i != n) {
+        printf ("FAIL: %s peer got %u of %lu bytes, first difference "
+            "at %lu\n", name, n, total, i);
+        nfailed++;
+    }
+}
+
+static void
+report (const char *name, unsigned long total, unsigned long cycles,
+    unsigned long sends)
+{
+    printf ("%-12s %lu bytes, %lu SENDs, %.2f chip select cycles per byte\n",
+        name, total, sends, (double) cycles / total);
+}
+
+static void
+send_stock (int fd, unsigned long total)
+{
+    static client_t c;
+    uint8_t buf [BLOCK];
+    unsigned long cycles, sends;
+    int n;
+
+    lseek (fd, 0, SEEK_SET);
+    open_socket (0);
+    client_init_sock (&c, 0);
+    cycles = w5100sim_stats.cycles;
+    sends = w5100sim_stats.sends;
+    fflush (stdout);
+    alarm (5);
+    while ((n = read (fd, buf, sizeof buf)) > 0)
+        client_write (&c, buf, n);
+    alarm (0);
+    cycles = w5100sim_stats.cycles - cycles;
+    sends = w5100sim_stats.sends - sends;
+    check_peer ("client_write:", total);
+    report ("client_write:", total, cycles, sends);
+    w5100_burst_cmd (0, Sock_CLOSE);
+}
+
+static void
+send_file (int fd, unsigned long total)
+{
+    unsigned long cycles, sends;
+    long n;
+
+    lseek (fd, 0, SEEK_SET);
+    open_socket (0);
+    cycles = w5100sim_stats.cycles;
+    sends = w5100sim_stats.sends;
+    fflush (stdout);
+    alarm (5);
+    n = wz_sendfile (0, fd, total + 1000);
+    alarm (0);
+    cycles = w5100sim_stats.cycles - cycles;
+    sends = w5100sim_stats.sends - sends;
+    expect (n == total, "wz_sendfile() returned the file length");
+    check_peer ("wz_sendfile:", total);
+    report ("wz_sendfile:", total, cycles, sends);
+    w5100_burst_cmd (0, Sock_CLOSE);
+}
+
+/*
+ * A read() error must not pass for end of file.
+ */
+static void
+send_error ()
+{
+    long n;
+    int fd;
+
+    fd = open (path, O_WRONLY);
+    open_socket (0);
+    errno = 0;
+    n = wz_sendfile (0, fd, 4096);
+    expect (n == -1, "wz_sendfile() returned -1 when read() failed");
+    expect (errno == EBADF, "errno of read() kept");
+    expect (w5100sim_peer_recv (0, got, sizeof got) == 0, "nothing sent");
+    w5100_burst_cmd (0, Sock_CLOSE);
+    close (fd);
+}
+
+int
+main (int argc, char **argv)
+{
+    unsigned long total = 60 * 1024;
+    int opt, fd;
+
+    while ((opt = getopt (argc, argv, "n:")) != -1) {
+        switch (opt) {
+        case 'n':
+            total = strtoul (optarg, 0, 0) * 1024;
+            break;
+        default:
+usage:      fprintf (stderr, "Usage: sendbench [-n kbytes]\n");
+            return 1;
+        }
+    }
+    if (total < 1 || total > sizeof got - 1)
+        goto usage;
+
+    w5100sim_reset ();
+    w5100_init ();
+    if (w5100_burst_init () < 0) {
+        perror (W5100_SPI_DEVICE);
+        return 1;
+    }
+    signal (SIGALRM, timeout);
+    fd = make_file (total);
+
+    send_stock (fd, total);
+    send_file (fd, total);
+    send_error ();
+
+    close (fd);
+    unlink (path);
+    expect (w5100sim_stats.violations == 0, "no chip select violations");
+    if (nfailed) {
+        printf ("%d checks failed\n", nfailed);
+        return 1;
+    }
+    printf ("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,279 @@
+/*
+ * Datagrams through a UDP socket of the simulator with wz_recvmmsg()
+ * and wz_sendmmsg(), against udp_read_packet() and udp_send_packet()
+ * one datagram at a time.
+ *
+ * For receive the peer fills RX memory with whole datagrams, each
+ * behind the 8-byte header the W5100 puts in front of it: peer
+ * address, port and length.  Every datagram is checked for its
+ * header fields and body.  For send the peer checks the bytes the
+ * socket sent.  The rate is the chip select cycles per datagram
+ * turned into time at W5100_SPI_KHZ, 32 clocks per frame: what
+ * the SPI bus allows, not what a network would carry.
+ *
+ * Last, a header whose length runs past the received data must not
+ * be trusted by wz_recvmmsg(): nothing is returned, no buffer is
+ * overrun, and the datagram the peer sends next is read normally.
+ *
+ * Usage: udpbench [-n datagrams] [-s size]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include "w5100burst.h"
+#include "w5100sim.h"
+#include "wzudp.h"
+
+#define PORT        5000
+#define NMSG        16          /* datagrams per wz_*mmsg() call */
+#define MAXSIZE     1024
+
+static int nfailed;
+static unsigned size = 64;
+static uint8_t peer_ip [4] = { 192, 168, 1, 20 };
+static unsigned peer_port = 7000;
+
+static void
+expect (int cond, const char *what)
+{
+    if (! cond) {
+        printf ("FAIL: %s\n", what);
+        nfailed++;
+    }
+}
+
+static uint8_t
+pattern (unsigned long seq, unsigned i)
+{
+    return (seq * 131 + i * 7 + (seq >> 8)) & 0xFF;
+}
+
+static void
+timeout (int sig)
+{
+    static const char msg[] = "FAIL: a UDP routine did not return\n";
+
+    write (1, msg, sizeof msg - 1);
+    _exit (1);
+}
+
+/*
+ * The peer sends datagram seq as the chip would store it.
+ */
+static void
+peer_datagram (unsigned sock, unsigned long seq)
+{
+    uint8_t dg [8 + MAXSIZE];
+    unsigned i;
+
+    memcpy (dg, peer_ip, 4);
+    dg[4] = peer_port >> 8;
+    dg[5] = peer_port;
+    dg[6] = size >> 8;
+    dg[7] = size;
+    for (i=0; i<size; i++)
+        dg[8+i] = pattern (seq, i);
+    expect (w5100sim_peer_send (sock, dg, 8 + size) == 8 + size,
+        "datagram fits RX memory");
+}
+
+static int
+check_datagram (unsigned long seq, const uint8_t *buf, unsigned len,
+    const uint8_t *ip, unsigned port)
+{
+    unsigned i;
+
+    if (len != size || memcmp (ip, peer_ip, 4) != 0 || port != peer_port)
+        return 0;
+    for (i=0; i<len; i++)
+        if (buf[i] != pattern (seq, i))
+            return 0;
+    return 1;
+}
+
+static void
+report (const char *name, unsigned long total, unsigned long cycles)
+{
+    double frames = (double) cycles / total;
+
+    printf ("%-16s %6.1f frames per datagram, %6.0f datagrams/s\n",
+        name, frames, W5100_SPI_KHZ * 1000.0 / (32 * frames));
+}
+
+/*
+ * Receive total datagrams, fed a RX memory full at a time.
+ */
+static void
+receive (udp_t *u, unsigned long total, int batched)
+{
+    static uint8_t buf [NMSG][MAXSIZE];
+    struct wz_msg msg [NMSG];
+    unsigned long fed = 0, seq = 0, cycles = 0, c;
+    unsigned perfill, port, i;
+    int n, k, ok = 1;
+    uint8_t ip [4];
+
+    for (i=0; i<NMSG; i++) {
+        msg[i].buf = buf[i];
+        msg[i].size = MAXSIZE;
+    }
+    perfill = w5100_rsize[u->sock] / (8 + size);
+    fflush (stdout);
+    alarm (5);
+    while (seq < total && ok) {
+        for (i=0; i<perfill && fed<total; i++)
+            peer_datagram (u->sock, fed++);
+        c = w5100sim_stats.cycles;
+        if (batched) {
+            while (ok && (k = wz_recvmmsg (u, msg, NMSG)) > 0)
+                for (i=0; i<k; i++, seq++)
+                    ok &= check_datagram (seq, msg[i].buf, msg[i].len,
+                        msg[i].ip, msg[i].port);
+        } else {
+            while (ok && (n = udp_read_packet (u, buf[0], MAXSIZE, ip,
+                &port)) >= 0)
+                ok &= check_datagram (seq++, buf[0], n, ip, port);
+        }
+        cycles += w5100sim_stats.cycles - c;
+        if (seq != fed) {
+            expect (0, "every datagram received");
+            break;
+        }
+    }
+    alarm (0);
+    expect (ok, "datagrams received as sent");
+    report (batched ? "wz_recvmmsg:" : "udp_read_packet:", total, cycles);
+}
+
+/*
+ * Send total datagrams, NMSG at a time for wz_sendmmsg().
+ */
+static void
+send (udp_t *u, unsigned long total, int batched)
+{
+    static uint8_t buf [NMSG][MAXSIZE], got [NMSG * MAXSIZE];
+    struct wz_msg msg [NMSG];
+    unsigned long seq = 0, cycles = 0, c;
+    unsigned i, j, n, k;
+    int ok = 1;
+
+    fflush (stdout);
+    alarm (5);
+    while (seq < total && ok) {
+        n = (total - seq < NMSG) ? total - seq : NMSG;
+        for (i=0; i<n; i++) {
+            for (j=0; j<size; j++)
+                buf[i][j] = pattern (seq + i, j);
+            msg[i].buf = buf[i];
+            msg[i].len = size;
+            memcpy (msg[i].ip, peer_ip, 4);
+            msg[i].port = peer_port;
+        }
+        c = w5100sim_stats.cycles;
+        if (batched) {
+            for (i=0; i<n; i+=k) {
+                k = wz_sendmmsg (u, msg + i, n - i);
+                if (k == 0)
+                    break;
+            }
+        } else {
+            for (i=0; i<n; i++)
+                if (udp_send_packet (u, buf[i], size, peer_ip,
+                    peer_port) != size)
+                    break;
+        }
+        cycles += w5100sim_stats.cycles - c;
+        if (i != n) {
+            expect (0, "every datagram sent");
+            break;
+        }
+        k = w5100sim_peer_recv (u->sock, got, sizeof got);
+        ok = (k == n * size);
+        for (i=0; i<n && ok; i++)
+            ok = memcmp (got + i * size, buf[i], size) == 0;
+        seq += n;
+    }
+    alarm (0);
+    expect (ok, "peer got the datagrams");
+    report (batched ? "wz_sendmmsg:" : "udp_send_packet:", total, cycles);
+}
+
+/*
+ * A length past the end of the received data.
+ */
+static void
+bad_header (udp_t *u)
+{
+    static uint8_t buf [MAXSIZE + 16];
+    static const uint8_t bad [8 + 20] = { 192, 168, 1, 20, 0x1B, 0x58,
+        0x03, 0xE8 };
+    struct wz_msg msg;
+    unsigned i;
+
+    memset (buf, 0x5A, sizeof buf);
+    msg.buf = buf;
+    msg.size = MAXSIZE;
+    w5100sim_peer_send (u->sock, bad, sizeof bad);
+    expect (wz_recvmmsg (u, &msg, 1) == 0, "bad header: no datagram");
+    for (i=0; i<sizeof buf && buf[i] == 0x5A; i++)
+        continue;
+    expect (i == sizeof buf, "bad header: buffer untouched");
+    expect (w5100_burst_rx_size (u->sock) == 0, "bad header: data dropped");
+
+    peer_datagram (u->sock, 1);
+    expect (wz_recvmmsg (u, &msg, 1) == 1 &&
+        check_datagram (1, msg.buf, msg.len, msg.ip, msg.port),
+        "next datagram received");
+}
+
+int
+main (int argc, char **argv)
+{
+    static udp_t u;
+    unsigned long total = 10000;
+    int opt;
+
+    while ((opt = getopt (argc, argv, "n:s:")) != -1) {
+        switch (opt) {
+        case 'n':
+            total = strtoul (optarg, 0, 0);
+            break;
+        case 's':
+            size = strtoul (optarg, 0, 0);
+            break;
+        default:
+usage:      fprintf (stderr, "Usage: udpbench [-n datagrams] [-s size]\n");
+            return 1;
+        }
+    }
+    if (total < 1 || size < 1 || size > MAXSIZE)
+        goto usage;
+
+    w5100sim_reset ();
+    w5100_init ();
+    if (w5100_burst_init () < 0) {
+        perror (W5100_SPI_DEVICE);
+        return 1;
+    }
+    signal (SIGALRM, timeout);
+    expect (udp_init (&u, PORT) && w5100b_readSnSR (u.sock) == SnSR_UDP,
+        "UDP socket open");
+
+    printf ("%lu datagrams of %u bytes:\n", total, size);
+    receive (&u, total, 0);
+    receive (&u, total, 1);
+    send (&u, total, 0);
+    send (&u, total, 1);
+    bad_header (&u);
+    udp_stop (&u);
+
+    expect (w5100sim_stats.violations == 0, "no chip select violations");
+    if (nfailed) {
+        printf ("%d checks failed\n", nfailed);
+        return 1;
+    }
+    printf ("all checks passed\n");
+    return 0;
+}
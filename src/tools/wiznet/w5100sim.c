@@ -0,0 +1,440 @@
+/*
+ * Register-level simulator of the W5100 on its SPI port.
+ */
+#include <stdarg.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/spi.h>
+#include <wiznet/w5100.h>
+#include "w5100burst.h"
+#include "w5100sim.h"
+
+#define CMD_WRITE       0xF0
+#define CMD_READ        0x0F
+
+#define IR              0x0015
+#define IMR             0x0016
+#define RMSR            0x001A
+#define TMSR            0x001B
+
+#define SN(sock, reg)   (CH_BASE + (sock)*CH_SIZE + (reg))
+#define Sn_MR           0x00
+#define Sn_CR           0x01
+#define Sn_IR           0x02
+#define Sn_SR           0x03
+#define Sn_TX_FSR       0x20
+#define Sn_TX_RD        0x22
+#define Sn_TX_WR        0x24
+#define Sn_RX_RSR       0x26
+#define Sn_RX_RD        0x28
+
+#define PEERBUF         65536           /* data sent, not yet taken */
+
+struct w5100sim_stats w5100sim_stats;
+
+static uint8_t mem [0x8000];
+
+/*
+ * Chip state behind the socket registers.
+ */
+static struct {
+    uint16_t    tx_rd;                  /* first byte not sent */
+    uint16_t    rx_wr;                  /* end of received data */
+    uint16_t    rx_rd;                  /* SnRX_RD as of the last RECV */
+    uint8_t     out [PEERBUF];          /* sent, for the peer */
+    unsigned    out_head, out_tail;
+} sock [MAX_SOCK_NUM];
+
+static int spi_fd = -1;
+static int int_pipe [2] = { -1, -1 };
+static int int_level = 1;
+
+/*
+ * Memory split as in w5100_burst_layout().
+ */
+static void
+layout (unsigned msr, unsigned s, unsigned *base, unsigned *size)
+{
+    unsigned i, sz, used = 0;
+
+    for (i=0; i<=s; i++) {
+        sz = 1024 << ((msr >> (i*2)) & 3);
+        if (used + sz > 8192)
+            sz = 0;
+        *base = used;
+        *size = sz;
+        used += sz;
+    }
+}
+
+static unsigned
+get16 (unsigned addr)
+{
+    return mem[addr] << 8 | mem[addr + 1];
+}
+
+static void
+put16 (unsigned addr, unsigned val)
+{
+    mem[addr] = val >> 8;
+    mem[addr + 1] = val;
+}
+
+static unsigned
+tx_free (unsigned s)
+{
+    unsigned base, size;
+
+    layout (mem[TMSR], s, &base, &size);
+    return size - (uint16_t) (get16 (SN(s, Sn_TX_WR)) - sock[s].tx_rd);
+}
+
+static unsigned
+rx_size (unsigned s)
+{
+    return (uint16_t) (sock[s].rx_wr - sock[s].rx_rd);
+}
+
+int
+w5100sim_int ()
+{
+    return (mem[IR] & mem[IMR] & 0x0F) == 0;
+}
+
+/*
+ * Record a change of /INT for w5100sim_intfd().
+ */
+static void
+int_edge ()
+{
+    char level = w5100sim_int ();
+
+    if (level == int_level)
+        return;
+    int_level = level;
+    if (int_pipe[1] >= 0)
+        write (int_pipe[1], &level, 1);
+}
+
+static void
+update_ir ()
+{
+    unsigned s;
+
+    mem[IR] &= 0xF0;
+    for (s=0; s<MAX_SOCK_NUM; s++)
+        if (mem[SN(s, Sn_IR)])
+            mem[IR] |= 1 << s;
+    int_edge ();
+}
+
+int
+w5100sim_intfd ()
+{
+    if (int_pipe[0] < 0) {
+        if (pipe (int_pipe) < 0)
+            return -1;
+        fcntl (int_pipe[1], F_SETFL, O_NONBLOCK);
+    }
+    return int_pipe[0];
+}
+
+static void
+chip_reset ()
+{
+    memset (mem, 0, sizeof mem);
+    memset (sock, 0, sizeof sock);
+    int_edge ();
+    put16 (0x0017, 2000);               /* RTR */
+    mem[0x0019] = 8;                    /* RCR */
+    mem[RMSR] = 0x55;
+    mem[TMSR] = 0x55;
+}
+
+void
+w5100sim_reset ()
+{
+    chip_reset ();
+    memset (&w5100sim_stats, 0, sizeof w5100sim_stats);
+}
+
+/*
+ * Move the data between TX_RD and TX_WR to the peer.
+ */
+static void
+send (unsigned s)
+{
+    unsigned base, size, wr, n;
+
+    w5100sim_stats.sends++;
+    layout (mem[TMSR], s, &base, &size);
+    wr = get16 (SN(s, Sn_TX_WR));
+    n = (uint16_t) (wr - sock[s].tx_rd);
+    while (n-- > 0) {
+        if (sock[s].out_head - sock[s].out_tail < PEERBUF)
+            sock[s].out[sock[s].out_head++ % PEERBUF] =
+                mem[W5100_TXBASE + base + (sock[s].tx_rd & (size - 1))];
+        sock[s].tx_rd++;
+        w5100sim_stats.sent++;
+    }
+    mem[SN(s, Sn_IR)] |= SnIR_SEND_OK;
+}
+
+static void
+command (unsigned s, unsigned cmd)
+{
+    uint8_t *sr = &mem[SN(s, Sn_SR)];
+    uint8_t *ir = &mem[SN(s, Sn_IR)];
+
+    w5100sim_stats.commands++;
+    switch (cmd) {
+    case Sock_OPEN:
+        switch (mem[SN(s, Sn_MR)] & 0x0F) {
+        case SnMR_TCP:
+            *sr = SnSR_INIT;
+            break;
+        case SnMR_UDP:
+            *sr = SnSR_UDP;
+            break;
+        default:
+            *sr = SnSR_CLOSED;
+            break;
+        }
+        sock[s].tx_rd = sock[s].rx_wr = sock[s].rx_rd = 0;
+        sock[s].out_head = sock[s].out_tail = 0;
+        put16 (SN(s, Sn_TX_WR), 0);
+        put16 (SN(s, Sn_RX_RD), 0);
+        break;
+    case Sock_LISTEN:
+        if (*sr == SnSR_INIT)
+            *sr = SnSR_LISTEN;
+        break;
+    case Sock_CONNECT:
+        if (*sr == SnSR_INIT) {
+            *sr = SnSR_ESTABLISHED;
+            *ir |= SnIR_CON;
+        }
+        break;
+    case Sock_DISCON:
+        if (*sr == SnSR_ESTABLISHED || *sr == SnSR_CLOSE_WAIT) {
+            *sr = SnSR_CLOSED;
+            *ir |= SnIR_DISCON;
+        }
+        break;
+    case Sock_CLOSE:
+        *sr = SnSR_CLOSED;
+        break;
+    case Sock_SEND:
+    case Sock_SEND_MAC:
+        if (*sr == SnSR_ESTABLISHED || *sr == SnSR_CLOSE_WAIT ||
+            *sr == SnSR_UDP)
+            send (s);
+        break;
+    case Sock_RECV:
+        w5100sim_stats.recvs++;
+        sock[s].rx_rd = get16 (SN(s, Sn_RX_RD));
+        if (rx_size (s) > 0)
+            *ir |= SnIR_RECV;
+        break;
+    }
+    update_ir ();
+}
+
+static unsigned
+read_reg (unsigned addr)
+{
+    unsigned s, reg;
+
+    if (addr >= CH_BASE && addr < CH_BASE + MAX_SOCK_NUM*CH_SIZE) {
+        s = (addr - CH_BASE) / CH_SIZE;
+        reg = (addr - CH_BASE) % CH_SIZE;
+        switch (reg) {
+        case Sn_TX_FSR:     return tx_free (s) >> 8;
+        case Sn_TX_FSR + 1: return tx_free (s) & 0xFF;
+        case Sn_TX_RD:      return sock[s].tx_rd >> 8;
+        case Sn_TX_RD + 1:  return sock[s].tx_rd & 0xFF;
+        case Sn_RX_RSR:     return rx_size (s) >> 8;
+        case Sn_RX_RSR + 1: return rx_size (s) & 0xFF;
+        }
+    }
+    return mem[addr];
+}
+
+static void
+write_reg (unsigned addr, unsigned data)
+{
+    unsigned s, reg;
+
+    if (addr >= CH_BASE && addr < CH_BASE + MAX_SOCK_NUM*CH_SIZE) {
+        s = (addr - CH_BASE) / CH_SIZE;
+        reg = (addr - CH_BASE) % CH_SIZE;
+        switch (reg) {
+        case Sn_CR:
+            /* The command is done at once and SnCR reads back 0. */
+            command (s, data);
+            return;
+        case Sn_IR:
+            mem[addr] &= ~data;
+            update_ir ();
+            return;
+        case Sn_SR:
+        case Sn_TX_FSR: case Sn_TX_FSR + 1:
+        case Sn_TX_RD:  case Sn_TX_RD + 1:
+        case Sn_RX_RSR: case Sn_RX_RSR + 1:
+            return;                     /* read only */
+        }
+    }
+    if (addr == 0x0000 && (data & MR_RST)) {
+        chip_reset ();
+        return;
+    }
+    if (addr == IR) {
+        mem[IR] &= ~(data & 0xF0);
+        return;
+    }
+    mem[addr] = data;
+    if (addr == IMR)
+        int_edge ();
+}
+
+void
+w5100sim_cycle (uint8_t *buf, unsigned len)
+{
+    unsigned addr;
+
+    w5100sim_stats.cycles++;
+    w5100sim_stats.bytes += len;
+    if (len != 4)
+        w5100sim_stats.violations++;
+    if (len < 4)
+        return;
+
+    addr = (buf[1] << 8 | buf[2]) & 0x7FFF;
+    switch (buf[0]) {
+    case CMD_WRITE:
+        write_reg (addr, buf[3]);
+        break;
+    case CMD_READ:
+        buf[3] = read_reg (addr);
+        break;
+    default:
+        w5100sim_stats.violations++;
+        return;
+    }
+    buf[0] = 0;
+    buf[1] = 1;
+    buf[2] = 2;
+    w5100sim_stats.frames++;
+
+    /* No burst mode: the rest of the cycle is lost. */
+    if (len > 4)
+        memset (buf + 4, 0, len - 4);
+}
+
+int
+w5100sim_peer_connect (unsigned s)
+{
+    if (mem[SN(s, Sn_SR)] != SnSR_LISTEN)
+        return -1;
+    mem[SN(s, Sn_SR)] = SnSR_ESTABLISHED;
+    mem[SN(s, Sn_IR)] |= SnIR_CON;
+    update_ir ();
+    return 0;
+}
+
+unsigned
+w5100sim_peer_send (unsigned s, const uint8_t *data, unsigned len)
+{
+    unsigned base, size, i;
+
+    if (mem[SN(s, Sn_SR)] != SnSR_ESTABLISHED &&
+        mem[SN(s, Sn_SR)] != SnSR_UDP)
+        return 0;
+    layout (mem[RMSR], s, &base, &size);
+    if (len > size - rx_size (s))
+        len = size - rx_size (s);
+    for (i=0; i<len; i++) {
+        mem[W5100_RXBASE + base + (sock[s].rx_wr & (size - 1))] = data[i];
+        sock[s].rx_wr++;
+    }
+    if (len > 0) {
+        mem[SN(s, Sn_IR)] |= SnIR_RECV;
+        update_ir ();
+    }
+    w5100sim_stats.received += len;
+    return len;
+}
+
+unsigned
+w5100sim_peer_recv (unsigned s, uint8_t *data, unsigned len)
+{
+    unsigned n = 0;
+
+    while (n < len && sock[s].out_tail != sock[s].out_head)
+        data[n++] = sock[s].out[sock[s].out_tail++ % PEERBUF];
+    return n;
+}
+
+void
+w5100sim_peer_close (unsigned s)
+{
+    if (mem[SN(s, Sn_SR)] != SnSR_ESTABLISHED)
+        return;
+    mem[SN(s, Sn_SR)] = SnSR_CLOSE_WAIT;
+    mem[SN(s, Sn_IR)] |= SnIR_DISCON;
+    update_ir ();
+}
+
+/*
+ * Hooks for -Wl,--wrap: the SPI device is served by the model,
+ * everything else goes to the C library.
+ */
+int __real_open (const char *path, int flags, ...);
+int __real_ioctl (int fd, unsigned long request, ...);
+int __real_close (int fd);
+
+int
+__wrap_open (const char *path, int flags, ...)
+{
+    va_list ap;
+    int mode;
+
+    if (strcmp (path, W5100_SPI_DEVICE) == 0) {
+        if (spi_fd < 0)
+            spi_fd = __real_open ("/dev/null", O_RDWR);
+        return spi_fd;
+    }
+    va_start (ap, flags);
+    mode = va_arg (ap, int);
+    va_end (ap);
+    return __real_open (path, flags, mode);
+}
+
+int
+__wrap_ioctl (int fd, unsigned long request, ...)
+{
+    va_list ap;
+    void *arg;
+
+    va_start (ap, request);
+    arg = va_arg (ap, void*);
+    va_end (ap);
+    if (fd < 0 || fd != spi_fd)
+        return __real_ioctl (fd, request, arg);
+
+    if ((request & ~(IOCPARM_MASK << 16)) == (SPICTL_IO8(0) & 0xffffffffUL)) {
+        w5100sim_cycle (arg, (request >> 16) & IOCPARM_MASK);
+        return 0;
+    }
+    /* SETMODE, SETRATE, SETSELPIN: nothing to do. */
+    return 0;
+}
+
+int
+__wrap_close (int fd)
+{
+    if (fd >= 0 && fd == spi_fd)
+        spi_fd = -1;
+    return __real_close (fd);
+}
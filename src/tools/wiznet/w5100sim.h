@@ -0,0 +1,89 @@
+/*
+ * Register-level simulator of the W5100 on its SPI port.
+ *
+ * Programs built with the wiznet library sources for the host are
+ * linked with -Wl,--wrap=open,--wrap=ioctl,--wrap=close: opening
+ * W5100_SPI_DEVICE then gives a descriptor whose SPICTL_IO8
+ * transfers go to this model instead of a kernel driver.
+ *
+ * Every SPICTL_IO8 call is one chip select cycle.  The W5100 takes
+ * exactly one 4-byte frame per cycle (0xF0 write or 0x0F read,
+ * address high, address low, data) and has no burst mode: a cycle
+ * of any other length is counted as a violation, and only its first
+ * frame takes effect.  A read frame returns 0, 1, 2 and then the
+ * register value, as the chip does.
+ *
+ * The model keeps the 32 kbytes of address space: common and socket
+ * registers, and TX and RX memory split as set by TMSR and RMSR.
+ * Socket commands change SnSR and SnIR the way the chip does for a
+ * peer which always answers at once.  The network side is driven
+ * by the w5100sim_peer_*() routines.
+ */
+#ifndef W5100SIM_H_INCLUDED
+#define W5100SIM_H_INCLUDED
+
+#include <stdint.h>
+
+struct w5100sim_stats {
+    unsigned long   cycles;         /* chip select cycles */
+    unsigned long   bytes;          /* bytes clocked on the bus */
+    unsigned long   frames;         /* frames which took effect */
+    unsigned long   violations;     /* cycles which were not one frame */
+    unsigned long   commands;       /* socket commands */
+    unsigned long   sends;          /* SEND commands */
+    unsigned long   recvs;          /* RECV commands */
+    unsigned long   sent;           /* bytes sent by SEND */
+    unsigned long   received;       /* bytes delivered to RX memory */
+};
+
+extern struct w5100sim_stats w5100sim_stats;
+
+/*
+ * Power-on state, as after a write of MR_RST.
+ * Statistics are cleared too.
+ */
+void w5100sim_reset (void);
+
+/*
+ * One chip select cycle: shift len bytes out of buf and replace
+ * them with the bytes shifted in.
+ */
+void w5100sim_cycle (uint8_t *buf, unsigned len);
+
+/*
+ * A peer connects to a listening socket.
+ * Returns 0, or -1 when the socket is not listening.
+ */
+int w5100sim_peer_connect (unsigned sock);
+
+/*
+ * The peer sends data to the socket: as much as fits in its RX
+ * memory is stored.  Returns the number of bytes taken.
+ */
+unsigned w5100sim_peer_send (unsigned sock, const uint8_t *data, unsigned len);
+
+/*
+ * Take up to len bytes which the socket has sent.
+ * Returns the number of bytes.
+ */
+unsigned w5100sim_peer_recv (unsigned sock, uint8_t *data, unsigned len);
+
+/*
+ * The peer closes the connection.
+ */
+void w5100sim_peer_close (unsigned sock);
+
+/*
+ * Level of the /INT pin: 0 while an enabled socket interrupt
+ * is pending, 1 otherwise.
+ */
+int w5100sim_int (void);
+
+/*
+ * A descriptor which becomes readable when /INT changes, like an
+ * edge capture driver on the pin: one byte, the new level, is
+ * queued per change.
+ */
+int w5100sim_intfd (void);
+
+#endif
@@ -0,0 +1,516 @@
+/*
+ * The stock W5100 accessors and the socket and client routines of
+ * libwiznet.a, for host programs running on the simulator.
+ *
+ * They follow the library, which comes from the Arduino Ethernet
+ * library: every register byte is one frame in one SPI ioctl,
+ * 16-bit size registers are read until two values agree, send
+ * waits for SEND_OK, and each socket gets 2 kbytes of memory.
+ * Only the routines used by the host programs are here.
+ */
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/spi.h>
+#include <wiznet/ethernet.h>
+#include <wiznet/socket.h>
+#include <wiznet/udp.h>
+#include "w5100burst.h"
+
+#define SSIZE       2048
+#define SMASK       (SSIZE - 1)
+#define RSIZE       2048
+#define RMASK       (RSIZE - 1)
+
+static int spi = -1;
+
+unsigned _client_srcport = 1024;
+unsigned _socket_port [MAX_SOCK_NUM];
+static unsigned local_port;
+
+void
+w5100_init ()
+{
+    if (spi < 0) {
+        spi = open (W5100_SPI_DEVICE, O_RDWR);
+        ioctl (spi, SPICTL_SETRATE, W5100_SPI_KHZ);
+        ioctl (spi, SPICTL_SETSELPIN, W5100_SPI_SELPIN);
+    }
+    w5100_writeMR (MR_RST);
+    w5100_writeRMSR (0x55);
+    w5100_writeTMSR (0x55);
+}
+
+unsigned
+w5100_write_byte (unsigned addr, int byte)
+{
+    uint8_t frame [4];
+
+    frame[0] = 0xF0;
+    frame[1] = addr >> 8;
+    frame[2] = addr;
+    frame[3] = byte;
+    ioctl (spi, SPICTL_IO8(4), frame);
+    return 1;
+}
+
+unsigned
+w5100_write (unsigned addr, const uint8_t *buf, unsigned len)
+{
+    unsigned i;
+
+    for (i=0; i<len; i++)
+        w5100_write_byte (addr + i, buf[i]);
+    return len;
+}
+
+unsigned
+w5100_read_byte (unsigned addr)
+{
+    uint8_t frame [4];
+
+    frame[0] = 0x0F;
+    frame[1] = addr >> 8;
+    frame[2] = addr;
+    frame[3] = 0xFF;
+    ioctl (spi, SPICTL_IO8(4), frame);
+    return frame[3];
+}
+
+unsigned
+w5100_read (unsigned addr, uint8_t *buf, unsigned len)
+{
+    unsigned i;
+
+    for (i=0; i<len; i++)
+        buf[i] = w5100_read_byte (addr + i);
+    return len;
+}
+
+unsigned
+w5100_getTXFreeSize (unsigned sock)
+{
+    unsigned val = 0, val1;
+
+    do {
+        val1 = w5100_readSnTX_FSR (sock);
+        if (val1 != 0)
+            val = w5100_readSnTX_FSR (sock);
+    } while (val != val1);
+    return val;
+}
+
+unsigned
+w5100_getRXReceivedSize (unsigned sock)
+{
+    unsigned val = 0, val1;
+
+    do {
+        val1 = w5100_readSnRX_RSR (sock);
+        if (val1 != 0)
+            val = w5100_readSnRX_RSR (sock);
+    } while (val != val1);
+    return val;
+}
+
+void
+w5100_socket_cmd (unsigned sock, int cmd)
+{
+    w5100_writeSnCR (sock, cmd);
+    while (w5100_readSnCR (sock))
+        continue;
+}
+
+static void
+write_data (unsigned sock, unsigned ptr, const uint8_t *data, unsigned len)
+{
+    unsigned offset = ptr & SMASK;
+    unsigned addr = W5100_TXBASE + sock*SSIZE + offset;
+    unsigned n;
+
+    if (offset + len > SSIZE) {
+        n = SSIZE - offset;
+        w5100_write (addr, data, n);
+        w5100_write (W5100_TXBASE + sock*SSIZE, data + n, len - n);
+    } else {
+        w5100_write (addr, data, len);
+    }
+}
+
+void
+w5100_read_data (unsigned sock, unsigned ptr, uint8_t *data, unsigned len)
+{
+    unsigned offset = ptr & RMASK;
+    unsigned addr = W5100_RXBASE + sock*RSIZE + offset;
+    unsigned n;
+
+    if (offset + len > RSIZE) {
+        n = RSIZE - offset;
+        w5100_read (addr, data, n);
+        w5100_read (W5100_RXBASE + sock*RSIZE, data + n, len - n);
+    } else {
+        w5100_read (addr, data, len);
+    }
+}
+
+void
+w5100_send_chunk (unsigned sock, const uint8_t *data, unsigned len)
+{
+    unsigned ptr = w5100_readSnTX_WR (sock);
+
+    write_data (sock, ptr, data, len);
+    w5100_writeSnTX_WR (sock, ptr + len);
+}
+
+void
+w5100_recv_chunk (unsigned sock, uint8_t *data, unsigned len)
+{
+    unsigned ptr = w5100_readSnRX_RD (sock);
+
+    w5100_read_data (sock, ptr, data, len);
+    w5100_writeSnRX_RD (sock, ptr + len);
+}
+
+unsigned
+w5100_recv_peek (unsigned sock)
+{
+    uint8_t b;
+
+    w5100_read_data (sock, w5100_readSnRX_RD (sock), &b, 1);
+    return b;
+}
+
+unsigned
+socket_init (unsigned sock, unsigned protocol, unsigned port, unsigned flag)
+{
+    if (protocol != SnMR_TCP && protocol != SnMR_UDP)
+        return 0;
+    socket_close (sock);
+    w5100_writeSnMR (sock, protocol | flag);
+    if (port == 0)
+        port = ++local_port;
+    w5100_writeSnPORT (sock, port);
+    w5100_socket_cmd (sock, Sock_OPEN);
+    return 1;
+}
+
+void
+socket_close (unsigned sock)
+{
+    w5100_socket_cmd (sock, Sock_CLOSE);
+    w5100_writeSnIR (sock, 0xFF);
+}
+
+unsigned
+socket_connect (unsigned sock, uint8_t *addr, unsigned port)
+{
+    w5100_writeSnDIPR (sock, addr);
+    w5100_writeSnDPORT (sock, port);
+    w5100_socket_cmd (sock, Sock_CONNECT);
+    return 1;
+}
+
+void
+socket_disconnect (unsigned sock)
+{
+    w5100_socket_cmd (sock, Sock_DISCON);
+}
+
+unsigned
+socket_listen (unsigned sock)
+{
+    if (w5100_readSnSR (sock) != SnSR_INIT)
+        return 0;
+    w5100_socket_cmd (sock, Sock_LISTEN);
+    return 1;
+}
+
+unsigned
+socket_send (unsigned sock, const uint8_t *buf, unsigned len)
+{
+    unsigned status, freesize, ret;
+
+    ret = (len > SSIZE) ? SSIZE : len;
+    do {
+        freesize = w5100_getTXFreeSize (sock);
+        status = w5100_readSnSR (sock);
+        if (status != SnSR_ESTABLISHED && status != SnSR_CLOSE_WAIT)
+            return 0;
+    } while (freesize < ret);
+
+    w5100_send_chunk (sock, buf, ret);
+    w5100_socket_cmd (sock, Sock_SEND);
+
+    while ((w5100_readSnIR (sock) & SnIR_SEND_OK) != SnIR_SEND_OK) {
+        if (w5100_readSnSR (sock) == SnSR_CLOSED) {
+            socket_close (sock);
+            return 0;
+        }
+    }
+    w5100_writeSnIR (sock, SnIR_SEND_OK);
+    return ret;
+}
+
+unsigned
+socket_recv (unsigned sock, uint8_t *buf, unsigned len)
+{
+    unsigned n = w5100_getRXReceivedSize (sock);
+
+    if (n == 0)
+        return 0;
+    if (n > len)
+        n = len;
+    w5100_recv_chunk (sock, buf, n);
+    w5100_socket_cmd (sock, Sock_RECV);
+    return n;
+}
+
+unsigned
+socket_peek (unsigned sock)
+{
+    return w5100_recv_peek (sock);
+}
+
+unsigned
+socket_sendto (unsigned sock, const uint8_t *buf, unsigned len,
+    uint8_t *addr, unsigned port)
+{
+    unsigned ret = (len > SSIZE) ? SSIZE : len;
+
+    if ((addr[0] | addr[1] | addr[2] | addr[3]) == 0 || port == 0)
+        return 0;
+    w5100_writeSnDIPR (sock, addr);
+    w5100_writeSnDPORT (sock, port);
+    w5100_send_chunk (sock, buf, ret);
+    w5100_socket_cmd (sock, Sock_SEND);
+
+    while ((w5100_readSnIR (sock) & SnIR_SEND_OK) != SnIR_SEND_OK) {
+        if (w5100_readSnIR (sock) & SnIR_TIMEOUT) {
+            w5100_writeSnIR (sock, SnIR_SEND_OK | SnIR_TIMEOUT);
+            return 0;
+        }
+    }
+    w5100_writeSnIR (sock, SnIR_SEND_OK);
+    return ret;
+}
+
+/*
+ * The library copies the whole datagram into buf whatever len is;
+ * here it is cut to len, so that a short buffer does not overrun.
+ */
+unsigned
+socket_recvfrom (unsigned sock, uint8_t *buf, unsigned len,
+    uint8_t *addr, unsigned *port)
+{
+    uint8_t head [8];
+    unsigned ptr, n;
+
+    if (len == 0)
+        return 0;
+    ptr = w5100_readSnRX_RD (sock);
+    w5100_read_data (sock, ptr, head, 8);
+    ptr += 8;
+    addr[0] = head[0];
+    addr[1] = head[1];
+    addr[2] = head[2];
+    addr[3] = head[3];
+    *port = head[4] << 8 | head[5];
+    n = head[6] << 8 | head[7];
+    w5100_read_data (sock, ptr, buf, (n > len) ? len : n);
+    ptr += n;
+    w5100_writeSnRX_RD (sock, ptr);
+    w5100_socket_cmd (sock, Sock_RECV);
+    return n;
+}
+
+void
+client_init (client_t *c, uint8_t *ip, unsigned port)
+{
+    c->ip = ip;
+    c->port = port;
+    c->sock = MAX_SOCK_NUM;
+}
+
+void
+client_init_sock (client_t *c, unsigned sock)
+{
+    c->sock = sock;
+}
+
+unsigned
+client_status (client_t *c)
+{
+    if (c->sock == MAX_SOCK_NUM)
+        return SnSR_CLOSED;
+    return w5100_readSnSR (c->sock);
+}
+
+int
+client_connect (client_t *c)
+{
+    unsigned i, s;
+
+    if (c->sock != MAX_SOCK_NUM)
+        return 0;
+    for (i=0; i<MAX_SOCK_NUM; i++) {
+        s = w5100_readSnSR (i);
+        if (s == SnSR_CLOSED || s == SnSR_FIN_WAIT) {
+            c->sock = i;
+            break;
+        }
+    }
+    if (c->sock == MAX_SOCK_NUM)
+        return 0;
+
+    _client_srcport++;
+    if (_client_srcport == 0)
+        _client_srcport = 1024;
+    socket_init (c->sock, SnMR_TCP, _client_srcport, 0);
+    if (! socket_connect (c->sock, c->ip, c->port)) {
+        c->sock = MAX_SOCK_NUM;
+        return 0;
+    }
+    while (client_status (c) != SnSR_ESTABLISHED) {
+        if (client_status (c) == SnSR_CLOSED) {
+            c->sock = MAX_SOCK_NUM;
+            return 0;
+        }
+    }
+    return 1;
+}
+
+void
+client_write (client_t *c, const uint8_t *buf, unsigned size)
+{
+    if (c->sock != MAX_SOCK_NUM)
+        socket_send (c->sock, buf, size);
+}
+
+void
+client_putc (client_t *c, uint8_t b)
+{
+    client_write (c, &b, 1);
+}
+
+void
+client_puts (client_t *c, const char *str)
+{
+    const char *p;
+
+    for (p=str; *p; p++)
+        continue;
+    client_write (c, (const uint8_t*) str, p - str);
+}
+
+int
+client_available (client_t *c)
+{
+    if (c->sock == MAX_SOCK_NUM)
+        return 0;
+    return w5100_getRXReceivedSize (c->sock);
+}
+
+int
+client_getc (client_t *c)
+{
+    uint8_t b;
+
+    if (socket_recv (c->sock, &b, 1) == 0)
+        return -1;
+    return b;
+}
+
+int
+client_read (client_t *c, uint8_t *buf, unsigned size)
+{
+    return socket_recv (c->sock, buf, size);
+}
+
+int
+client_peek (client_t *c)
+{
+    if (! client_available (c))
+        return -1;
+    return socket_peek (c->sock);
+}
+
+void
+client_flush (client_t *c)
+{
+    while (client_available (c))
+        client_getc (c);
+}
+
+void
+client_stop (client_t *c)
+{
+    if (c->sock == MAX_SOCK_NUM)
+        return;
+    socket_disconnect (c->sock);
+    if (client_status (c) != SnSR_CLOSED)
+        socket_close (c->sock);
+    _socket_port[c->sock] = 0;
+    c->sock = MAX_SOCK_NUM;
+}
+
+int
+client_connected (client_t *c)
+{
+    unsigned s;
+
+    if (c->sock == MAX_SOCK_NUM)
+        return 0;
+    s = client_status (c);
+    return ! (s == SnSR_LISTEN || s == SnSR_CLOSED || s == SnSR_FIN_WAIT ||
+        (s == SnSR_CLOSE_WAIT && ! client_available (c)));
+}
+
+int
+udp_init (udp_t *u, unsigned port)
+{
+    unsigned i, s;
+
+    u->sock = MAX_SOCK_NUM;
+    for (i=0; i<MAX_SOCK_NUM; i++) {
+        s = w5100_readSnSR (i);
+        if (s == SnSR_CLOSED || s == SnSR_FIN_WAIT) {
+            u->sock = i;
+            break;
+        }
+    }
+    if (u->sock == MAX_SOCK_NUM)
+        return 0;
+    u->port = port;
+    socket_init (u->sock, SnMR_UDP, port, 0);
+    return 1;
+}
+
+unsigned
+udp_available (udp_t *u)
+{
+    return w5100_getRXReceivedSize (u->sock);
+}
+
+void
+udp_stop (udp_t *u)
+{
+    if (u->sock == MAX_SOCK_NUM)
+        return;
+    socket_close (u->sock);
+    u->sock = MAX_SOCK_NUM;
+}
+
+unsigned
+udp_send_packet (udp_t *u, const uint8_t *data, unsigned len,
+    uint8_t *ip, unsigned port)
+{
+    return socket_sendto (u->sock, data, len, ip, port);
+}
+
+int
+udp_read_packet (udp_t *u, uint8_t *buf, unsigned len, uint8_t *ip,
+    unsigned *port)
+{
+    if (! udp_available (u))
+        return -1;
+    return socket_recvfrom (u->sock, buf, len, ip, port);
+}